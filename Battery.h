@@ -0,0 +1,760 @@
+#ifndef BATTERY_H
+#define BATTERY_H
+
+#include <Arduino.h>
+#include "Config.h"
+#include "Hal.h"
+#include "Ina226.h"
+#include "Filters.h"
+#include "MinMaxWindow.h"
+#include "Ocv.h"
+#include "Runtime.h"
+#include "Faults.h"
+#include "Seqlock.h"
+#ifdef SOC_ESTIMATOR_EKF
+#include "Ekf.h"
+#endif
+
+// ===========================================================
+// Battery.h — Per-bank configuration and state model
+// ===========================================================
+//
+// Provides:
+//   - BankConfig: one bank's settings (the BATTn_* defines)
+//   - BatteryTable<N>: the state of N banks, laid out as one
+//     contiguous array per quantity, indexed by bank
+//     (index 0 = battery 1 = NMEA2000 instance 0)
+//   - Pipeline steps that loop over all banks:
+//       processBankSamples()  calibrate + smooth new samples
+//       checkBankFaults()     limits on the unsmoothed samples
+//       integrateBanks()      coulomb counting per conversion,
+//                             Peukert / charge efficiency applied
+//       estimateBanks()       EKF voltage correction of the
+//                             counter (SOC_ESTIMATOR_EKF)
+//       predictBanks()        time to empty / time to full
+//       updateBankSoc()       SoC, SoH
+//       publishBanks()        consistent per-bank snapshot for
+//                             the readers on the other core
+//
+// The firmware instantiates BatteryTable<NUM_BATTERIES>. The
+// templates accept any N so the host benchmark can measure
+// per-bank cost as the bank count grows.
+// ===========================================================
+
+// ===== Nominal voltage per bank (from the *_SYSTEM_VOLTAGE_* selection) =====
+#if defined(BATT1_SYSTEM_VOLTAGE_48V)
+#define BATT1_NOMINAL_V 48
+#elif defined(BATT1_SYSTEM_VOLTAGE_24V)
+#define BATT1_NOMINAL_V 24
+#else
+#define BATT1_NOMINAL_V 12
+#endif
+#if defined(BATT2_SYSTEM_VOLTAGE_48V)
+#define BATT2_NOMINAL_V 48
+#elif defined(BATT2_SYSTEM_VOLTAGE_24V)
+#define BATT2_NOMINAL_V 24
+#else
+#define BATT2_NOMINAL_V 12
+#endif
+#if defined(BATT3_SYSTEM_VOLTAGE_48V)
+#define BATT3_NOMINAL_V 48
+#elif defined(BATT3_SYSTEM_VOLTAGE_24V)
+#define BATT3_NOMINAL_V 24
+#else
+#define BATT3_NOMINAL_V 12
+#endif
+#if defined(BATT4_SYSTEM_VOLTAGE_48V)
+#define BATT4_NOMINAL_V 48
+#elif defined(BATT4_SYSTEM_VOLTAGE_24V)
+#define BATT4_NOMINAL_V 24
+#else
+#define BATT4_NOMINAL_V 12
+#endif
+
+// ==========================
+// Bank configuration
+// ==========================
+
+struct BankConfig {
+  uint8_t  chemistry;         // CHEM_*
+  uint8_t  nominalV;          // 12, 24 or 48
+  float    capacityAh;
+  float    peukertExp;
+  float    chargeEff;
+  float    shuntOhms;
+  float    shuntMaxA;
+  uint8_t  inaAddr;           // INA226 I²C address
+  int      alertPin;          // INA226 ALERT (conversion ready), -1 = poll
+  uint8_t  tempRom[8];        // DS18B20 ROM address (unused with DS18B20_DISCOVER)
+  uint8_t  tempResolution;    // DS18B20 bits, 9..12
+
+  // 2-point calibration
+  float    vRawLow, vCalLow, vRawHigh, vCalHigh;
+  float    iRawLow, iCalLow, iRawHigh, iCalHigh;
+  float    tempOffsetC;
+  float    tempCoef;          // V/°C, OCV temperature compensation
+
+  // Rest detection
+  float    restIThresholdA;
+  float    restVStabilityMv;
+  uint32_t restHoldS;
+
+  // Full charge detection (12V reference)
+  float    fullVAbsorbV;
+  float    fullITailA;
+  uint32_t fullHoldS;
+
+  // Equivalent circuit (terminal ohms) for SOC_ESTIMATOR_EKF
+  float    r0Ohms;
+  float    r1Ohms;
+  float    tauS;
+
+  // Fault thresholds (voltages 12V reference)
+  float    voltMin12V, voltMax12V;
+  float    currMaxA;
+  float    tempMaxC;
+};
+
+// Expand the BATTn_* defines of bank n into a BankConfig
+#define BANK_CONFIG(n) {                                                        \
+  BATT##n##_CHEMISTRY, BATT##n##_NOMINAL_V, BATT##n##_CAPACITY_AH,               \
+  BATT##n##_PEUKERT_EXP, BATT##n##_CHARGE_EFF, SHUNT##n##_OHMS, SHUNT##n##_MAX_AMPS, \
+  INA226_ADDR##n, INA226_ALERT_PIN##n,                                           \
+  DS18B20_ADDR##n, BATT##n##_TEMP_RESOLUTION,                                    \
+  BATT##n##_V_RAW_LOW, BATT##n##_V_CAL_LOW, BATT##n##_V_RAW_HIGH, BATT##n##_V_CAL_HIGH, \
+  BATT##n##_I_RAW_LOW, BATT##n##_I_CAL_LOW, BATT##n##_I_RAW_HIGH, BATT##n##_I_CAL_HIGH, \
+  BATT##n##_TEMP_OFFSET, BATT##n##_TEMP_COEF,                                    \
+  BATT##n##_REST_I_THRESHOLD_A, BATT##n##_REST_V_STABILITY_MV, BATT##n##_REST_HOLD_TIME_S, \
+  BATT##n##_FULL_V_ABSORB_V, BATT##n##_FULL_I_TAIL_A, BATT##n##_FULL_HOLD_TIME_S,  \
+  BATT##n##_EKF_R0_OHMS, BATT##n##_EKF_R1_OHMS, BATT##n##_EKF_TAU_S,              \
+  BATT##n##_VOLT_MIN_12V, BATT##n##_VOLT_MAX_12V, BATT##n##_CURR_MAX_A, BATT##n##_TEMP_MAX_C }
+
+// ==========================
+// Compensated accumulator
+// ==========================
+//
+// A plain float total loses increments below half its ULP:
+// ~1e-7 Ah per sample against ~100 Ah (ULP ~7.6e-6) is mostly
+// rounded away, and the faster the loop the more is lost.
+// Each add is a TwoSum: `comp` carries the exact rounding
+// error of the last addition into the next one, so the total
+// behaves like a ~48-bit accumulator at float cost.
+// Must not be compiled with -ffast-math.
+
+struct CompensatedSum {
+  float sum;
+  float comp;
+
+  void  set(float v)    { sum = v; comp = 0.0f; }
+  float value() const   { return sum + comp; }
+  void  add(float x) {
+    float y  = x + comp;
+    float t  = sum + y;
+    float bp = t - sum;
+    comp = (sum - (t - bp)) + (y - bp);
+    sum  = t;
+  }
+};
+
+// ==========================
+// Fixed-point counter units (COULOMB_FIXED_POINT)
+// ==========================
+//
+// Raw registers are calibrated per sample with Q32 gains into
+// Q16 amps / Q16 volts; power is kept in Q12 watts. Charge and
+// energy are counted as trapezoid sums (prev + cur) * dt_us,
+// i.e. in units of 2 * Q16 A·µs and 2 * Q12 W·µs. int64 holds
+// ~19000 Ah and ~300 kWh before overflow.
+
+#define FIXED_AH_UNITS  (3.6e9 * 65536.0 * 2.0)  // counter units per Ah
+#define FIXED_WH_UNITS  (3.6e9 * 4096.0 * 2.0)   // counter units per Wh
+
+// ==========================
+// Peukert lookup table
+// ==========================
+//
+// Discharge current is scaled by (I / I20)^(k - 1), where I20
+// is the 20-hour rate (capacity / 20); up to I20 the factor is
+// 1. The factor is tabulated per bank at init over I20..shunt
+// max in PEUKERT_TABLE_SIZE steps and linearly interpolated
+// (starting at I20 keeps the kink out of the table), so the
+// per-sample cost is a compare, an index and a few
+// multiplies. Currents above the shunt range use the last
+// entry. Interpolation error is below 0.1 % for k <= 1.1
+// and about 0.2 % at k = 1.3.
+
+#define PEUKERT_TABLE_SIZE 128
+
+// ==========================
+// Bank state table
+// ==========================
+
+template <size_t N>
+struct BatteryTable {
+  static const size_t count = N;
+
+  // Raw sensor values
+  float raw_voltage[N];
+  float raw_current[N];
+  float raw_power[N];
+  float raw_temp_C[N];
+  float raw_temp_K[N];
+
+  // Calibrated sensor values
+  float calibrated_voltage[N];
+  float calibrated_current[N];
+  float calibrated_power[N];
+  float calibrated_temp_C[N];
+  float calibrated_temp_K[N];
+
+  // Smoothed sensor values
+  float smooth_voltage[N];
+  float smooth_current[N];
+  float smooth_power[N];
+  float smooth_temp_C[N];
+  float smooth_temp_K[N];
+
+  // SOC / SOH / capacity tracking
+  // remaining_Ah/_Wh mirror the accumulators after every update;
+  // soc_percent is only published once socValid is set
+  bool  socValid[N];
+  float soc_percent[N];
+  float soh_percent[N];
+  float remaining_Ah[N];
+  float remaining_Wh[N];
+  float learned_capacity_Ah[N];
+
+  // Coulomb counting (trapezoidal, per INA226 conversion)
+  float effective_current[N]; // after Peukert / charge efficiency
+#ifdef COULOMB_FIXED_POINT
+  int32_t  peukertQ[N][PEUKERT_TABLE_SIZE + 1];  // Q16 factor
+  int64_t  peukertStartQ[N];  // I20, Q16 A
+  int64_t  peukertScaleQ[N];  // Q16 A above I20 -> Q16 table position
+  int32_t  chargeEffQ[N];     // Q16
+  int16_t  shuntRaw[N];       // INA226 registers of the last conversion
+  uint16_t busRaw[N];
+  int64_t  kI[N], bI[N];      // raw shunt LSB -> Q16 A (Q32 gain/offset)
+  int64_t  kV[N], bV[N];      // raw bus LSB   -> Q16 V
+  int32_t  sampleI[N];        // Q16 A
+  int32_t  sampleV[N];        // Q16 V
+  int64_t  sampleP[N];        // Q12 W
+  int64_t  lastSampleI[N];
+  int64_t  lastSampleP[N];
+  int64_t  count_Ah[N];       // remaining charge, FIXED_AH_UNITS per Ah
+  int64_t  count_Wh[N];       // remaining energy, FIXED_WH_UNITS per Wh
+  int64_t  count_capacity[N]; // learned capacity in count_Ah units
+  int64_t  count_net[N];      // unclamped net charge, count_Ah units
+#else
+  float    peukert[N][PEUKERT_TABLE_SIZE + 1];
+  float    peukertStart[N];   // I20, A
+  float    peukertScale[N];   // A above I20 -> table position
+  CompensatedSum acc_Ah[N];
+  CompensatedSum acc_Wh[N];
+  CompensatedSum acc_net[N];  // unclamped net charge (Ah) for learning
+  float    lastSampleA[N];
+  float    lastSampleW[N];
+#endif
+  uint32_t lastSampleUs[N];
+  bool     haveSample[N];
+
+  // Rest detection state
+  bool     isResting[N];
+  uint32_t restStartMs[N];       // current last above the rest threshold
+  float    lastRestVoltage[N];
+  MinMaxWindow restWindow[N];    // voltage over the rest hold time
+
+  // Full charge detection state
+  bool     isFull[N];
+  uint32_t fullStartMs[N];       // absorb/tail condition last false
+
+  // Capacity learning: last SoC anchor (full or OCV at rest)
+  bool     haveAnchor[N];
+  float    anchorSoc[N];
+  float    anchorNetAh[N];       // net charge counter at the anchor
+  uint32_t anchorMs[N];
+  uint16_t learnUpdates[N];      // accepted capacity estimates
+  uint32_t socResyncs[N];        // counter resets to an anchor SoC
+
+#ifdef SOC_ESTIMATOR_EKF
+  // Model-based estimator, corrects the counter per conversion
+  SocEkf ekf[N];
+#endif
+
+  // Time to empty / full (Runtime.h), NAN when not available
+  LoadHorizons<N> loadStats;
+  float    loadA[N];             // effective current the prediction uses
+  float    timeToEmptyS[N];
+  float    timeToFullS[N];
+  uint32_t lastLoadUs[N];
+
+  // Limit checks (Faults.h) on every sample
+  FaultMonitor<N> faults;
+
+  // SoC restored from the journal (flash), NAN if none
+  float stored_soc[N];
+
+  // Acquisition: a new INA226 conversion was read this pass
+  bool     fresh[N];
+  uint32_t sampleUs[N];
+  bool     tempFresh[N];        // a new DS18B20 reading this pass
+
+  // Smoothing (Filters.h, one filter per quantity for all banks)
+  bool tempValid[N];          // raw_temp_C is a reading
+  SmoothingFilter<N, VOLTAGE_FILTER, VOLTAGE_FILTER_SAMPLES> filt_voltage;
+  SmoothingFilter<N, CURRENT_FILTER, CURRENT_FILTER_SAMPLES> filt_current;
+  SmoothingFilter<N, TEMP_FILTER, TEMP_FILTER_SAMPLES>       filt_temp_C;
+};
+
+// ==========================
+// Pipeline steps
+// ==========================
+
+inline float applyCalibration(float raw, float rawLow, float calLow, float rawHigh, float calHigh) {
+  float slope = (calHigh - calLow) / (rawHigh - rawLow);
+  float offset = calLow - slope * rawLow;
+  return slope * raw + offset;
+}
+
+// Set the charge of bank i (SoC initialization / restore)
+template <size_t N>
+void setBankCharge(BatteryTable<N>& b, size_t i, float ah, float wh) {
+#ifdef COULOMB_FIXED_POINT
+  b.count_Ah[i] = llround((double)ah * FIXED_AH_UNITS);
+  b.count_Wh[i] = llround((double)wh * FIXED_WH_UNITS);
+  b.count_capacity[i] = llround((double)b.learned_capacity_Ah[i] * FIXED_AH_UNITS);
+#else
+  b.acc_Ah[i].set(ah);
+  b.acc_Wh[i].set(wh);
+#endif
+  b.remaining_Ah[i] = ah;
+  b.remaining_Wh[i] = wh;
+#ifdef SOC_ESTIMATOR_EKF
+  b.ekf[i].resetSoc(EKF_INIT_SOC_SIGMA_PCT / 100.0f);
+#endif
+}
+
+// Reset the charge of bank i to a known SoC anchor (Wh and the
+// net learning counter keep running)
+template <size_t N>
+void setBankAh(BatteryTable<N>& b, size_t i, float ah) {
+#ifdef COULOMB_FIXED_POINT
+  b.count_Ah[i] = llround((double)ah * FIXED_AH_UNITS);
+  b.count_capacity[i] = llround((double)b.learned_capacity_Ah[i] * FIXED_AH_UNITS);
+#else
+  b.acc_Ah[i].set(ah);
+#endif
+  b.remaining_Ah[i] = ah;
+  b.socResyncs[i]++;
+#ifdef SOC_ESTIMATOR_EKF
+  b.ekf[i].resetSoc(EKF_ANCHOR_SOC_SIGMA_PCT / 100.0f);
+#endif
+}
+
+// Unclamped net charge (Ah) counted since boot
+template <size_t N>
+float bankNetAh(const BatteryTable<N>& b, size_t i) {
+#ifdef COULOMB_FIXED_POINT
+  return (float)((double)b.count_net[i] * (1.0 / FIXED_AH_UNITS));
+#else
+  return b.acc_net[i].value();
+#endif
+}
+
+// Tabulate the Peukert factor of bank i (init only; uses powf)
+template <size_t N>
+void buildPeukertTable(BatteryTable<N>& b, size_t i, const BankConfig& c) {
+  float i20 = c.capacityAh / 20.0f;
+  float span = fmaxf(c.shuntMaxA - i20, 1.0f);
+  for (int k = 0; k <= PEUKERT_TABLE_SIZE; k++) {
+    float a = i20 + k * span / PEUKERT_TABLE_SIZE;
+    float f = powf(a / i20, c.peukertExp - 1.0f);
+#ifdef COULOMB_FIXED_POINT
+    b.peukertQ[i][k] = (int32_t)lroundf(f * 65536.0f);
+#else
+    b.peukert[i][k] = f;
+#endif
+  }
+#ifdef COULOMB_FIXED_POINT
+  b.peukertStartQ[i] = llround((double)i20 * 65536.0);
+  b.peukertScaleQ[i] = llround((double)PEUKERT_TABLE_SIZE / span * 65536.0);
+  b.chargeEffQ[i] = (int32_t)lroundf(c.chargeEff * 65536.0f);
+#else
+  b.peukertStart[i] = i20;
+  b.peukertScale[i] = PEUKERT_TABLE_SIZE / span;
+#endif
+}
+
+// Reset all banks to their configured defaults
+template <size_t N>
+void initBanks(BatteryTable<N>& b, const BankConfig* cfg) {
+  for (size_t i = 0; i < N; i++) {
+    buildPeukertTable(b, i, cfg[i]);
+    b.soh_percent[i] = 100.0f;
+    b.socValid[i] = false;
+    b.stored_soc[i] = NAN;
+    b.haveSample[i] = false;
+    b.raw_temp_C[i] = HAL_TEMP_DISCONNECTED;   // no DS18B20 conversion yet
+    b.loadA[i] = NAN;
+    b.timeToEmptyS[i] = NAN;
+    b.timeToFullS[i] = NAN;
+    b.tempFresh[i] = false;
+#ifdef SOC_ESTIMATOR_EKF
+    b.ekf[i].begin(EKF_INIT_SOC_SIGMA_PCT / 100.0f, EKF_V1_INIT_SIGMA_MV * cfg[i].nominalV / 12000.0f);
+#endif
+    setBankCharge(b, i, cfg[i].capacityAh, 0.0f);
+#ifdef COULOMB_FIXED_POINT
+    const BankConfig& c = cfg[i];
+    double iSlope = (double)(c.iCalHigh - c.iCalLow) / (c.iRawHigh - c.iRawLow);
+    double iOffset = c.iCalLow - iSlope * c.iRawLow;
+    double vSlope = (double)(c.vCalHigh - c.vCalLow) / (c.vRawHigh - c.vRawLow);
+    double vOffset = c.vCalLow - vSlope * c.vRawLow;
+    b.kI[i] = llround(iSlope * (INA226_SHUNT_LSB_V / c.shuntOhms) * 4294967296.0);
+    b.bI[i] = llround(iOffset * 4294967296.0);
+    b.kV[i] = llround(vSlope * INA226_BUS_LSB_V * 4294967296.0);
+    b.bV[i] = llround(vOffset * 4294967296.0);
+#endif
+    b.learned_capacity_Ah[i] = cfg[i].capacityAh;
+    b.haveAnchor[i] = false;
+  }
+  b.filt_voltage.begin();
+  b.filt_current.begin();
+  b.filt_temp_C.begin();
+  b.loadStats.begin();
+  b.faults.begin();
+}
+
+// Raw → calibrated → smoothed. V/I enter their filters only
+// for banks with a fresh conversion (b.fresh), temperature
+// only while the DS18B20 reads.
+template <size_t N>
+void processBankSamples(BatteryTable<N>& b, const BankConfig* cfg) {
+  for (size_t i = 0; i < N; i++) {
+    const BankConfig& c = cfg[i];
+
+    b.calibrated_temp_C[i] = b.raw_temp_C[i] + c.tempOffsetC;
+    b.calibrated_temp_K[i] = b.calibrated_temp_C[i] + 273.15f;
+    b.tempValid[i] = b.raw_temp_C[i] != HAL_TEMP_DISCONNECTED;
+
+    if (b.fresh[i]) {
+#ifdef COULOMB_FIXED_POINT
+      // Integer calibration; the float values below are views
+      // for smoothing and display only.
+      b.sampleI[i] = (int32_t)((b.shuntRaw[i] * b.kI[i] + b.bI[i] + (1LL << 15)) >> 16);
+      b.sampleV[i] = (int32_t)((b.busRaw[i] * b.kV[i] + b.bV[i] + (1LL << 15)) >> 16);
+      b.sampleP[i] = ((int64_t)b.sampleV[i] * b.sampleI[i] + (1LL << 19)) >> 20;
+      b.raw_voltage[i] = b.busRaw[i] * (float)INA226_BUS_LSB_V;
+      b.raw_current[i] = b.shuntRaw[i] * (float)(INA226_SHUNT_LSB_V / c.shuntOhms);
+      b.calibrated_voltage[i] = b.sampleV[i] * (1.0f / 65536.0f);
+      b.calibrated_current[i] = b.sampleI[i] * (1.0f / 65536.0f);
+#else
+      b.calibrated_voltage[i] = applyCalibration(b.raw_voltage[i], c.vRawLow, c.vCalLow, c.vRawHigh, c.vCalHigh);
+      b.calibrated_current[i] = applyCalibration(b.raw_current[i], c.iRawLow, c.iCalLow, c.iRawHigh, c.iCalHigh);
+#endif
+      b.raw_power[i] = b.raw_voltage[i] * b.raw_current[i];
+      b.calibrated_power[i]   = b.calibrated_voltage[i] * b.calibrated_current[i];
+    }
+  }
+
+  b.filt_voltage.update(b.calibrated_voltage, b.fresh);
+  b.filt_current.update(b.calibrated_current, b.fresh);
+  b.filt_temp_C.update(b.calibrated_temp_C, b.tempValid);
+
+  for (size_t i = 0; i < N; i++) {
+    b.smooth_voltage[i] = b.filt_voltage.value(i);
+    b.smooth_current[i] = b.filt_current.value(i);
+    b.smooth_temp_C[i]  = b.filt_temp_C.value(i);
+    b.smooth_power[i]   = b.smooth_voltage[i] * b.smooth_current[i];
+    b.smooth_temp_K[i]  = b.smooth_temp_C[i] + 273.15f;
+  }
+}
+
+// Limits against the calibrated samples of this pass (before
+// smoothing): V/I per new INA226 conversion, temperature per
+// new DS18B20 reading. Voltage limits and hysteresis are per
+// 12 V and scale with the nominal voltage.
+template <size_t N>
+void checkBankFaults(BatteryTable<N>& b, const BankConfig* cfg, uint32_t nowMs) {
+  for (size_t i = 0; i < N; i++) {
+    const BankConfig& c = cfg[i];
+    if (b.fresh[i]) {
+      float scale = c.nominalV / 12.0f;
+      float v = b.calibrated_voltage[i];
+      float a = fabsf(b.calibrated_current[i]);
+      float vMin = c.voltMin12V * scale;
+      float vMax = c.voltMax12V * scale;
+      float vHyst = FAULT_VOLT_HYST_12V * scale;
+      b.faults.sample(i, FAULT_VOLT_LOW, v < vMin, v >= vMin + vHyst, nowMs);
+      b.faults.sample(i, FAULT_VOLT_HIGH, v > vMax, v <= vMax - vHyst, nowMs);
+      b.faults.sample(i, FAULT_CURR_HIGH, a > c.currMaxA,
+                      a <= c.currMaxA * (1.0f - FAULT_CURR_HYST_PCT / 100.0f), nowMs);
+    }
+    if (b.tempFresh[i] && b.tempValid[i]) {
+      float t = b.calibrated_temp_C[i];
+      b.faults.sample(i, FAULT_TEMP_HIGH, t > c.tempMaxC, t <= c.tempMaxC - FAULT_TEMP_HYST_C, nowMs);
+    }
+  }
+}
+
+// Current that is counted against capacity: discharge (> 0)
+// scaled by the Peukert factor, charge (< 0) by the charge
+// efficiency.
+#ifdef COULOMB_FIXED_POINT
+template <size_t N>
+inline int64_t effectiveCurrentQ(const BatteryTable<N>& b, size_t i, int64_t a) {
+  if (a <= 0) return (a * b.chargeEffQ[i] + (1LL << 15)) >> 16;
+  if (a <= b.peukertStartQ[i]) return a;
+  int64_t pos = ((a - b.peukertStartQ[i]) * b.peukertScaleQ[i]) >> 16;
+  int64_t f;
+  if (pos >= ((int64_t)PEUKERT_TABLE_SIZE << 16)) {
+    f = b.peukertQ[i][PEUKERT_TABLE_SIZE];
+  } else {
+    int k = (int)(pos >> 16);
+    int64_t frac = pos & 0xFFFF;
+    f = b.peukertQ[i][k] + (((b.peukertQ[i][k + 1] - b.peukertQ[i][k]) * frac) >> 16);
+  }
+  return (a * f + (1LL << 15)) >> 16;
+}
+#else
+template <size_t N>
+inline float effectiveCurrent(const BatteryTable<N>& b, const BankConfig& c, size_t i, float a) {
+  if (a <= 0) return a * c.chargeEff;
+  if (a <= b.peukertStart[i]) return a;
+  float pos = (a - b.peukertStart[i]) * b.peukertScale[i];
+  if (pos >= PEUKERT_TABLE_SIZE) return a * b.peukert[i][PEUKERT_TABLE_SIZE];
+  int k = (int)pos;
+  float f = b.peukert[i][k] + (pos - k) * (b.peukert[i][k + 1] - b.peukert[i][k]);
+  return a * f;
+}
+#endif
+
+// Coulomb counting: for every bank with a fresh conversion,
+// integrate effective current and calibrated power (energy is
+// not rate-corrected) over the interval since its previous
+// conversion (trapezoid, µs timestamps from the conversion-
+// ready edge). The 32-bit µs difference is wrap-safe for gaps
+// below ~71 minutes.
+template <size_t N>
+void integrateBanks(BatteryTable<N>& b, const BankConfig* cfg) {
+  for (size_t i = 0; i < N; i++) {
+    if (!b.fresh[i]) continue;
+#ifdef COULOMB_FIXED_POINT
+    int64_t a = effectiveCurrentQ(b, i, b.sampleI[i]);
+    int64_t w = b.sampleP[i];
+    b.effective_current[i] = a * (1.0f / 65536.0f);
+
+    if (b.haveSample[i]) {
+      int64_t dtUs = (uint32_t)(b.sampleUs[i] - b.lastSampleUs[i]);
+      b.count_Ah[i] -= (a + b.lastSampleI[i]) * dtUs;
+      b.count_net[i] -= (a + b.lastSampleI[i]) * dtUs;
+      b.count_Wh[i] -= (w + b.lastSampleP[i]) * dtUs;
+
+      if (b.count_Ah[i] > b.count_capacity[i]) b.count_Ah[i] = b.count_capacity[i];
+      if (b.count_Ah[i] < 0) b.count_Ah[i] = 0;
+    }
+    b.lastSampleI[i] = a;
+    b.lastSampleP[i] = w;
+#else
+    float a = effectiveCurrent(b, cfg[i], i, b.calibrated_current[i]);
+    float w = b.calibrated_power[i];
+    b.effective_current[i] = a;
+
+    if (b.haveSample[i]) {
+      float hours = (float)(uint32_t)(b.sampleUs[i] - b.lastSampleUs[i]) * (1.0f / 3.6e9f);
+      float dAh = -0.5f * (a + b.lastSampleA[i]) * hours;
+      b.acc_Ah[i].add(dAh);
+      b.acc_net[i].add(dAh);
+      b.acc_Wh[i].add(-0.5f * (w + b.lastSampleW[i]) * hours);
+
+      float ah = b.acc_Ah[i].value();
+      if (ah > b.learned_capacity_Ah[i]) b.acc_Ah[i].set(b.learned_capacity_Ah[i]);
+      if (ah < 0) b.acc_Ah[i].set(0.0f);
+
+      b.remaining_Ah[i] = b.acc_Ah[i].value();
+      b.remaining_Wh[i] = b.acc_Wh[i].value();
+    }
+    b.lastSampleA[i] = a;
+    b.lastSampleW[i] = w;
+#endif
+    b.lastSampleUs[i] = b.sampleUs[i];
+    b.haveSample[i]   = true;
+  }
+}
+
+#ifdef SOC_ESTIMATOR_EKF
+// Remaining charge of bank i as counted so far (Ah)
+template <size_t N>
+float bankAh(const BatteryTable<N>& b, size_t i) {
+#ifdef COULOMB_FIXED_POINT
+  return (float)((double)b.count_Ah[i] * (1.0 / FIXED_AH_UNITS));
+#else
+  return b.acc_Ah[i].value();
+#endif
+}
+
+// Add a correction to the counted charge of bank i, clamped to
+// 0..capacity like the counter. Returns what was applied.
+template <size_t N>
+float adjustBankAh(BatteryTable<N>& b, size_t i, float dAh) {
+  float before = bankAh(b, i);
+#ifdef COULOMB_FIXED_POINT
+  b.count_Ah[i] += llround((double)dAh * FIXED_AH_UNITS);
+  if (b.count_Ah[i] > b.count_capacity[i]) b.count_Ah[i] = b.count_capacity[i];
+  if (b.count_Ah[i] < 0) b.count_Ah[i] = 0;
+#else
+  b.acc_Ah[i].add(dAh);
+  float ah = b.acc_Ah[i].value();
+  if (ah > b.learned_capacity_Ah[i]) b.acc_Ah[i].set(b.learned_capacity_Ah[i]);
+  if (ah < 0) b.acc_Ah[i].set(0.0f);
+  b.remaining_Ah[i] = b.acc_Ah[i].value();
+#endif
+  return bankAh(b, i) - before;
+}
+
+// Model-based correction: for every bank with a fresh
+// conversion and a valid SoC, run the EKF (Ekf.h) on the
+// counter's SoC and the measured voltage, and add its SoC
+// correction to the counter. Runs after integrateBanks(). OCV
+// comes from the chemistry table (12V reference, scaled and
+// temperature compensated like the grid lookup); without a
+// temperature reading 25 C is assumed.
+template <size_t N>
+void estimateBanks(BatteryTable<N>& b, const BankConfig* cfg) {
+  for (size_t i = 0; i < N; i++) {
+    SocEkf& f = b.ekf[i];
+    if (!b.fresh[i] || !b.socValid[i]) continue;
+    uint32_t dtUs = b.sampleUs[i] - f.lastUs;
+    f.lastUs = b.sampleUs[i];
+    if (!f.haveSample) {
+      f.haveSample = true;
+      continue;
+    }
+
+    const BankConfig& c = cfg[i];
+    float scale = c.nominalV / 12.0f;
+    float cap = b.learned_capacity_Ah[i];
+    float tC = isnan(b.smooth_temp_C[i]) ? 25.0f : b.smooth_temp_C[i];
+    float slope;
+    float ocv = scale * ocvVoltage(ocvTableForChem(c.chemistry), 100.0f * bankAh(b, i) / cap, slope) +
+                c.tempCoef * (tC - 25.0f);
+
+    SocEkfParams p;
+    p.r0 = c.r0Ohms;
+    p.r1 = c.r1Ohms;
+    p.tauS = c.tauS;
+    p.socVarPerH = (EKF_SOC_DRIFT_PCT_H / 100.0f) * (EKF_SOC_DRIFT_PCT_H / 100.0f);
+    p.v1VarPerS = (EKF_V1_DRIFT_MV_S * scale / 1000.0f) * (EKF_V1_DRIFT_MV_S * scale / 1000.0f);
+    p.voltVar = (EKF_VOLTAGE_NOISE_MV * scale / 1000.0f) * (EKF_VOLTAGE_NOISE_MV * scale / 1000.0f);
+    p.irVar = (EKF_LOAD_NOISE_MOHM * scale / 1000.0f) * (EKF_LOAD_NOISE_MOHM * scale / 1000.0f);
+    p.corrS = EKF_MODEL_ERROR_S;
+
+    float dSoc = f.update(dtUs, b.calibrated_current[i], b.calibrated_voltage[i], ocv, 100.0f * scale * slope, p);
+    f.correctionAh += adjustBankAh(b, i, dSoc * cap);
+  }
+}
+#endif
+
+// Time to empty / full: every fresh conversion goes into the
+// bank's load horizons (Runtime.h), and the load they give
+// divides the charge left to empty or to full. Both are NAN
+// below the rest current threshold, before the SoC is valid,
+// and time to full once the bank is full. Remaining Ah is as
+// of this conversion (float counter) or of the last SoC
+// update (COULOMB_FIXED_POINT).
+template <size_t N>
+void predictBanks(BatteryTable<N>& b, const BankConfig* cfg) {
+  for (size_t i = 0; i < N; i++) {
+    if (!b.fresh[i]) continue;
+    const BankConfig& c = cfg[i];
+    float dtS = (uint32_t)(b.sampleUs[i] - b.lastLoadUs[i]) * 1e-6f;
+    b.lastLoadUs[i] = b.sampleUs[i];
+    if (b.loadStats.weight[0][i] == 0.0f) dtS = 0.001f;   // first sample: any small weight
+    b.loadStats.add(i, b.effective_current[i], dtS, c.restIThresholdA);
+
+    float load = b.loadStats.load(i);
+    b.loadA[i] = load;
+    b.timeToEmptyS[i] = NAN;
+    b.timeToFullS[i] = NAN;
+    if (!b.socValid[i] || !(fabsf(load) >= c.restIThresholdA)) continue;
+    if (load > 0.0f) {
+      b.timeToEmptyS[i] = 3600.0f * b.remaining_Ah[i] / load;
+    } else if (!b.isFull[i]) {
+      b.timeToFullS[i] = 3600.0f * (b.learned_capacity_Ah[i] - b.remaining_Ah[i]) / -load;
+    }
+  }
+}
+
+// SoC from the counted charge, SoH from learned vs nominal capacity
+template <size_t N>
+void updateBankSoc(BatteryTable<N>& b, const BankConfig* cfg) {
+  for (size_t i = 0; i < N; i++) {
+#ifdef COULOMB_FIXED_POINT
+    // Counters → float happens here, not per sample
+    b.remaining_Ah[i] = (float)((double)b.count_Ah[i] * (1.0 / FIXED_AH_UNITS));
+    b.remaining_Wh[i] = (float)((double)b.count_Wh[i] * (1.0 / FIXED_WH_UNITS));
+    b.count_capacity[i] = llround((double)b.learned_capacity_Ah[i] * FIXED_AH_UNITS);
+#endif
+    b.soc_percent[i] = 100.0f * (b.remaining_Ah[i] / b.learned_capacity_Ah[i]);
+
+    b.soh_percent[i] = 100.0f * (b.learned_capacity_Ah[i] / cfg[i].capacityAh);
+    b.soh_percent[i] = fminf(fmaxf(b.soh_percent[i], 0.0f), 100.0f);
+  }
+}
+
+// What the NMEA2000 and debug output read of a bank: one
+// coherent copy (values of the same sensor pass and SoC
+// update), published under a seqlock (Seqlock.h) after every
+// sensor pass with a new reading and every SoC update. The
+// readers never see the table itself.
+struct BankTier {
+  float volts, amps, watts, tempC, tempK;
+};
+
+struct BankSnapshot {
+  uint32_t ms;                  // published at
+  BankTier raw, cal, smooth;
+  float    socPercent;          // meaningful once socValid
+  float    sohPercent;
+  float    remainingAh, remainingWh;
+  float    loadA;               // load the prediction uses
+  float    timeToEmptyS;        // NAN: not predicted
+  float    timeToFullS;
+  uint8_t  loadHorizon;         // LoadHorizons index of loadA
+  uint8_t  faults;              // active faults, bit per FaultType
+  bool     socValid, resting, full;
+};
+
+template <size_t N>
+void snapshotBank(const BatteryTable<N>& b, size_t i, uint32_t nowMs, BankSnapshot& s) {
+  s.ms = nowMs;
+  s.raw    = { b.raw_voltage[i], b.raw_current[i], b.raw_power[i], b.raw_temp_C[i], b.raw_temp_K[i] };
+  s.cal    = { b.calibrated_voltage[i], b.calibrated_current[i], b.calibrated_power[i],
+               b.calibrated_temp_C[i], b.calibrated_temp_K[i] };
+  s.smooth = { b.smooth_voltage[i], b.smooth_current[i], b.smooth_power[i],
+               b.smooth_temp_C[i], b.smooth_temp_K[i] };
+  s.socPercent   = b.soc_percent[i];
+  s.sohPercent   = b.soh_percent[i];
+  s.remainingAh  = b.remaining_Ah[i];
+  s.remainingWh  = b.remaining_Wh[i];
+  s.loadA        = b.loadA[i];
+  s.timeToEmptyS = b.timeToEmptyS[i];
+  s.timeToFullS  = b.timeToFullS[i];
+  s.loadHorizon  = (uint8_t)b.loadStats.horizon(i);
+  s.faults       = b.faults.active[i];
+  s.socValid     = b.socValid[i];
+  s.resting      = b.isResting[i];
+  s.full         = b.isFull[i];
+}
+
+// Publish the banks selected by `which` (nullptr: all)
+template <size_t N>
+void publishBanks(const BatteryTable<N>& b, Seqlock<BankSnapshot>* out, uint32_t nowMs,
+                  const bool* which = nullptr) {
+  for (size_t i = 0; i < N; i++) {
+    if (which && !which[i]) continue;
+    BankSnapshot s;
+    snapshotBank(b, i, nowMs, s);
+    out[i].write(s);
+  }
+}
+
+#endif // BATTERY_H
@@ -2,22 +2,52 @@
 #include "Globals.h"
 #include "Sensors.h"
 #include "Soc.h"
-
-#include <NMEA2000_esp32.h>   // ESP32 built-in CAN controller
+#include "Scheduler.h"
 #include "Nmea.h"
+#include "Hal.h"
+
+static bool split = false;   // publishing stages run in their own task
+
+#ifdef DEBUG_OUTPUT
+static void debugStage() {
+  debugPrint();          // Print debug values
+  schedulerDebugPrint(); // Print stage timing statistics
+}
+#endif
+
+static void publishTask() {
+  schedulerRun(CORE_PUBLISH);
+}
 
 void setup() {
   setupSensors();  // Initialize INA226 + DS18B20
-  setupSoc();      // Initialize SoC tracking (EEPROM + OCV fallback)
+  setupSoc();      // Initialize SoC tracking (flash journal + OCV fallback)
   setupNmea();     // Initialize NMEA2000
-}
-
-void loop() {
-  readSensors();   // Read sensors, update raw/calibrated/smoothed globals
-  updateSoc();     // Update SoC and remaining capacity
-  nmeaLoop();      // Handle NMEA2000 messages
 
+  // Fixed-rate stages, run in this order when due together:
+  // acquisition on CORE_ACQUIRE (this loop task), publishing
+  // on CORE_PUBLISH
+  schedulerAdd("sensors", readSensors, SENSOR_SAMPLE_HZ, CORE_ACQUIRE); // Read sensors, update raw/calibrated/smoothed globals
+  schedulerAdd("temp",    tempStep,    TEMP_STEP_HZ,     CORE_ACQUIRE); // One DS18B20 bus step, between INA226 conversions
+  // Journal writes, with no phase relation to the sensors
+  // stage on the other core: only the sensorSlackUs() guard
+  // in persistWrite() holds a sector erase until the next
+  // INA226 conversion is PERSIST_ERASE_US away. The erase
+  // still stalls the flash cache of both cores, so it blocks
+  // acquisition while it runs.
+  schedulerAdd("persist", persistStep, SENSOR_SAMPLE_HZ, CORE_PUBLISH);
+  schedulerAdd("soc",     updateSoc,   SOC_UPDATE_HZ,    CORE_ACQUIRE); // Update SoC and remaining capacity
+  schedulerAdd("nmea",    nmeaLoop,    NMEA_POLL_HZ,     CORE_PUBLISH); // Drain the sample ring, handle NMEA2000 messages
 #ifdef DEBUG_OUTPUT
-  debugPrint();    // Print debug values if enabled
+  schedulerAdd("debug",   debugStage,  DEBUG_PRINT_HZ,   CORE_PUBLISH);
 #endif
+  schedulerBegin();
+
+  // Without a second core (or with SINGLE_CORE) loop() runs
+  // every stage
+  split = halStartTask("publish", publishTask, CORE_PUBLISH);
+}
+
+void loop() {
+  schedulerRun(split ? CORE_ACQUIRE : SCHED_ALL_CORES);  // Run due stages, idle until the next deadline
 }
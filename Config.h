@@ -14,12 +14,24 @@ CONFIGURATION STEPS
        #define DEBUG_OUTPUT
    - Leave it commented out for silent operation.
 
+1a. Number of Batteries
+   - Banks 1..NUM_BATTERIES are monitored (1–4). Every
+     per-battery setting below exists for banks 1–4 (house,
+     start, thruster, windlass); settings of banks above
+     NUM_BATTERIES are ignored.
+       #define NUM_BATTERIES 2
+
 2. System Voltage (per battery)
    - Select ONE option per battery:
        #define BATT1_SYSTEM_VOLTAGE_12V
        // #define BATT1_SYSTEM_VOLTAGE_24V
+       // #define BATT1_SYSTEM_VOLTAGE_48V
        #define BATT2_SYSTEM_VOLTAGE_12V
        // #define BATT2_SYSTEM_VOLTAGE_24V
+   - Voltage thresholds given per 12V reference (OCV tables,
+     absorb, rest stability, faults) scale with the selection.
+     The INA226 bus input is limited to 36 V: a 48V bank needs
+     a divider, corrected by the voltage calibration (9.).
 
 3. Battery Chemistry
    - Choose per battery: CHEM_FLA, CHEM_AGM, CHEM_GEL, CHEM_LFP
@@ -34,22 +46,56 @@ CONFIGURATION STEPS
 5. Peukert Exponent (per battery)
    - Dimensionless number describing rate-capacity effect.
    - Typical: 1.05–1.3 for lead-acid, ~1.05 for LiFePO4.
+   - Discharge above the 20 h rate (capacity / 20) is counted
+     as I * (I / I20)^(k - 1). Use 1.0 to disable.
        #define BATT1_PEUKERT_EXP   1.10
        #define BATT2_PEUKERT_EXP   1.05
 
 6. Charge Efficiency (per battery)
    - Fraction of charging energy retained (0.0–1.0).
-   - Used in NMEA2000 PGN 127513.
+   - Charge current is counted as I * efficiency; also sent
+     in NMEA2000 PGN 127513.
        #define BATT1_CHARGE_EFF    0.95
        #define BATT2_CHARGE_EFF    0.96
 
-7. Capacity Learning / EEPROM Persistence
-   - Adjust learning rate, slot count, and save interval:
+7. Capacity Learning / Flash Persistence
+   - Adjust learning rate:
        #define CAPACITY_LEARNING_ALPHA   0.05
-       #define EEPROM_NUM_SLOTS          16
-       #define EEPROM_BASE_ADDR          0
-       #define EEPROM_SAVE_INTERVAL_MS   60000
+   - Capacity, SoC, remaining Wh and the estimator state
+     (learning anchor, full-charge hold time, last temperature)
+     are kept in an append-only journal in the "bmlog" flash
+     partition (partitions.csv, select it in the IDE's
+     Partition Scheme or keep the file next to the sketch).
+     Only the changed values are written, and a sector is
+     erased only when the journal wraps.
+   - A write happens when the capacity or SoC moved by its
+     deadband (at most once per JOURNAL_MIN_INTERVAL_MS), or
+     after JOURNAL_MAX_INTERVAL_MS if anything changed at all:
+       #define JOURNAL_SECTORS           2
+       #define JOURNAL_MIN_INTERVAL_MS   60000
+       #define JOURNAL_MAX_INTERVAL_MS   3600000
+       #define JOURNAL_SOC_DEADBAND_PCT  1.0f
+       #define JOURNAL_CAP_DEADBAND_AH   0.1f
+   - Writes happen in the "persist" stage, one flash operation
+     at a time. A sector erase blocks both cores for about
+     PERSIST_ERASE_US, so it waits until the next INA226
+     conversion is at least that far away (at most
+     PERSIST_MAX_DEFER_MS). PERSIST_INLINE writes directly from
+     updateSoc() instead (for comparison in the host build):
+       #define PERSIST_ERASE_US          45000
+       #define PERSIST_MAX_DEFER_MS      10000
+       // #define PERSIST_INLINE
+   - Boot: the journaled state is restored in setup(). Once
+     SOC_INIT_SAMPLES conversions are averaged, a bank's SoC is
+     checked against OCV: if the bank is near rest and the two
+     differ by more than SOC_RESUME_TOLERANCE %, OCV wins
+     (without a journal, OCV is used directly). A bank still
+     without samples after SOC_BOOT_BUDGET_MS publishes its
+     journaled SoC unchecked. The first DC status (PGN 127506)
+     goes out as soon as every bank's SoC is valid:
        #define SOC_RESUME_TOLERANCE      10.0
+       #define SOC_INIT_SAMPLES          4
+       #define SOC_BOOT_BUDGET_MS        500
 
 8. Shunt Resistors
    - Define resistance (Ω) and max current (A).
@@ -69,7 +115,10 @@ CONFIGURATION STEPS
    - Apply simple °C offsets for temp sensors.
 
 10. Temperature Compensation
-   - Coefficients in V/°C used to adjust OCV-based SoC.
+   - Coefficients in V/°C (at the battery terminals) used to
+     adjust OCV-based SoC. The OCV lookup is a table over
+     voltage and temperature built at compile time from the
+     chemistry, system voltage and this coefficient (Ocv.h).
        #define BATT1_TEMP_COEF -0.030
        #define BATT2_TEMP_COEF  0.0
 
@@ -96,19 +145,62 @@ CONFIGURATION STEPS
        #define BATT2_FULL_I_TAIL_A     2.0
        #define BATT2_FULL_HOLD_TIME_S  600
 
+12a. Model-Based SoC Estimator (optional)
+   - By default SoC is coulomb counting, resynced at full
+     charges and rest anchors. SOC_ESTIMATOR_EKF adds an
+     extended Kalman filter on a 1RC equivalent circuit
+     (Ekf.h) that corrects the counter with every INA226
+     conversion from the measured voltage, so the error stays
+     bounded between anchors where the OCV curve is steep.
+       // #define SOC_ESTIMATOR_EKF
+   - Equivalent circuit per battery, in ohms at the terminals:
+     R0 (ohmic), R1 and time constant of the RC branch:
+       #define BATT1_EKF_R0_OHMS  0.010
+       #define BATT1_EKF_R1_OHMS  0.005
+       #define BATT1_EKF_TAU_S    60.0
+   - Filter tuning (mV and mOhm per 12V reference): how fast
+     the counter may drift (% SoC per sqrt(hour)) and the RC
+     voltage (mV per s); the voltage noise, plus a model error
+     per amp that makes the filter follow the counter while
+     current flows; and how long a model error persists
+     (conversions within EKF_MODEL_ERROR_S count as one
+     measurement, so the result does not depend on the sample
+     rate). SoC uncertainty after a journal/OCV start and
+     after an anchor:
+       #define EKF_SOC_DRIFT_PCT_H       2.0
+       #define EKF_V1_DRIFT_MV_S         1.0
+       #define EKF_V1_INIT_SIGMA_MV      50.0
+       #define EKF_VOLTAGE_NOISE_MV      20.0
+       #define EKF_LOAD_NOISE_MOHM       1000.0
+       #define EKF_MODEL_ERROR_S         300.0
+       #define EKF_INIT_SOC_SIGMA_PCT    10.0
+       #define EKF_ANCHOR_SOC_SIGMA_PCT  1.0
+
 13. Capacity Learning Guardrails
-   - Learning only occurs when discharge since last full cycle
-     exceeds a minimum depth, and learned capacity is clamped
-     within a safe range relative to nominal.
+   - Capacity is learned between SoC anchors: a detected full
+     charge (100 %) or the OCV SoC when rest is entered. The
+     charge counted between two anchors divided by their SoC
+     difference is one capacity estimate.
+   - Learning only occurs when the SoC difference between the
+     anchors exceeds a minimum depth, and learned capacity is
+     clamped within a safe range relative to nominal.
+   - Rest anchors are only taken where the OCV curve is at
+     least LEARN_OCV_MIN_SLOPE_MV per % SoC (12V reference),
+     which excludes the flat LFP plateau.
        #define LEARN_MIN_DELTA_SOC_PCT    20.0
        #define LEARN_CAPACITY_MIN_FACTOR  0.5f
        #define LEARN_CAPACITY_MAX_FACTOR  2.0f
+       #define LEARN_OCV_MIN_SLOPE_MV     1.2f
+   - A span start older than LEARN_MAX_SPAN_H is dropped, since
+     shunt offset error grows with the span length.
+       #define LEARN_MAX_SPAN_H           168
 
 14. Fault Detection Thresholds
-   - Defines safe operating limits. Exceeding these can set
-     fault flags or trigger alarms. Voltage thresholds are
-     defined per 12V reference; they are doubled automatically
-     if the system is configured for 24V.
+   - Defines safe operating limits. Exceeding one sets the
+     bank's fault flag and sends an NMEA2000 alert. Voltage
+     thresholds are defined per 12V reference; they are scaled
+     automatically for 24V and 48V systems. Current is the
+     limit in either direction.
        #define BATT1_VOLT_MIN_12V   10.5
        #define BATT1_VOLT_MAX_12V   15.0
        #define BATT1_CURR_MAX_A     180.0
@@ -117,10 +209,60 @@ CONFIGURATION STEPS
        #define BATT2_VOLT_MAX_12V   14.6
        #define BATT2_CURR_MAX_A     150.0
        #define BATT2_TEMP_MAX_C     55.0
+   - Every sample is checked before smoothing. A limit trips
+     after FAULT_SET_SAMPLES samples in a row beyond it (INA226
+     conversions, DS18B20 readings), and clears after
+     FAULT_CLEAR_SAMPLES samples in a row back inside it by the
+     hysteresis (voltage per 12V reference, current in % of
+     the limit):
+       #define FAULT_SET_SAMPLES     3
+       #define FAULT_CLEAR_SAMPLES   10
+       #define FAULT_VOLT_HYST_12V   0.2
+       #define FAULT_CURR_HYST_PCT   10.0
+       #define FAULT_TEMP_HYST_C     3.0
 
 15. Smoothing
-   - Number of samples used in RunningAverage:
-       #define SMOOTHING_SAMPLES 10
+   - Filter and window (samples) per quantity: FILTER_BOXCAR
+     (mean of the last N), FILTER_EMA (exponential, same mean
+     age as an N boxcar) or FILTER_BIQUAD (2nd-order
+     Butterworth low-pass with the cutoff of an N boxcar).
+     Voltage and current get one sample per INA226 conversion
+     (16a), temperature one per sensor pass (SENSOR_SAMPLE_HZ).
+     All are fixed-size and allocated at compile time.
+       #define VOLTAGE_FILTER          FILTER_BOXCAR
+       #define VOLTAGE_FILTER_SAMPLES  10
+       #define CURRENT_FILTER          FILTER_EMA
+       #define CURRENT_FILTER_SAMPLES  4
+       #define TEMP_FILTER             FILTER_BIQUAD
+       #define TEMP_FILTER_SAMPLES     100
+   - The voltage filter must hold SOC_INIT_SAMPLES (see 7.) before
+     a SoC is read from OCV at boot.
+
+15a. Scheduler
+   - Fixed rate (Hz) of each loop stage. Stages are run on
+     monotonic deadlines and the CPU idles in between.
+     SENSOR_SAMPLE_HZ only polls for new INA226 conversions, so
+     it should be faster than the conversion rate (see 16a).
+     TEMP_STEP_HZ is the rate of DS18B20 bus steps (see 18.):
+       #define SENSOR_SAMPLE_HZ  20
+       #define TEMP_STEP_HZ      100
+       #define SOC_UPDATE_HZ     10
+       #define NMEA_POLL_HZ      50
+       #define DEBUG_PRINT_HZ    1
+   - Cores: sensors, temp and soc run in the Arduino loop task
+     on CORE_ACQUIRE; nmea, persist and debug in a task pinned
+     to CORE_PUBLISH, so a bus burst, a flash write or a debug
+     print never delays a sample. The sensors stage hands each
+     bank's new reading (smoothed values and fault bits, with
+     its time) to the nmea stage through a lock-free ring of
+     SAMPLE_RING_LEN entries (a power of two; ~28 per second
+     with two banks, so 64 covers a 2 s stall of the nmea
+     stage; a full ring drops the newest). SINGLE_CORE runs
+     every stage from loop(), as on a single-core chip:
+       #define CORE_ACQUIRE     1
+       #define CORE_PUBLISH     0
+       #define SAMPLE_RING_LEN  64
+       // #define SINGLE_CORE
 
 16. I²C / INA226 Settings
    - Pins and addresses:
@@ -128,17 +270,132 @@ CONFIGURATION STEPS
        #define I2C_SCL 17
        #define INA226_ADDR1 0x40
        #define INA226_ADDR2 0x41
+   - Bus clock: 400 kHz is fast mode, the INA226's rating
+     without high-speed mode; 1000000 (fast mode plus) works
+     on short, well pulled-up wiring but is outside it. One
+     register read is ~120 us at 400 kHz, ~470 us at 100 kHz:
+       #define I2C_CLOCK_HZ    400000
+   - Each transaction is bounded by I2C_TIMEOUT_US (the ESP32
+     Wire driver rounds up to whole ms). After a timeout the
+     bus is recovered (9 clocks + STOP); if SDA stays low the
+     bus is left alone for I2C_RETRY_MS between attempts, so a
+     hung sensor cannot stall sampling, SoC or NMEA output:
+       #define I2C_TIMEOUT_US  1000
+       #define I2C_RETRY_MS    1000
+
+16a. INA226 Acquisition
+   - On-chip averaging and conversion times, as register codes:
+       AVG: 0=1, 1=4, 2=16, 3=64, 4=128, 5=256, 6=512, 7=1024
+       CT:  0=140us, 1=204us, 2=332us, 3=588us, 4=1.1ms,
+            5=2.116ms, 6=4.156ms, 7=8.244ms
+     One conversion takes (VBUS CT + VSHUNT CT) * AVG, e.g.
+     64 * (588us + 588us) = 75.3 ms (~13 samples/s).
+       #define INA226_AVERAGE_CODE     3
+       #define INA226_VBUS_CT_CODE     3
+       #define INA226_VSHUNT_CT_CODE   3
+   - Conversion-ready ALERT pins (open drain, active low). The
+     sensors are only read when a new conversion exists. Set a
+     pin to -1 to poll the conversion-ready flag over I²C
+     instead of using the interrupt.
+       #define INA226_ALERT_PIN1 25
+       #define INA226_ALERT_PIN2 26
+
+16b. Fixed-Point Coulomb Counter (optional)
+   - Reads the raw shunt/bus registers, calibrates them in
+     integer arithmetic and counts charge/energy in 64-bit
+     integers. Ah/Wh/SoC are converted to float only when read
+     (SoC update, NMEA, debug, journal). The count is bit-exact
+     and identical on host and device. Leave commented out for
+     the float counter.
+       #define COULOMB_FIXED_POINT
 
 17. CAN bus (NMEA2000) Settings
    - ESP32 GPIO pins for CAN RX/TX:
        #define CAN_RX_PIN GPIO_NUM_34
        #define CAN_TX_PIN GPIO_NUM_32
+   - Receive: the controller's acceptance filter (Hal.h) lets
+     through only what the node itself handles: address
+     claim, ISO requests and acknowledgements, transport
+     protocol and group function. The rest of the backbone
+     traffic is dropped in hardware and never parsed. Up to
+     CAN_RX_QUEUE_LEN frames wait for the next nmea stage run.
+     CAN_ACCEPT_ALL receives every frame (for a build that
+     listens to other PGNs; size the queue for the bus load):
+       #define CAN_RX_QUEUE_LEN  32
+       // #define CAN_ACCEPT_ALL
+   - Transmit schedule per PGN: a PGN goes out at its maximum
+     interval, or after its minimum interval as soon as a value
+     moved by its threshold. Instances are phase-shifted and
+     at most NMEA_FRAMES_PER_POLL frames leave per nmea stage
+     run (NMEA_POLL_HZ), so the PGNs never burst:
+       #define NMEA_FRAMES_PER_POLL  1
+   - 127508 Battery Status: voltage (V), current (A) and
+     temperature (K) thresholds:
+       #define NMEA_508_MIN_MS    250
+       #define NMEA_508_MAX_MS    2500
+       #define NMEA_508_DELTA_V   0.05
+       #define NMEA_508_DELTA_A   0.5
+       #define NMEA_508_DELTA_K   0.5
+   - 127506 DC Detailed Status: SoC (%) and the load behind
+     the time remaining (A):
+       #define NMEA_506_MIN_MS    1000
+       #define NMEA_506_MAX_MS    10000
+       #define NMEA_506_DELTA_SOC 1.0
+       #define NMEA_506_DELTA_A   1.0
+   - 127513 Battery Configuration (static, built once). It is
+     also sent on request (ISO request, e.g. by a display
+     that just booted), so the periodic copy can be rare:
+       #define NMEA_513_MS        300000
+   - 126983 Alert, one per bank and fault: a fault raised or
+     cleared goes out ahead of every other PGN in the next nmea
+     stage run. That is within 1000 / NMEA_POLL_HZ ms of
+     detection, plus one run per other alert changing at the
+     same time. An active alert repeats every NMEA_ALERT_MS:
+       #define NMEA_ALERT_MS      1000
 
 18. DS18B20 Settings
    - OneWire pin and sensor ROM addresses:
        #define ONE_WIRE_BUS 4
-       #define DS18B20_ADDR1 { 0x28, 0xFF, 0x1C, 0x97, 0x91, 0x16, 0x04, 0x2C }
-       #define DS18B20_ADDR2 { 0x28, 0xFF, 0x8A, 0x62, 0x92, 0x16, 0x05, 0x7B }
+       #define DS18B20_ADDR1 { 0x28, 0xFF, 0x1C, 0x97, 0x91, 0x16, 0x04, 0xD6 }
+       #define DS18B20_ADDR2 { 0x28, 0xFF, 0x8A, 0x62, 0x92, 0x16, 0x05, 0xB7 }
+   - Or find the sensors by a bus search at boot instead; they
+     are assigned to banks 1, 2, ... in ascending ROM order
+     (debug output prints the ROMs found, to pin them above):
+       // #define DS18B20_DISCOVER
+   - Resolution per sensor, 9..12 bit (0.5 .. 0.0625 °C);
+     each bit doubles the conversion time (94 .. 750 ms):
+       #define BATT1_TEMP_RESOLUTION 12
+       #define BATT2_TEMP_RESOLUTION 12
+   - The bus is driven in steps of one reset or at most
+     TEMP_STEP_BYTES bytes (~0.6 ms each), one step per
+     "temp" stage run, and only when the next INA226
+     conversion is at least TEMP_STEP_GUARD_US away. After
+     TEMP_MAX_FAILS failed reads in a row (no answer, CRC
+     error) the sensor reads as disconnected:
+       #define TEMP_STEP_BYTES      2
+       #define TEMP_STEP_GUARD_US   2000
+       #define TEMP_MAX_FAILS       3
+   - Sensors must be powered (VDD wired): every sensor
+     converts on its own schedule, which parasite power
+     cannot supply.
+
+19. Time to Empty / Time to Full
+   - Predicted from exponentially weighted means of the
+     effective current over three horizons (s). The longest
+     one with enough samples is used, so cycling loads are
+     averaged over the hour:
+       #define RUNTIME_SHORT_S  60
+       #define RUNTIME_MID_S    900
+       #define RUNTIME_LONG_S   3600
+   - A load step restarts the longer horizons: the 1 min mean
+     moving away from the 15 min mean by RUNTIME_STEP_PCT, or
+     the 15 min mean from the 1 h mean by RUNTIME_DRIFT_PCT
+     (% of the smaller, plus the bank's rest current):
+       #define RUNTIME_STEP_PCT   100
+       #define RUNTIME_DRIFT_PCT  50
+   - Sent as "time remaining" in PGN 127506: time to empty
+     while discharging, time to full while charging; not
+     available below the rest current threshold (section 11).
 
 ===========================================================
 */
@@ -148,46 +405,77 @@ CONFIGURATION STEPS
 // ----- Enable debug serial output -----
 // #define DEBUG_OUTPUT
 
+// ===== Number of monitored banks (1..4) =====
+#define NUM_BATTERIES 2
+
 // ===== Chemistry IDs =====
 #define CHEM_FLA  0
 #define CHEM_AGM  1
 #define CHEM_GEL  2
 #define CHEM_LFP  3
 
+// ===== Smoothing filter IDs =====
+#define FILTER_BOXCAR  0
+#define FILTER_EMA     1
+#define FILTER_BIQUAD  2
+
 // ===== System Voltage =====
 #define BATT1_SYSTEM_VOLTAGE_12V
 // #define BATT1_SYSTEM_VOLTAGE_24V
 #define BATT2_SYSTEM_VOLTAGE_12V
 // #define BATT2_SYSTEM_VOLTAGE_24V
+// #define BATT3_SYSTEM_VOLTAGE_12V
+#define BATT3_SYSTEM_VOLTAGE_24V
+#define BATT4_SYSTEM_VOLTAGE_12V
+// #define BATT4_SYSTEM_VOLTAGE_24V
 
 // ===== Battery Chemistry =====
 #define BATT1_CHEMISTRY CHEM_FLA
 #define BATT2_CHEMISTRY CHEM_LFP
+#define BATT3_CHEMISTRY CHEM_LFP
+#define BATT4_CHEMISTRY CHEM_AGM
 
 // ===== Battery Capacities (Ah) =====
 #define BATT1_CAPACITY_AH 100.0
 #define BATT2_CAPACITY_AH 100.0
+#define BATT3_CAPACITY_AH 100.0
+#define BATT4_CAPACITY_AH 70.0
 
 // ===== Peukert exponent =====
 #define BATT1_PEUKERT_EXP   1.10
 #define BATT2_PEUKERT_EXP   1.05
+#define BATT3_PEUKERT_EXP   1.05
+#define BATT4_PEUKERT_EXP   1.15
 
 // ===== Charge efficiency =====
 #define BATT1_CHARGE_EFF    0.95
 #define BATT2_CHARGE_EFF    0.96
+#define BATT3_CHARGE_EFF    0.96
+#define BATT4_CHARGE_EFF    0.93
 
 // ===== Capacity learning & persistence =====
 #define CAPACITY_LEARNING_ALPHA   0.05
-#define EEPROM_NUM_SLOTS          16
-#define EEPROM_BASE_ADDR          0
-#define EEPROM_SAVE_INTERVAL_MS   60000
+#define JOURNAL_SECTORS           2
+#define JOURNAL_MIN_INTERVAL_MS   60000
+#define JOURNAL_MAX_INTERVAL_MS   3600000
+#define JOURNAL_SOC_DEADBAND_PCT  1.0f
+#define JOURNAL_CAP_DEADBAND_AH   0.1f
+#define PERSIST_ERASE_US          45000
+#define PERSIST_MAX_DEFER_MS      10000
+// #define PERSIST_INLINE
 #define SOC_RESUME_TOLERANCE      10.0
+#define SOC_INIT_SAMPLES          4
+#define SOC_BOOT_BUDGET_MS        500
 
 // ===== Shunt definitions =====
 #define SHUNT1_OHMS 0.00025
 #define SHUNT1_MAX_AMPS 200.0
 #define SHUNT2_OHMS 0.00025
 #define SHUNT2_MAX_AMPS 200.0
+#define SHUNT3_OHMS 0.0001
+#define SHUNT3_MAX_AMPS 500.0
+#define SHUNT4_OHMS 0.0001
+#define SHUNT4_MAX_AMPS 500.0
 
 // ===== Calibration (V/A, Temp offsets) =====
 #define BATT1_V_RAW_LOW 10.0
@@ -210,13 +498,37 @@ CONFIGURATION STEPS
 #define BATT2_I_RAW_HIGH 100.0
 #define BATT2_I_CAL_HIGH 99.8
 
+#define BATT3_V_RAW_LOW 20.0
+#define BATT3_V_CAL_LOW 20.0
+#define BATT3_V_RAW_HIGH 30.0
+#define BATT3_V_CAL_HIGH 30.0
+
+#define BATT3_I_RAW_LOW 0.0
+#define BATT3_I_CAL_LOW 0.0
+#define BATT3_I_RAW_HIGH 100.0
+#define BATT3_I_CAL_HIGH 100.0
+
+#define BATT4_V_RAW_LOW 10.0
+#define BATT4_V_CAL_LOW 10.0
+#define BATT4_V_RAW_HIGH 15.0
+#define BATT4_V_CAL_HIGH 15.0
+
+#define BATT4_I_RAW_LOW 0.0
+#define BATT4_I_CAL_LOW 0.0
+#define BATT4_I_RAW_HIGH 100.0
+#define BATT4_I_CAL_HIGH 100.0
+
 // Temperature offsets (°C)
 #define BATT1_TEMP_OFFSET  0.0
 #define BATT2_TEMP_OFFSET  0.0
+#define BATT3_TEMP_OFFSET  0.0
+#define BATT4_TEMP_OFFSET  0.0
 
 // Temp compensation coefficients (V/°C)
 #define BATT1_TEMP_COEF   -0.030
 #define BATT2_TEMP_COEF    0.0
+#define BATT3_TEMP_COEF    0.0
+#define BATT4_TEMP_COEF   -0.024
 
 // Rest detection
 #define BATT1_REST_I_THRESHOLD_A      2.0
@@ -227,6 +539,14 @@ CONFIGURATION STEPS
 #define BATT2_REST_V_STABILITY_MV     20
 #define BATT2_REST_HOLD_TIME_S        1800
 
+#define BATT3_REST_I_THRESHOLD_A      2.0
+#define BATT3_REST_V_STABILITY_MV     20
+#define BATT3_REST_HOLD_TIME_S        1800
+
+#define BATT4_REST_I_THRESHOLD_A      1.0
+#define BATT4_REST_V_STABILITY_MV     20
+#define BATT4_REST_HOLD_TIME_S        1800
+
 // Full charge detection
 #define BATT1_FULL_V_ABSORB_V         14.4
 #define BATT1_FULL_I_TAIL_A           4.0
@@ -236,10 +556,43 @@ CONFIGURATION STEPS
 #define BATT2_FULL_I_TAIL_A           2.0
 #define BATT2_FULL_HOLD_TIME_S        600
 
+#define BATT3_FULL_V_ABSORB_V         13.6
+#define BATT3_FULL_I_TAIL_A           2.0
+#define BATT3_FULL_HOLD_TIME_S        600
+
+#define BATT4_FULL_V_ABSORB_V         14.4
+#define BATT4_FULL_I_TAIL_A           2.0
+#define BATT4_FULL_HOLD_TIME_S        900
+
+// Model-based SoC estimator (EKF on a 1RC equivalent circuit)
+// #define SOC_ESTIMATOR_EKF
+#define BATT1_EKF_R0_OHMS   0.010
+#define BATT1_EKF_R1_OHMS   0.005
+#define BATT1_EKF_TAU_S     60.0
+#define BATT2_EKF_R0_OHMS   0.004
+#define BATT2_EKF_R1_OHMS   0.002
+#define BATT2_EKF_TAU_S     60.0
+#define BATT3_EKF_R0_OHMS   0.008
+#define BATT3_EKF_R1_OHMS   0.004
+#define BATT3_EKF_TAU_S     60.0
+#define BATT4_EKF_R0_OHMS   0.012
+#define BATT4_EKF_R1_OHMS   0.006
+#define BATT4_EKF_TAU_S     60.0
+#define EKF_SOC_DRIFT_PCT_H       2.0
+#define EKF_V1_DRIFT_MV_S         1.0
+#define EKF_V1_INIT_SIGMA_MV      50.0
+#define EKF_VOLTAGE_NOISE_MV      20.0
+#define EKF_LOAD_NOISE_MOHM       1000.0
+#define EKF_MODEL_ERROR_S         300.0
+#define EKF_INIT_SOC_SIGMA_PCT    10.0
+#define EKF_ANCHOR_SOC_SIGMA_PCT  1.0
+
 // Capacity learning guardrails
 #define LEARN_MIN_DELTA_SOC_PCT       20.0
 #define LEARN_CAPACITY_MIN_FACTOR     0.5f
 #define LEARN_CAPACITY_MAX_FACTOR     2.0f
+#define LEARN_OCV_MIN_SLOPE_MV        1.2f
+#define LEARN_MAX_SPAN_H              168
 
 // Fault detection thresholds
 #define BATT1_VOLT_MIN_12V   10.5
@@ -252,20 +605,105 @@ CONFIGURATION STEPS
 #define BATT2_CURR_MAX_A     150.0
 #define BATT2_TEMP_MAX_C     55.0
 
-// Running average window size
-#define SMOOTHING_SAMPLES 10
+#define BATT3_VOLT_MIN_12V   11.0
+#define BATT3_VOLT_MAX_12V   14.6
+#define BATT3_CURR_MAX_A     450.0
+#define BATT3_TEMP_MAX_C     55.0
+
+#define BATT4_VOLT_MIN_12V   10.5
+#define BATT4_VOLT_MAX_12V   15.0
+#define BATT4_CURR_MAX_A     450.0
+#define BATT4_TEMP_MAX_C     60.0
+
+// Fault debouncing and hysteresis
+#define FAULT_SET_SAMPLES     3
+#define FAULT_CLEAR_SAMPLES   10
+#define FAULT_VOLT_HYST_12V   0.2
+#define FAULT_CURR_HYST_PCT   10.0
+#define FAULT_TEMP_HYST_C     3.0
+
+// Smoothing filter and window (samples) per quantity
+#define VOLTAGE_FILTER          FILTER_BOXCAR
+#define VOLTAGE_FILTER_SAMPLES  10
+#define CURRENT_FILTER          FILTER_EMA
+#define CURRENT_FILTER_SAMPLES  4
+#define TEMP_FILTER             FILTER_BIQUAD
+#define TEMP_FILTER_SAMPLES     100
+
+// Scheduler stage rates (Hz)
+#define SENSOR_SAMPLE_HZ  20
+#define TEMP_STEP_HZ      100
+#define SOC_UPDATE_HZ     10
+#define NMEA_POLL_HZ      50
+#define DEBUG_PRINT_HZ    1
+
+// Stage cores and the sample ring between them
+#define CORE_ACQUIRE     1
+#define CORE_PUBLISH     0
+#define SAMPLE_RING_LEN  64
+// #define SINGLE_CORE
 
 // INA226 I2C pins and addresses
 #define I2C_SDA 16
 #define I2C_SCL 17
 #define INA226_ADDR1 0x40
 #define INA226_ADDR2 0x41
+#define INA226_ADDR3 0x44
+#define INA226_ADDR4 0x45
+#define I2C_CLOCK_HZ    400000
+#define I2C_TIMEOUT_US  1000
+#define I2C_RETRY_MS    1000
+
+// INA226 averaging / conversion time codes and ALERT pins
+#define INA226_AVERAGE_CODE     3   // 64 samples
+#define INA226_VBUS_CT_CODE     3   // 588 us
+#define INA226_VSHUNT_CT_CODE   3   // 588 us
+#define INA226_ALERT_PIN1       25
+#define INA226_ALERT_PIN2       26
+#define INA226_ALERT_PIN3       27
+#define INA226_ALERT_PIN4       14
+
+// Integer coulomb counter on raw INA226 registers
+// #define COULOMB_FIXED_POINT
 
 // CAN bus (NMEA2000) pins on SH-ESP32
 #define CAN_RX_PIN GPIO_NUM_34
 #define CAN_TX_PIN GPIO_NUM_32
+#define CAN_RX_QUEUE_LEN  32
+// #define CAN_ACCEPT_ALL
+
+// NMEA2000 transmit schedule
+#define NMEA_FRAMES_PER_POLL  1
+#define NMEA_508_MIN_MS    250
+#define NMEA_508_MAX_MS    2500
+#define NMEA_508_DELTA_V   0.05
+#define NMEA_508_DELTA_A   0.5
+#define NMEA_508_DELTA_K   0.5
+#define NMEA_506_MIN_MS    1000
+#define NMEA_506_MAX_MS    10000
+#define NMEA_506_DELTA_SOC 1.0
+#define NMEA_506_DELTA_A   1.0
+#define NMEA_513_MS        300000
+#define NMEA_ALERT_MS      1000
 
 // DS18B20 bus + addresses
 #define ONE_WIRE_BUS 4
-#define DS18B20_ADDR1 { 0x28, 0xFF, 0x1C, 0x97, 0x91, 0x16, 0x04, 0x2C }
-#define DS18B20_ADDR2 { 0x28, 0xFF, 0x8A, 0x62, 0x92, 0x16, 0x05, 0x7B }
+#define DS18B20_ADDR1 { 0x28, 0xFF, 0x1C, 0x97, 0x91, 0x16, 0x04, 0xD6 }
+#define DS18B20_ADDR2 { 0x28, 0xFF, 0x8A, 0x62, 0x92, 0x16, 0x05, 0xB7 }
+#define DS18B20_ADDR3 { 0x28, 0xFF, 0x4B, 0x12, 0x93, 0x16, 0x04, 0x05 }
+#define DS18B20_ADDR4 { 0x28, 0xFF, 0x07, 0x3D, 0x91, 0x16, 0x05, 0x36 }
+// #define DS18B20_DISCOVER
+#define BATT1_TEMP_RESOLUTION 12
+#define BATT2_TEMP_RESOLUTION 12
+#define BATT3_TEMP_RESOLUTION 11
+#define BATT4_TEMP_RESOLUTION 11
+#define TEMP_STEP_BYTES      2
+#define TEMP_STEP_GUARD_US   2000
+#define TEMP_MAX_FAILS       3
+
+// Time-to-empty / time-to-full load horizons
+#define RUNTIME_SHORT_S    60
+#define RUNTIME_MID_S      900
+#define RUNTIME_LONG_S     3600
+#define RUNTIME_STEP_PCT   100
+#define RUNTIME_DRIFT_PCT  50
@@ -0,0 +1,125 @@
+#ifndef EKF_H
+#define EKF_H
+
+#include <Arduino.h>
+#include <math.h>
+#include "Matrix.h"
+
+// ===========================================================
+// Ekf.h — Extended Kalman filter on a 1RC battery model
+// ===========================================================
+//
+// Model (terminal volts, current > 0 = discharge):
+//   state  x = [ SoC (0..1), v1 (RC polarization, V) ]
+//   SoC'   = SoC - I_eff * dt / capacity
+//   v1'    = a * v1 + R1 * (1 - a) * I,    a = exp(-dt / tau)
+//   V      = OCV(SoC, T) - v1 - R0 * I
+//
+// The SoC prediction is the coulomb counter itself: the bank's
+// counter integrates the conversion first (Peukert, charge
+// efficiency, trapezoid) and the filter only propagates v1 and
+// the covariance, then corrects with the measured voltage. The
+// correction is returned so the caller can add it to the
+// counter, which keeps Ah, SoC and the journal one estimate.
+//
+// Noise:
+//   - SoC random walk (counter error: offset, Peukert and
+//     capacity errors) grows its variance per hour
+//   - v1 random walk per second
+//   - voltage noise, plus a term proportional to |I| for what
+//     the 1RC model misses under load (charge polarization,
+//     slow diffusion); at high current the voltage is barely
+//     trusted and the filter follows the counter
+// Model error is not white: it persists for minutes to hours
+// (surface charge, temperature, curve mismatch), so the
+// voltage variance is scaled by corrS / dt. Conversions closer
+// than corrS then add up to one independent measurement, and
+// the correction per hour does not depend on the sample rate.
+// Where the OCV curve is flat (LFP plateau, outside the table)
+// the SoC row of H is ~0 and only v1 is corrected.
+//
+// 2 states and a scalar measurement: the innovation is 1 x 1,
+// so no matrix inverse. Covariance update in Joseph form,
+// which stays symmetric and positive in float. expf() runs
+// only when the conversion interval changes.
+// ===========================================================
+
+struct SocEkfParams {
+  float r0;            // ohmic resistance (ohm)
+  float r1;            // RC branch resistance (ohm)
+  float tauS;          // RC time constant (s)
+  float socVarPerH;    // SoC variance growth (fraction^2 per hour)
+  float v1VarPerS;     // v1 variance growth (V^2 per s)
+  float voltVar;       // measurement variance (V^2)
+  float irVar;         // model error under load (ohm^2, times I^2)
+  float corrS;         // correlation time of the model error (s)
+};
+
+struct SocEkf {
+  Matrix<2, 2> P;
+  float    v1;
+  float    alpha;          // exp(-dt / tau) for lastDtUs
+  uint32_t lastDtUs;
+  uint32_t lastUs;         // previous conversion
+  bool     haveSample;
+  float    innovation;     // last measured - predicted voltage
+  float    correctionAh;   // total correction added to the counter
+
+  void begin(float socSigma, float v1Sigma) {
+    P = Matrix<2, 2>::zero();
+    P(0, 0) = socSigma * socSigma;
+    P(1, 1) = v1Sigma * v1Sigma;
+    v1 = 0.0f;
+    lastDtUs = 0;
+    haveSample = false;
+    innovation = 0.0f;
+    correctionAh = 0.0f;
+  }
+
+  // SoC set from elsewhere (anchor, OCV, journal) with the
+  // given uncertainty
+  void resetSoc(float socSigma) {
+    P(0, 1) = P(1, 0) = 0.0f;
+    P(0, 0) = socSigma * socSigma;
+  }
+
+  // One conversion: dtUs since the previous one, current (A)
+  // and terminal voltage (V), model OCV at the counter's SoC
+  // and its slope (V per unit SoC). Returns the SoC correction
+  // (fraction).
+  float update(uint32_t dtUs, float amps, float volts, float ocvV, float ocvSlope,
+               const SocEkfParams& p) {
+    float dtS = dtUs * 1e-6f;
+    if (dtUs != lastDtUs) {
+      alpha = expf(-dtS / p.tauS);
+      lastDtUs = dtUs;
+    }
+
+    // Predict
+    v1 = alpha * v1 + p.r1 * (1.0f - alpha) * amps;
+    Matrix<2, 2> F = Matrix<2, 2>::identity();
+    F(1, 1) = alpha;
+    Matrix<2, 2> Q = Matrix<2, 2>::zero();
+    Q(0, 0) = p.socVarPerH * dtS * (1.0f / 3600.0f);
+    Q(1, 1) = p.v1VarPerS * dtS;
+    P = F * P * transpose(F) + Q;
+
+    // Correct
+    Matrix<1, 2> H;
+    H(0, 0) = ocvSlope;
+    H(0, 1) = -1.0f;
+    float r = p.voltVar + p.irVar * amps * amps;
+    if (p.corrS > dtS) r *= p.corrS / dtS;
+    float y = volts - (ocvV - v1 - p.r0 * amps);
+    float s = (H * P * transpose(H))(0, 0) + r;
+    Matrix<2, 1> K = P * transpose(H) * (1.0f / s);
+    Matrix<2, 2> A = Matrix<2, 2>::identity() - K * H;
+    P = A * P * transpose(A) + K * transpose(K) * r;
+
+    v1 += K(1, 0) * y;
+    innovation = y;
+    return K(0, 0) * y;
+  }
+};
+
+#endif // EKF_H
@@ -0,0 +1,68 @@
+#ifndef FAULTS_H
+#define FAULTS_H
+
+#include <Arduino.h>
+#include "Config.h"
+
+// ===========================================================
+// Faults.h — Limit checks with hysteresis and debouncing
+// ===========================================================
+//
+// FaultMonitor<N> keeps, per bank, the state of four limits
+// (the BATTn_VOLT_MIN_12V / _VOLT_MAX_12V / _CURR_MAX_A /
+// _TEMP_MAX_C settings):
+//   FAULT_VOLT_LOW    voltage below the minimum
+//   FAULT_VOLT_HIGH   voltage above the maximum
+//   FAULT_CURR_HIGH   current above the maximum, either way
+//   FAULT_TEMP_HIGH   temperature above the maximum
+//
+// Every new sample is checked, before smoothing (the
+// smoothing windows would add their delay to the detection):
+//   - FAULT_SET_SAMPLES samples in a row beyond the limit
+//     raise the fault (one bad conversion does not)
+//   - FAULT_CLEAR_SAMPLES samples in a row back inside the
+//     limit by the hysteresis clear it (no chatter around
+//     the limit)
+// Each raise or clear is timestamped. The active bits travel
+// with every sample to the nmea stage (Sensors.h), which
+// sends the alerts from them (Nmea.cpp).
+// checkBankFaults() in Battery.h applies it per bank.
+// ===========================================================
+
+enum FaultType { FAULT_VOLT_LOW, FAULT_VOLT_HIGH, FAULT_CURR_HIGH, FAULT_TEMP_HIGH, FAULT_TYPES };
+
+template <size_t N>
+struct FaultMonitor {
+  uint8_t  active[N];                   // bit per FaultType
+  uint8_t  count[FAULT_TYPES][N];       // samples in a row toward the other state
+  uint32_t changedMs[FAULT_TYPES][N];   // time of the last raise or clear
+
+  void begin() {
+    for (size_t i = 0; i < N; i++) {
+      active[i] = 0;
+      for (size_t f = 0; f < FAULT_TYPES; f++) {
+        count[f][i] = 0;
+        changedMs[f][i] = 0;
+      }
+    }
+  }
+
+  bool isActive(size_t i, uint8_t f) const { return active[i] & (1u << f); }
+
+  // One sample of bank i: `beyond` the limit, or back `inside`
+  // it by the hysteresis (neither: in the band, no change)
+  void sample(size_t i, uint8_t f, bool beyond, bool inside, uint32_t nowMs) {
+    bool on = isActive(i, f);
+    bool toward = on ? inside : beyond;
+    if (!toward) {
+      count[f][i] = 0;
+      return;
+    }
+    if (++count[f][i] < (on ? FAULT_CLEAR_SAMPLES : FAULT_SET_SAMPLES)) return;
+    count[f][i] = 0;
+    active[i] ^= (uint8_t)(1u << f);
+    changedMs[f][i] = nowMs;
+  }
+};
+
+#endif // FAULTS_H
@@ -0,0 +1,147 @@
+#ifndef FILTERS_H
+#define FILTERS_H
+
+#include <Arduino.h>
+#include <math.h>
+#include "Config.h"
+
+// ===========================================================
+// Filters.h — Multi-channel smoothing filters, no heap
+// ===========================================================
+//
+// Each filter holds N channels (one per bank) in one block of
+// fixed size, chosen at compile time; nothing is allocated.
+// State is laid out channel-minor (one array per quantity,
+// indexed by channel, like BatteryTable), so update() runs
+// all channels in one loop over contiguous memory.
+//
+//   BoxcarFilter<N, W>  mean of the last W samples. Running
+//                       sum, re-added from the buffer once per
+//                       W samples so float rounding cannot
+//                       accumulate.
+//   EmaFilter<N, W>     exponential average, alpha = 2/(W+1)
+//                       (same mean sample age as a W boxcar)
+//   BiquadFilter<N, W>  2nd-order Butterworth low-pass, cutoff
+//                       0.443 / W of the sample rate (the -3 dB
+//                       point of a W boxcar); steeper roll-off
+//                       than both, slight overshoot on steps
+//
+// Common interface:
+//   begin()              clear all channels (biquad: also
+//                        computes its coefficients)
+//   clear(i)             forget channel i
+//   add(i, x)            one sample into channel i
+//   update(x, take)      x[i] into every channel with take[i]
+//   value(i)             filtered value, NAN until a sample
+//   samples(i)           samples since clear (saturating)
+//
+// The EMA and the biquad start at the first sample, so there
+// is no ramp from zero. SmoothingFilter<N, FILTER_*, W> picks
+// one by its FILTER_* id (Config.h).
+// ===========================================================
+
+template <size_t N, size_t W>
+struct BoxcarFilter {
+  float    buf[W][N];        // slot k of every channel is contiguous
+  float    sum[N];
+  uint16_t head[N];
+  uint16_t count[N];
+
+  void begin() { for (size_t i = 0; i < N; i++) clear(i); }
+
+  void clear(size_t i) {
+    sum[i] = 0.0f;
+    head[i] = 0;
+    count[i] = 0;
+  }
+
+  void add(size_t i, float x) {
+    if (count[i] == W) sum[i] -= buf[head[i]][i];
+    else count[i]++;
+    buf[head[i]][i] = x;
+    sum[i] += x;
+    if (++head[i] == W) {
+      head[i] = 0;
+      float s = 0.0f;   // full window here: re-add it exactly
+      for (size_t k = 0; k < W; k++) s += buf[k][i];
+      sum[i] = s;
+    }
+  }
+
+  void update(const float* x, const bool* take) {
+    for (size_t i = 0; i < N; i++) if (take[i]) add(i, x[i]);
+  }
+
+  float    value(size_t i) const   { return count[i] ? sum[i] / count[i] : NAN; }
+  uint16_t samples(size_t i) const { return count[i]; }
+};
+
+template <size_t N, size_t W>
+struct EmaFilter {
+  float    y[N];
+  uint16_t count[N];
+
+  void begin() { for (size_t i = 0; i < N; i++) clear(i); }
+  void clear(size_t i) { count[i] = 0; }
+
+  void add(size_t i, float x) {
+    y[i] = count[i] ? y[i] + (2.0f / (W + 1)) * (x - y[i]) : x;
+    if (count[i] < UINT16_MAX) count[i]++;
+  }
+
+  void update(const float* x, const bool* take) {
+    for (size_t i = 0; i < N; i++) if (take[i]) add(i, x[i]);
+  }
+
+  float    value(size_t i) const   { return count[i] ? y[i] : NAN; }
+  uint16_t samples(size_t i) const { return count[i]; }
+};
+
+template <size_t N, size_t W>
+struct BiquadFilter {
+  float    b0, b1, b2, a1, a2;   // shared by all channels
+  float    z1[N], z2[N];         // transposed direct form II
+  float    y[N];
+  uint16_t count[N];
+
+  void begin() {
+    float k = tanf((float)M_PI * 0.443f / W);
+    float q = 0.70710678f;
+    float norm = 1.0f / (1.0f + k / q + k * k);
+    b0 = k * k * norm;
+    b1 = 2.0f * b0;
+    b2 = b0;
+    a1 = 2.0f * (k * k - 1.0f) * norm;
+    a2 = (1.0f - k / q + k * k) * norm;
+    for (size_t i = 0; i < N; i++) clear(i);
+  }
+
+  void clear(size_t i) { count[i] = 0; }
+
+  void add(size_t i, float x) {
+    if (count[i] == 0) {
+      // Settled state for a constant input x
+      z1[i] = x * (1.0f - b0);
+      z2[i] = x * (b2 - a2);
+    }
+    float out = b0 * x + z1[i];
+    z1[i] = b1 * x - a1 * out + z2[i];
+    z2[i] = b2 * x - a2 * out;
+    y[i] = out;
+    if (count[i] < UINT16_MAX) count[i]++;
+  }
+
+  void update(const float* x, const bool* take) {
+    for (size_t i = 0; i < N; i++) if (take[i]) add(i, x[i]);
+  }
+
+  float    value(size_t i) const   { return count[i] ? y[i] : NAN; }
+  uint16_t samples(size_t i) const { return count[i]; }
+};
+
+template <size_t N, int Kind, size_t W> struct SmoothingFilter;
+template <size_t N, size_t W> struct SmoothingFilter<N, FILTER_BOXCAR, W> : BoxcarFilter<N, W> {};
+template <size_t N, size_t W> struct SmoothingFilter<N, FILTER_EMA, W>    : EmaFilter<N, W> {};
+template <size_t N, size_t W> struct SmoothingFilter<N, FILTER_BIQUAD, W> : BiquadFilter<N, W> {};
+
+#endif // FILTERS_H
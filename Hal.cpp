@@ -0,0 +1,243 @@
+#include "Hal.h"
+#include "Config.h"
+#include <Wire.h>
+#include <OneWire.h>
+#include <esp_partition.h>
+#include <driver/twai.h>      // ESP32 built-in CAN controller
+#include <string.h>
+
+// ===========================================================
+// ESP32 implementation of Hal.h
+// ===========================================================
+
+// ALERT edges (channel 0 = battery 1)
+static volatile bool alertFlag[NUM_BATTERIES];
+static volatile uint32_t alertUs[NUM_BATTERIES];
+
+static void IRAM_ATTR onAlert0() { alertFlag[0] = true; alertUs[0] = micros(); }
+#if NUM_BATTERIES >= 2
+static void IRAM_ATTR onAlert1() { alertFlag[1] = true; alertUs[1] = micros(); }
+#endif
+#if NUM_BATTERIES >= 3
+static void IRAM_ATTR onAlert2() { alertFlag[2] = true; alertUs[2] = micros(); }
+#endif
+#if NUM_BATTERIES >= 4
+static void IRAM_ATTR onAlert3() { alertFlag[3] = true; alertUs[3] = micros(); }
+#endif
+
+static void (* const alertIsr[NUM_BATTERIES])() = {
+  onAlert0,
+#if NUM_BATTERIES >= 2
+  onAlert1,
+#endif
+#if NUM_BATTERIES >= 3
+  onAlert2,
+#endif
+#if NUM_BATTERIES >= 4
+  onAlert3,
+#endif
+};
+
+// DS18B20 bus
+static OneWire oneWire(ONE_WIRE_BUS);
+
+// NMEA2000 on the ESP32 CAN controller, through the IDF TWAI
+// driver: its acceptance filter runs in hardware, and its
+// status reports frames lost to a full queue or an overrun
+class tNMEA2000_twai : public tNMEA2000 {
+public:
+  uint32_t received = 0;
+
+protected:
+  bool CANOpen() override {
+    twai_general_config_t g = TWAI_GENERAL_CONFIG_DEFAULT(CAN_TX_PIN, CAN_RX_PIN, TWAI_MODE_NORMAL);
+    g.rx_queue_len = CAN_RX_QUEUE_LEN;
+    twai_timing_config_t t = TWAI_TIMING_CONFIG_250KBITS();
+#ifdef CAN_ACCEPT_ALL
+    twai_filter_config_t f = TWAI_FILTER_CONFIG_ACCEPT_ALL();
+#else
+    // Dual filter mode: filter 1 in bits 31..16, filter 2 in 15..0
+    twai_filter_config_t f;
+    f.acceptance_code = (uint32_t)HAL_CAN_FILTER1_CODE << 16 | HAL_CAN_FILTER2_CODE;
+    f.acceptance_mask = (uint32_t)HAL_CAN_FILTER1_MASK << 16 | HAL_CAN_FILTER2_MASK;
+    f.single_filter = false;
+#endif
+    return twai_driver_install(&g, &t, &f) == ESP_OK && twai_start() == ESP_OK;
+  }
+
+  // The TX queue is FIFO, so fast packet frames stay in order
+  bool CANSendFrame(unsigned long id, unsigned char len, const unsigned char* buf, bool) override {
+    twai_message_t m = {};
+    m.extd = 1;
+    m.identifier = id;
+    m.data_length_code = len;
+    memcpy(m.data, buf, len);
+    return twai_transmit(&m, 0) == ESP_OK;
+  }
+
+  bool CANGetFrame(unsigned long& id, unsigned char& len, unsigned char* buf) override {
+    twai_message_t m;
+    while (twai_receive(&m, 0) == ESP_OK) {
+      if (!m.extd || m.rtr) continue;   // NMEA2000 is extended data frames only
+      received++;
+      id = m.identifier;
+      len = m.data_length_code > 8 ? 8 : m.data_length_code;
+      memcpy(buf, m.data, len);
+      return true;
+    }
+    return false;
+  }
+};
+
+static tNMEA2000_twai n2kBus;
+tNMEA2000& NMEA2000 = n2kBus;
+
+// ----- Time -----
+uint32_t halMillis() { return millis(); }
+uint32_t halMicros() { return micros(); }
+
+void halIdleUntil(uint32_t deadlineUs) {
+  int32_t remaining = (int32_t)(deadlineUs - micros());
+  // delay() blocks in vTaskDelay, so the idle task (and the other
+  // core's work) gets the CPU; finish the last ms precisely.
+  if (remaining > 2000) delay((remaining - 1000) / 1000);
+  remaining = (int32_t)(deadlineUs - micros());
+  if (remaining > 0) delayMicroseconds(remaining);
+}
+
+// ----- Tasks -----
+#define HAL_TASK_STACK 8192   // bytes; NMEA2000 library and Serial printing
+
+static void taskEntry(void* arg) {
+  void (*fn)() = (void (*)())arg;
+  for (;;) fn();
+}
+
+bool halStartTask(const char* name, void (*fn)(), uint8_t core) {
+#if defined(SINGLE_CORE) || CONFIG_FREERTOS_UNICORE
+  (void)name; (void)fn; (void)core;
+  return false;
+#else
+  // Same priority as the loop task: each core has its own
+  return xTaskCreatePinnedToCore(taskEntry, name, HAL_TASK_STACK, (void*)fn,
+                                 1, nullptr, core) == pdPASS;
+#endif
+}
+
+// ----- I²C -----
+static int i2cSda, i2cScl;
+static uint32_t i2cClockHz;
+static uint32_t i2cTimeoutUs;
+
+static void i2cStart() {
+  Wire.begin(i2cSda, i2cScl, i2cClockHz);
+  // Wire times out in whole ms; at least 1
+  Wire.setTimeOut((uint16_t)((i2cTimeoutUs + 999) / 1000));
+}
+
+void halI2cBegin(int sda, int scl, uint32_t clockHz, uint32_t timeoutUs) {
+  i2cSda = sda;
+  i2cScl = scl;
+  i2cClockHz = clockHz;
+  i2cTimeoutUs = timeoutUs;
+  i2cStart();
+}
+
+// Wire error codes: 2/3 = NACK on address/data, 5 = timeout
+static uint8_t wireStatus(uint8_t err) {
+  if (err == 0) return HAL_I2C_OK;
+  if (err == 2 || err == 3) return HAL_I2C_NACK;
+  if (err == 5) return HAL_I2C_TIMEOUT;
+  return HAL_I2C_ERROR;
+}
+
+uint8_t halI2cTransfer(uint8_t addr, const uint8_t* out, size_t outLen, uint8_t* in, size_t inLen) {
+  Wire.beginTransmission(addr);
+  Wire.write(out, outLen);
+  uint8_t st = wireStatus(Wire.endTransmission(inLen == 0));   // repeated start before a read
+  if (st != HAL_I2C_OK || inLen == 0) return st;
+  if (Wire.requestFrom(addr, (uint8_t)inLen) != inLen) return HAL_I2C_ERROR;
+  for (size_t k = 0; k < inLen; k++) in[k] = Wire.read();
+  return HAL_I2C_OK;
+}
+
+bool halI2cRecover() {
+  Wire.end();
+  pinMode(i2cSda, INPUT_PULLUP);
+  pinMode(i2cScl, OUTPUT_OPEN_DRAIN);
+  const uint32_t halfUs = 5;   // bit-banged at 100 kHz
+  for (uint8_t k = 0; k < 9 && digitalRead(i2cSda) == LOW; k++) {
+    digitalWrite(i2cScl, LOW);
+    delayMicroseconds(halfUs);
+    digitalWrite(i2cScl, HIGH);
+    delayMicroseconds(halfUs);
+  }
+  // STOP: SDA rises while SCL is high
+  pinMode(i2cSda, OUTPUT_OPEN_DRAIN);
+  digitalWrite(i2cSda, LOW);
+  delayMicroseconds(halfUs);
+  digitalWrite(i2cScl, HIGH);
+  delayMicroseconds(halfUs);
+  digitalWrite(i2cSda, HIGH);
+  delayMicroseconds(halfUs);
+  pinMode(i2cSda, INPUT_PULLUP);
+  bool released = digitalRead(i2cSda) == HIGH;
+  i2cStart();
+  return released;
+}
+
+// ----- ALERT -----
+void halAlertAttach(uint8_t ch, int pin) {
+  if (pin < 0) return;
+  pinMode(pin, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(pin), alertIsr[ch], FALLING);
+}
+
+bool halAlertTake(uint8_t ch, uint32_t& edgeUs) {
+  if (!alertFlag[ch]) return false;
+  noInterrupts();
+  alertFlag[ch] = false;
+  edgeUs = alertUs[ch];
+  interrupts();
+  return true;
+}
+
+// ----- 1-Wire -----
+void halOneWireBegin() {}   // OneWire sets up the pin in its constructor
+
+bool halOneWireReset() { return oneWire.reset() == 1; }
+
+// power = 0: release the bus after the last byte (powered sensors)
+void halOneWireWrite(const uint8_t* buf, size_t len) { oneWire.write_bytes(buf, len, 0); }
+void halOneWireRead(uint8_t* buf, size_t len)        { oneWire.read_bytes(buf, len); }
+
+void halOneWireSearchReset()           { oneWire.reset_search(); }
+bool halOneWireSearch(uint8_t rom[8])  { return oneWire.search(rom); }
+
+// ----- CAN -----
+HalCanStats halCanStats() {
+  twai_status_info_t s;
+  uint32_t lost = twai_get_status_info(&s) == ESP_OK ? s.rx_missed_count + s.rx_overrun_count : 0;
+  return { n2kBus.received, lost };
+}
+
+// ----- Flash log partition -----
+static const esp_partition_t* logPartition = nullptr;
+
+size_t halFlashBegin() {
+  logPartition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "bmlog");
+  return logPartition ? logPartition->size : 0;
+}
+
+bool halFlashRead(uint32_t addr, void* buf, size_t len) {
+  return logPartition && esp_partition_read(logPartition, addr, buf, len) == ESP_OK;
+}
+
+bool halFlashProgram(uint32_t addr, const void* buf, size_t len) {
+  return logPartition && esp_partition_write(logPartition, addr, buf, len) == ESP_OK;
+}
+
+bool halFlashErase(uint32_t sector) {
+  return logPartition &&
+         esp_partition_erase_range(logPartition, sector * HAL_FLASH_SECTOR_SIZE, HAL_FLASH_SECTOR_SIZE) == ESP_OK;
+}
@@ -0,0 +1,123 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include <Arduino.h>
+#include <NMEA2000.h>
+
+// ===========================================================
+// Hal.h — Hardware abstraction layer
+// ===========================================================
+//
+// Everything that touches a peripheral or the clock goes
+// through these calls, so the rest of the firmware can be
+// compiled and run off the board.
+//
+// Provides:
+//   - Monotonic time (ms / µs, 32-bit wrapping like the ESP32)
+//   - A task pinned to the other core, for the stages that
+//     publish (Scheduler.h)
+//   - The I²C bus (transfers with a timeout, bus recovery) and
+//     the INA226 ALERT interrupts; the INA226 register protocol
+//     is in Ina226.h, timeouts/statistics in I2cBus.h
+//   - The 1-Wire bus of the DS18B20 sensors (byte level; the
+//     DS18B20 protocol is in TempBus.h)
+//   - Non-volatile storage (raw flash partition)
+//   - The shared NMEA2000 bus instance, its CAN acceptance
+//     filter and receive counters
+//
+// Hal.cpp implements it for the ESP32. The host build in
+// host/ provides in-memory stand-ins and a virtual clock.
+// ===========================================================
+
+// Temperature of a sensor that does not answer
+#define HAL_TEMP_DISCONNECTED (-127.0f)
+
+// ----- Time -----
+uint32_t halMillis();
+uint32_t halMicros();
+void     halIdleUntil(uint32_t deadlineUs);   // yield the CPU until halMicros() reaches it
+
+// ----- Tasks -----
+// Run fn() over and over in a task pinned to `core`, next to
+// the loop task. False where there is no second core (single
+// core chip, SINGLE_CORE, host build): the caller then runs
+// everything from loop().
+bool halStartTask(const char* name, void (*fn)(), uint8_t core);
+
+// ----- I²C bus -----
+#define HAL_I2C_OK       0
+#define HAL_I2C_NACK     1   // no device at the address (bus is fine)
+#define HAL_I2C_TIMEOUT  2   // a transfer exceeded the timeout (SCL or SDA held)
+#define HAL_I2C_ERROR    3   // arbitration lost, other bus errors
+
+void    halI2cBegin(int sda, int scl, uint32_t clockHz, uint32_t timeoutUs);
+// Write `out`, then (repeated start) read `inLen` bytes; a
+// pure write if inLen is 0. One addressed transaction.
+uint8_t halI2cTransfer(uint8_t addr, const uint8_t* out, size_t outLen, uint8_t* in, size_t inLen);
+// Clock SCL up to 9 times until SDA is released, then a STOP
+// and restart the controller; false if SDA stays low
+bool    halI2cRecover();
+
+// ----- INA226 ALERT (conversion ready) interrupts -----
+void halAlertAttach(uint8_t ch, int pin);          // falling edge, open drain
+bool halAlertTake(uint8_t ch, uint32_t& edgeUs);   // once per edge, with its time
+
+// ----- 1-Wire bus -----
+// Each call blocks for its bus slots only (reset ~1 ms, byte
+// ~0.6 ms); the master may pause between any two bytes.
+void halOneWireBegin();
+bool halOneWireReset();                               // true if a device answered (presence)
+void halOneWireWrite(const uint8_t* buf, size_t len);
+void halOneWireRead(uint8_t* buf, size_t len);
+void halOneWireSearchReset();
+bool halOneWireSearch(uint8_t rom[8]);                // next ROM on the bus, false when done
+
+// ----- Non-volatile storage -----
+// NOR flash semantics: erase sets a whole sector to 0xFF,
+// program can only clear bits. Addresses are offsets into the
+// log partition ("bmlog" in partitions.csv).
+#define HAL_FLASH_SECTOR_SIZE 4096
+
+size_t halFlashBegin();          // partition size in bytes, 0 if missing
+bool   halFlashRead(uint32_t addr, void* buf, size_t len);
+bool   halFlashProgram(uint32_t addr, const void* buf, size_t len);
+bool   halFlashErase(uint32_t sector);
+
+// ----- NMEA2000 -----
+// ESP32 CAN controller (TWAI) on target, in-memory bus on the
+// host
+extern tNMEA2000& NMEA2000;
+
+// Acceptance filter: the controller drops every frame the node
+// does not handle, so backbone traffic (GPS, AIS, engine) is
+// never read or parsed. Dual filter mode; for extended frames
+// each filter compares ID28..ID13 = priority, reserved bit,
+// data page, PDU format and the top 3 bits of PDU specific
+// (mask bit 1 = don't care):
+//   1: DP 0, PF 0xE8..0xEF — ISO acknowledgement (59392), ISO
+//      request (59904), transport protocol (60160, 60416; also
+//      carries commanded address 65240) and address claim
+//      (60928); the rest of the range is rare addressed traffic
+//      (proprietary 61184), which the library ignores
+//   2: DP 1, PF 0xED — group function (126208)
+// CAN_ACCEPT_ALL in Config.h turns the filter off.
+#define HAL_CAN_FILTER1_CODE 0x0740
+#define HAL_CAN_FILTER1_MASK 0xF03F
+#define HAL_CAN_FILTER2_CODE 0x0F68
+#define HAL_CAN_FILTER2_MASK 0xF007
+
+// What the filter does to a 29-bit identifier (host model and
+// tests; the target programs the codes above)
+inline bool halCanAccepts(uint32_t id) {
+  uint16_t top = (uint16_t)(id >> 13);
+  return ((top ^ HAL_CAN_FILTER1_CODE) & ~HAL_CAN_FILTER1_MASK & 0xFFFF) == 0 ||
+         ((top ^ HAL_CAN_FILTER2_CODE) & ~HAL_CAN_FILTER2_MASK & 0xFFFF) == 0;
+}
+
+struct HalCanStats {
+  uint32_t received;   // frames read by the library (passed the filter)
+  uint32_t dropped;    // lost before that: receive queue full, controller overrun
+};
+HalCanStats halCanStats();
+
+#endif // HAL_H
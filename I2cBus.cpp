@@ -0,0 +1,71 @@
+#include "I2cBus.h"
+#include "Config.h"
+#include "Hal.h"
+
+static I2cDeviceStats devStats[I2C_MAX_DEVICES];
+static I2cBusStats busStats;
+static uint32_t downSinceMs;
+
+void i2cBegin(int sda, int scl) {
+  halI2cBegin(sda, scl, I2C_CLOCK_HZ, I2C_TIMEOUT_US);
+  busStats = I2cBusStats();
+}
+
+// While the bus is down, try a recovery once per I2C_RETRY_MS
+static bool busUsable() {
+  if (!busStats.down) return true;
+  if (halMillis() - downSinceMs < I2C_RETRY_MS) return false;
+  if (!halI2cRecover()) {
+    busStats.failedRecoveries++;
+    downSinceMs = halMillis();
+    return false;
+  }
+  busStats.recoveries++;
+  busStats.down = false;
+  return true;
+}
+
+static bool transfer(uint8_t dev, uint8_t addr, const uint8_t* out, size_t outLen, uint8_t* in, size_t inLen) {
+  if (!busUsable()) {
+    busStats.skipped++;
+    return false;
+  }
+  I2cDeviceStats& s = devStats[dev];
+  uint32_t t0 = halMicros();
+  uint8_t st = halI2cTransfer(addr, out, outLen, in, inLen);
+  uint32_t us = halMicros() - t0;
+  s.transactions++;
+  s.sumUs += us;
+  if (us > s.maxUs) s.maxUs = us;
+  if (st == HAL_I2C_OK) return true;
+  if (st == HAL_I2C_NACK) {
+    s.nacks++;
+    return false;
+  }
+
+  // Timeout / bus error: free a slave stuck mid-byte
+  s.timeouts++;
+  if (halI2cRecover()) {
+    busStats.recoveries++;
+  } else {
+    busStats.failedRecoveries++;
+    busStats.down = true;
+    downSinceMs = halMillis();
+  }
+  return false;
+}
+
+bool i2cReadReg16(uint8_t dev, uint8_t addr, uint8_t reg, uint16_t& value) {
+  uint8_t buf[2];
+  if (!transfer(dev, addr, &reg, 1, buf, 2)) return false;
+  value = (uint16_t)buf[0] << 8 | buf[1];
+  return true;
+}
+
+bool i2cWriteReg16(uint8_t dev, uint8_t addr, uint8_t reg, uint16_t value) {
+  uint8_t buf[3] = { reg, (uint8_t)(value >> 8), (uint8_t)value };
+  return transfer(dev, addr, buf, 3, nullptr, 0);
+}
+
+const I2cDeviceStats& i2cDeviceStats(uint8_t dev) { return devStats[dev]; }
+const I2cBusStats& i2cBusStats() { return busStats; }
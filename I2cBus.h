@@ -0,0 +1,54 @@
+#ifndef I2CBUS_H
+#define I2CBUS_H
+
+#include <Arduino.h>
+
+// ===========================================================
+// I2cBus.h — Bounded I²C transactions with bus recovery
+// ===========================================================
+//
+// Provides:
+//   - Register reads/writes as single addressed transactions
+//     (pointer write, repeated start, read), each bounded by
+//     I2C_TIMEOUT_US in the HAL
+//   - Bus recovery: after a timeout or bus error, 9 clocks and
+//     a STOP release a slave stuck mid-byte. If SDA stays low
+//     the bus is marked down and no transaction is attempted
+//     for I2C_RETRY_MS, then recovery is tried again. A hung
+//     bus costs one timeout per retry period, not one per
+//     access, so sampling, SoC and NMEA keep their schedule.
+//   - Per-device statistics (transactions, NACKs, timeouts,
+//     latency) and bus statistics (recoveries, skipped
+//     transactions)
+//
+// Devices are numbered by the caller (the INA226 channel);
+// a NACK is the device's problem and does not touch the bus.
+// ===========================================================
+
+#define I2C_MAX_DEVICES 8
+
+struct I2cDeviceStats {
+  uint32_t transactions;     // attempted, including failed
+  uint32_t nacks;
+  uint32_t timeouts;         // timeouts and bus errors
+  uint32_t maxUs;            // longest transaction
+  uint64_t sumUs;
+};
+
+struct I2cBusStats {
+  uint32_t recoveries;       // SDA released by the recovery clocks
+  uint32_t failedRecoveries; // SDA still low: bus marked down
+  uint32_t skipped;          // transactions refused while down
+  bool     down;
+};
+
+void i2cBegin(int sda, int scl);
+
+// 16-bit big-endian register access (INA226 layout)
+bool i2cReadReg16(uint8_t dev, uint8_t addr, uint8_t reg, uint16_t& value);
+bool i2cWriteReg16(uint8_t dev, uint8_t addr, uint8_t reg, uint16_t value);
+
+const I2cDeviceStats& i2cDeviceStats(uint8_t dev);
+const I2cBusStats& i2cBusStats();
+
+#endif // I2CBUS_H
@@ -0,0 +1,95 @@
+#include "Ina226.h"
+#include "Config.h"
+#include "Hal.h"
+#include "I2cBus.h"
+
+// Registers
+#define REG_CONFIG       0x00
+#define REG_SHUNT        0x01
+#define REG_BUS          0x02
+#define REG_CALIBRATION  0x05
+#define REG_MASK_ENABLE  0x06
+#define REG_MANUFACTURER 0xFE
+
+#define MANUFACTURER_TI  0x5449
+#define MASK_CNVR        0x0400   // ALERT on conversion ready
+#define MASK_CVRF        0x0008   // conversion ready flag (cleared by reading)
+#define CONFIG_MODE_CONT 0x0007   // shunt and bus, continuous
+
+// Datasheet: conversion time per code, samples per average code
+static const uint16_t CT_US[8] = { 140, 204, 332, 588, 1100, 2116, 4156, 8244 };
+static const uint16_t AVG_N[8] = { 1, 4, 16, 64, 128, 256, 512, 1024 };
+
+struct InaChannel {
+  uint8_t  addr;
+  int      alertPin;
+  uint32_t convUs;
+  bool     ackPending;       // ALERT edge taken, flag not yet cleared
+  uint32_t edgeUs;
+};
+
+static InaChannel inas[NUM_BATTERIES];
+
+bool inaBegin(uint8_t ch, uint8_t addr) {
+  InaChannel& c = inas[ch];
+  c.addr = addr;
+  c.alertPin = -1;
+  c.ackPending = false;
+  uint16_t id;
+  return i2cReadReg16(ch, addr, REG_MANUFACTURER, id) && id == MANUFACTURER_TI;
+}
+
+int inaCalibrate(uint8_t ch, float maxAmps, float shuntOhms) {
+  if (maxAmps <= 0 || shuntOhms <= 0) return -1;
+  if (maxAmps * shuntOhms > INA226_SHUNT_FS_V) return -2;   // beyond the shunt input range
+  // Only the current/power registers use it; kept consistent
+  // for anyone reading them with other tools
+  float currentLsb = maxAmps / 32768.0f;
+  uint32_t cal = (uint32_t)(0.00512f / (currentLsb * shuntOhms));
+  if (cal > 0x7FFF) cal = 0x7FFF;
+  return i2cWriteReg16(ch, inas[ch].addr, REG_CALIBRATION, (uint16_t)cal) ? 0 : -3;
+}
+
+bool inaConfigure(uint8_t ch, uint8_t avgCode, uint8_t busCtCode, uint8_t shuntCtCode) {
+  InaChannel& c = inas[ch];
+  uint16_t cfg = 0x4000 | (uint16_t)(avgCode & 7) << 9 | (uint16_t)(busCtCode & 7) << 6 |
+                 (uint16_t)(shuntCtCode & 7) << 3 | CONFIG_MODE_CONT;
+  c.convUs = (uint32_t)(CT_US[busCtCode & 7] + CT_US[shuntCtCode & 7]) * AVG_N[avgCode & 7];
+  return i2cWriteReg16(ch, c.addr, REG_CONFIG, cfg);
+}
+
+uint32_t inaConversionUs(uint8_t ch) { return inas[ch].convUs; }
+
+void inaEnableReady(uint8_t ch, int alertPin) {
+  InaChannel& c = inas[ch];
+  i2cWriteReg16(ch, c.addr, REG_MASK_ENABLE, MASK_CNVR);
+  c.alertPin = alertPin;
+  halAlertAttach(ch, alertPin);
+}
+
+bool inaSampleReady(uint8_t ch, uint32_t& sampleUs) {
+  InaChannel& c = inas[ch];
+  uint16_t mask;
+  if (c.alertPin >= 0) {
+    // Interrupt mode: no bus traffic until the ALERT edge
+    if (!c.ackPending) {
+      if (!halAlertTake(ch, c.edgeUs)) return false;
+      c.ackPending = true;
+    }
+    if (!i2cReadReg16(ch, c.addr, REG_MASK_ENABLE, mask)) return false;   // releases ALERT
+    c.ackPending = false;
+    sampleUs = c.edgeUs;
+    return true;
+  }
+  // Polling mode: CVRF is cleared by the same read
+  sampleUs = halMicros();
+  return i2cReadReg16(ch, c.addr, REG_MASK_ENABLE, mask) && (mask & MASK_CVRF);
+}
+
+bool inaRead(uint8_t ch, int16_t& shuntRaw, uint16_t& busRaw) {
+  const InaChannel& c = inas[ch];
+  uint16_t shunt;
+  if (!i2cReadReg16(ch, c.addr, REG_SHUNT, shunt) || !i2cReadReg16(ch, c.addr, REG_BUS, busRaw)) return false;
+  shuntRaw = (int16_t)shunt;
+  return true;
+}
@@ -0,0 +1,40 @@
+#ifndef INA226_H
+#define INA226_H
+
+#include <Arduino.h>
+
+// ===========================================================
+// Ina226.h — INA226 power monitor driver on I2cBus
+// ===========================================================
+//
+// Provides, per channel (0 = battery 1):
+//   - Presence check (manufacturer ID), configuration of the
+//     averaging / conversion times, shunt range check
+//   - Conversion-ready detection: ALERT edge (interrupt) or
+//     polling the CVRF flag over I²C
+//   - One sample = shunt and bus voltage registers, each one
+//     repeated-start transaction. The INA226 register pointer
+//     does not auto-increment, so there is no multi-register
+//     burst; the current register is not read, current is the
+//     shunt voltage over the shunt resistance.
+//
+// Every access goes through I2cBus (timeouts, recovery). A
+// failed read returns false and the conversion is skipped;
+// the next one integrates over the gap. If the read that
+// releases ALERT fails, it is retried on the next call (ALERT
+// stays low until then, so no new edge would come).
+// ===========================================================
+
+#define INA226_SHUNT_LSB_V  2.5e-6   // shunt voltage register LSB
+#define INA226_BUS_LSB_V    1.25e-3  // bus voltage register LSB
+#define INA226_SHUNT_FS_V   0.08192  // shunt full scale
+
+bool     inaBegin(uint8_t ch, uint8_t addr);   // false if it does not answer as an INA226
+int      inaCalibrate(uint8_t ch, float maxAmps, float shuntOhms);   // 0 = OK
+bool     inaConfigure(uint8_t ch, uint8_t avgCode, uint8_t busCtCode, uint8_t shuntCtCode);
+void     inaEnableReady(uint8_t ch, int alertPin);   // alertPin < 0: poll the flag over I²C
+bool     inaSampleReady(uint8_t ch, uint32_t& sampleUs);   // once per finished conversion
+bool     inaRead(uint8_t ch, int16_t& shuntRaw, uint16_t& busRaw);
+uint32_t inaConversionUs(uint8_t ch);   // configured conversion period (averaged)
+
+#endif // INA226_H
@@ -0,0 +1,153 @@
+#include "Journal.h"
+#include "Hal.h"
+#include <string.h>
+
+#define JOURNAL_MAGIC       0x314A4D42UL   // "BMJ1"
+#define JOURNAL_HEADER_SIZE 12
+#define RECORD_OVERHEAD     4              // type, len, crc16
+
+struct JournalHeader {
+  uint32_t magic;
+  uint32_t seq;
+  uint16_t crc;
+  uint16_t reserved;
+};
+
+uint16_t crc16(const void* data, size_t len, uint16_t crc) {
+  const uint8_t* p = (const uint8_t*)data;
+  while (len--) {
+    crc ^= (uint16_t)(*p++) << 8;
+    for (uint8_t b = 0; b < 8; b++) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+static bool readHeader(uint8_t sector, JournalHeader& h) {
+  if (!halFlashRead(sector * HAL_FLASH_SECTOR_SIZE, &h, sizeof(h))) return false;
+  return h.magic == JOURNAL_MAGIC && h.crc == crc16(&h, 8);
+}
+
+// ==========================
+// Mount / replay
+// ==========================
+
+bool Journal::begin(uint8_t sectors, RecordFn fn, void* ctx) {
+  size_t size = halFlashBegin();
+  if (sectors > size / HAL_FLASH_SECTOR_SIZE) sectors = size / HAL_FLASH_SECTOR_SIZE;
+  sectorCount = sectors;
+  active = -1;
+  seq = 0;
+  head = 0;
+  nextReady = false;
+  if (!mounted()) return false;
+
+  for (uint8_t s = 0; s < sectorCount; s++) {
+    JournalHeader h;
+    if (readHeader(s, h) && (active < 0 || h.seq > seq)) {
+      active = s;
+      seq = h.seq;
+    }
+  }
+  if (active >= 0) {
+    bool clean;
+    head = scan(active, fn, ctx, clean);
+    if (!clean) head = HAL_FLASH_SECTOR_SIZE;   // never program over a torn record
+  }
+  return true;
+}
+
+bool Journal::replay(RecordFn fn, void* ctx) {
+  if (active < 0) return false;
+  bool clean;
+  scan(active, fn, ctx, clean);
+  return true;
+}
+
+// Walk the records of a sector; returns the end of the valid
+// log. `clean` is false if it ends in a corrupt record or the
+// space after it is not erased.
+uint32_t Journal::scan(uint8_t sector, RecordFn fn, void* ctx, bool& clean) {
+  uint32_t base = sector * HAL_FLASH_SECTOR_SIZE;
+  uint32_t off = JOURNAL_HEADER_SIZE;
+  uint8_t buf[JOURNAL_MAX_PAYLOAD + RECORD_OVERHEAD];
+  clean = false;
+
+  while (off + RECORD_OVERHEAD <= HAL_FLASH_SECTOR_SIZE) {
+    if (!halFlashRead(base + off, buf, 2)) return off;
+    if (buf[0] == 0xFF) break;                    // erased: end of log
+    uint8_t len = buf[1];
+    uint32_t size = RECORD_OVERHEAD + len;
+    if (len > JOURNAL_MAX_PAYLOAD || off + size > HAL_FLASH_SECTOR_SIZE) return off;
+    if (!halFlashRead(base + off + 2, buf + 2, len + 2)) return off;
+    uint16_t crc;
+    memcpy(&crc, buf + 2 + len, 2);
+    if (crc != crc16(buf, 2 + len)) return off;
+    if (fn) fn(buf[0], buf + 2, len, ctx);
+    off += size;
+  }
+
+  // The tail must still be erased to be programmable
+  for (uint32_t a = off; a < HAL_FLASH_SECTOR_SIZE; a += sizeof(buf)) {
+    uint32_t n = HAL_FLASH_SECTOR_SIZE - a < sizeof(buf) ? HAL_FLASH_SECTOR_SIZE - a : sizeof(buf);
+    if (!halFlashRead(base + a, buf, n)) return off;
+    for (uint32_t k = 0; k < n; k++) if (buf[k] != 0xFF) return off;
+  }
+  clean = true;
+  return off;
+}
+
+// ==========================
+// Writing
+// ==========================
+
+bool Journal::program(uint32_t addr, uint8_t type, const void* payload, uint8_t len) {
+  uint8_t buf[JOURNAL_MAX_PAYLOAD + RECORD_OVERHEAD];
+  buf[0] = type;
+  buf[1] = len;
+  memcpy(buf + 2, payload, len);
+  uint16_t crc = crc16(buf, 2 + len);
+  memcpy(buf + 2 + len, &crc, 2);
+  return halFlashProgram(addr, buf, RECORD_OVERHEAD + len);
+}
+
+bool Journal::fits(uint8_t len) const {
+  return active >= 0 && len <= JOURNAL_MAX_PAYLOAD &&
+         head + RECORD_OVERHEAD + len <= HAL_FLASH_SECTOR_SIZE;
+}
+
+bool Journal::append(uint8_t type, const void* payload, uint8_t len) {
+  if (type == 0xFF || !fits(len)) return false;
+  uint32_t addr = active * HAL_FLASH_SECTOR_SIZE + head;
+  head += RECORD_OVERHEAD + len;   // a failed program leaves a torn record: skip it either way
+  return program(addr, type, payload, len);
+}
+
+static uint8_t nextSector(int active, uint8_t sectorCount) {
+  return active < 0 ? 0 : (active + 1) % sectorCount;
+}
+
+bool Journal::eraseNext() {
+  if (!mounted()) return false;
+  nextReady = halFlashErase(nextSector(active, sectorCount));
+  return nextReady;
+}
+
+bool Journal::rotate(uint8_t type, const void* payload, uint8_t len) {
+  if (!mounted() || type == 0xFF || len > JOURNAL_MAX_PAYLOAD) return false;
+  uint8_t next = nextSector(active, sectorCount);
+  uint32_t base = next * HAL_FLASH_SECTOR_SIZE;
+
+  // Base record first, header last: the sector only becomes
+  // valid once both are in flash
+  if (!nextReady && !halFlashErase(next)) return false;
+  nextReady = false;
+  if (!program(base + JOURNAL_HEADER_SIZE, type, payload, len)) return false;
+  JournalHeader h = { JOURNAL_MAGIC, seq + 1, 0, 0xFFFF };
+  h.crc = crc16(&h, 8);
+  if (!halFlashProgram(base, &h, sizeof(h))) return false;
+
+  active = next;
+  seq = h.seq;
+  head = JOURNAL_HEADER_SIZE + RECORD_OVERHEAD + len;
+  return true;
+}
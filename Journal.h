@@ -0,0 +1,75 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <Arduino.h>
+
+// ===========================================================
+// Journal.h — Append-only record log in raw flash
+// ===========================================================
+//
+// Provides:
+//   - Typed records (type, length, payload, CRC-16) programmed
+//     into the erased tail of the active sector, so a write
+//     costs no erase
+//   - Sector rotation: when the active sector is full, the
+//     next one is erased and started with a base record
+//     (normally a full snapshot) supplied by the caller. The
+//     erase can be done ahead with eraseNext(), so a caller
+//     can place the long operation where it hurts least
+//   - Mount: the valid sector with the highest sequence number
+//     is active (one header read per sector); its records
+//     replay in write order and the log ends at the first
+//     erased or corrupt record. Mounting and replaying share
+//     one pass over the active sector, so a boot reads each
+//     record once
+//
+// Power loss: a sector header is programmed after its base
+// record, so a sector torn during rotation is never selected.
+// A torn record fails its CRC and ends the replay; the next
+// append then rotates instead of writing past it.
+//
+// Sector layout (little-endian):
+//   header: magic (4) | seq (4) | crc16 (2) | 0xFFFF (2)
+//   record: type (1) | len (1) | payload (len) | crc16 (2)
+// ===========================================================
+
+#define JOURNAL_MAX_PAYLOAD 240
+
+// CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF)
+uint16_t crc16(const void* data, size_t len, uint16_t crc = 0xFFFF);
+
+class Journal {
+public:
+  typedef void (*RecordFn)(uint8_t type, const uint8_t* payload, uint8_t len, void* ctx);
+
+  // Mount the log on the first `sectors` sectors of the
+  // partition, passing the active sector's records to `fn`
+  bool begin(uint8_t sectors, RecordFn fn = nullptr, void* ctx = nullptr);
+  // Replay the active sector; false if there is none
+  bool replay(RecordFn fn, void* ctx);
+  // Append a record; false when it does not fit (rotate() instead)
+  bool append(uint8_t type, const void* payload, uint8_t len);
+  bool fits(uint8_t len) const;
+  // Erase the sector rotate() will use next
+  bool eraseNext();
+  bool nextErased() const { return nextReady; }
+  // Start the next sector with a base record (erases it first
+  // unless eraseNext() already did)
+  bool rotate(uint8_t type, const void* payload, uint8_t len);
+
+  bool     mounted() const  { return sectorCount >= 2; }
+  uint32_t sequence() const { return seq; }
+  uint32_t used() const     { return head; }   // bytes in the active sector
+
+private:
+  uint32_t scan(uint8_t sector, RecordFn fn, void* ctx, bool& clean);
+  bool     program(uint32_t addr, uint8_t type, const void* payload, uint8_t len);
+
+  uint8_t  sectorCount = 0;
+  int      active = -1;
+  uint32_t seq = 0;
+  uint32_t head = 0;      // next free offset; sector size if unusable
+  bool     nextReady = false;
+};
+
+#endif // JOURNAL_H
@@ -0,0 +1,88 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <stddef.h>
+
+// ===========================================================
+// Matrix.h — Fixed-size float matrices
+// ===========================================================
+//
+// Matrix<R, C> is a plain R x C array of floats (row-major),
+// sized at compile time: no heap, no dynamic dimensions, and
+// the loops have constant bounds so the compiler unrolls them
+// for the 1..4 element sizes a small filter needs. Dimension
+// mismatches are compile errors.
+//
+// Provides +, -, * (matrix and scalar), transpose() and
+// identity/zero constructors. There is no general inverse:
+// callers with a scalar measurement divide by the 1 x 1
+// innovation instead.
+// ===========================================================
+
+template <size_t R, size_t C>
+struct Matrix {
+  float m[R][C];
+
+  float&       operator()(size_t r, size_t c)       { return m[r][c]; }
+  const float& operator()(size_t r, size_t c) const { return m[r][c]; }
+
+  static Matrix zero() {
+    Matrix a;
+    for (size_t r = 0; r < R; r++)
+      for (size_t c = 0; c < C; c++) a.m[r][c] = 0.0f;
+    return a;
+  }
+
+  static Matrix identity() {
+    Matrix a = zero();
+    for (size_t k = 0; k < R && k < C; k++) a.m[k][k] = 1.0f;
+    return a;
+  }
+};
+
+template <size_t R, size_t C>
+Matrix<C, R> transpose(const Matrix<R, C>& a) {
+  Matrix<C, R> t;
+  for (size_t r = 0; r < R; r++)
+    for (size_t c = 0; c < C; c++) t.m[c][r] = a.m[r][c];
+  return t;
+}
+
+template <size_t R, size_t K, size_t C>
+Matrix<R, C> operator*(const Matrix<R, K>& a, const Matrix<K, C>& b) {
+  Matrix<R, C> p;
+  for (size_t r = 0; r < R; r++) {
+    for (size_t c = 0; c < C; c++) {
+      float s = 0.0f;
+      for (size_t k = 0; k < K; k++) s += a.m[r][k] * b.m[k][c];
+      p.m[r][c] = s;
+    }
+  }
+  return p;
+}
+
+template <size_t R, size_t C>
+Matrix<R, C> operator*(const Matrix<R, C>& a, float s) {
+  Matrix<R, C> p;
+  for (size_t r = 0; r < R; r++)
+    for (size_t c = 0; c < C; c++) p.m[r][c] = a.m[r][c] * s;
+  return p;
+}
+
+template <size_t R, size_t C>
+Matrix<R, C> operator+(const Matrix<R, C>& a, const Matrix<R, C>& b) {
+  Matrix<R, C> p;
+  for (size_t r = 0; r < R; r++)
+    for (size_t c = 0; c < C; c++) p.m[r][c] = a.m[r][c] + b.m[r][c];
+  return p;
+}
+
+template <size_t R, size_t C>
+Matrix<R, C> operator-(const Matrix<R, C>& a, const Matrix<R, C>& b) {
+  Matrix<R, C> p;
+  for (size_t r = 0; r < R; r++)
+    for (size_t c = 0; c < C; c++) p.m[r][c] = a.m[r][c] - b.m[r][c];
+  return p;
+}
+
+#endif // MATRIX_H
@@ -0,0 +1,91 @@
+#ifndef MINMAX_WINDOW_H
+#define MINMAX_WINDOW_H
+
+#include <Arduino.h>
+#include <math.h>
+
+// ===========================================================
+// MinMaxWindow.h — Sliding min/max over a time window
+// ===========================================================
+//
+// Tracks the minimum and maximum of a signal over the last
+// `windowMs` in constant memory, independent of the sample
+// rate or window length:
+//   - The window is split into MINMAX_BUCKETS time buckets;
+//     each bucket keeps only its own min/max.
+//   - add() updates the current bucket (O(1)). When a bucket
+//     closes, the min/max over the closed buckets is
+//     recomputed (O(MINMAX_BUCKETS), once per bucket length).
+//   - min()/max() combine that with the open bucket (O(1)).
+//
+// The result covers between windowMs and windowMs plus one
+// bucket length (windowMs / MINMAX_BUCKETS) of history.
+// covered() is true once a full window has been observed
+// since the last reset().
+// ===========================================================
+
+#define MINMAX_BUCKETS 16
+
+struct MinMaxWindow {
+  float    bucketMin[MINMAX_BUCKETS + 1];
+  float    bucketMax[MINMAX_BUCKETS + 1];
+  float    closedMin, closedMax;   // over the closed buckets
+  uint32_t bucketMs;
+  uint32_t bucketStartMs;
+  uint8_t  head;                   // open bucket
+  uint8_t  closed;                 // closed buckets in the window
+
+  void begin(uint32_t windowMs, uint32_t nowMs) {
+    bucketMs = windowMs / MINMAX_BUCKETS;
+    if (bucketMs == 0) bucketMs = 1;
+    reset(nowMs);
+  }
+
+  void reset(uint32_t nowMs) {
+    head = 0;
+    closed = 0;
+    bucketStartMs = nowMs;
+    bucketMin[0] = INFINITY;
+    bucketMax[0] = -INFINITY;
+    closedMin = INFINITY;
+    closedMax = -INFINITY;
+  }
+
+  void add(float v, uint32_t nowMs) {
+    uint32_t elapsed = nowMs - bucketStartMs;
+    if (elapsed >= bucketMs) {
+      if (elapsed >= bucketMs * (MINMAX_BUCKETS + 1)) {
+        reset(nowMs);               // gap longer than the window
+      } else {
+        while (nowMs - bucketStartMs >= bucketMs) {
+          bucketStartMs += bucketMs;
+          closeBucket();
+        }
+      }
+    }
+    if (v < bucketMin[head]) bucketMin[head] = v;
+    if (v > bucketMax[head]) bucketMax[head] = v;
+  }
+
+  bool  covered() const { return closed >= MINMAX_BUCKETS; }
+  float min() const     { return fminf(closedMin, bucketMin[head]); }
+  float max() const     { return fmaxf(closedMax, bucketMax[head]); }
+
+private:
+  void closeBucket() {
+    head = (head + 1) % (MINMAX_BUCKETS + 1);
+    if (closed < MINMAX_BUCKETS) closed++;
+    bucketMin[head] = INFINITY;
+    bucketMax[head] = -INFINITY;
+
+    closedMin = INFINITY;
+    closedMax = -INFINITY;
+    for (uint8_t k = 1; k <= closed; k++) {
+      uint8_t slot = (head + MINMAX_BUCKETS + 1 - k) % (MINMAX_BUCKETS + 1);
+      closedMin = fminf(closedMin, bucketMin[slot]);
+      closedMax = fmaxf(closedMax, bucketMax[slot]);
+    }
+  }
+};
+
+#endif // MINMAX_WINDOW_H
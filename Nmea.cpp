@@ -0,0 +1,517 @@
+#include "Nmea.h"
+#include "Globals.h"
+#include "Config.h"
+#include "Sensors.h"
+#include <N2kMessages.h>
+#include <math.h>
+#include <string.h>
+
+static bool socAnnounced = false;   // DC status sent since every SoC became valid
+static unsigned char sid = 0;       // last sequence ID handed out
+static NmeaRxStats rxStats;
+
+// SID ties the PGNs of one measurement together; 0..252
+// (253..255 are reserved). Each bank snapshot gets one
+// (bankSid[], readSnapshots()), and every PGN built from it
+// carries that one.
+static unsigned char nextSid() {
+  sid = sid >= 252 ? 0 : sid + 1;
+  return sid;
+}
+
+// ===========================================================
+// Samples from the acquisition side
+// ===========================================================
+// The sensors stage runs on the other core and pushes each
+// bank's new readings into sampleRing (Sensors.h); nmeaLoop()
+// drains it first. PGN 127508 and its change detection use
+// the latest sample of each bank, and the alerts follow the
+// fault bits the samples carry: a raise or clear is a bit that
+// differs from the previous sample's, timestamped with the
+// sample. A sample dropped on a full ring delays a change to
+// the next one; it is not lost.
+static BankSample latest[NUM_BATTERIES];
+static bool       haveLatest[NUM_BATTERIES];
+static uint8_t    faultBits[NUM_BATTERIES];                 // as of the latest sample
+static uint8_t    faultChanged[NUM_BATTERIES];              // raised or cleared, alert not sent yet
+static uint32_t   faultChangedMs[FAULT_TYPES][NUM_BATTERIES];
+static uint8_t    faultOccurrence[FAULT_TYPES][NUM_BATTERIES];   // raises so far
+
+static void drainSamples() {
+  BankSample s;
+  while (sampleRing.pop(s)) {
+    if (s.bank >= NUM_BATTERIES) continue;
+    uint8_t diff = s.faults ^ faultBits[s.bank];
+    for (uint8_t f = 0; f < FAULT_TYPES; f++) {
+      if (!(diff & (1u << f))) continue;
+      faultChanged[s.bank] |= (uint8_t)(1u << f);
+      faultChangedMs[f][s.bank] = s.ms;
+      if (s.faults & (1u << f)) faultOccurrence[f][s.bank]++;
+    }
+    faultBits[s.bank] = s.faults;
+    latest[s.bank] = s;
+    haveLatest[s.bank] = true;
+  }
+}
+
+// Bank state as published by the acquisition side (Battery.h),
+// read once per nmeaLoop() run: PGN 127506 and its change
+// detection see one consistent copy per bank. A read that
+// keeps meeting a write keeps the previous copy.
+static BankSnapshot state[NUM_BATTERIES];
+static unsigned char bankSid[NUM_BATTERIES];   // SID of state[i]
+
+static void setupSchedule(uint32_t now);   // transmit schedule, below
+static void buildBatteryConfig(uint8_t instance);
+static bool onIsoRequest(unsigned long pgn, unsigned char requester, int deviceIndex);
+
+// PGNs this node transmits (announced in its PGN list)
+static const unsigned long transmitPgns[] = { 126983L, 127506L, 127508L, 127513L, 0 };
+
+// ===========================================================
+// Setup
+// ===========================================================
+void setupNmea() {
+  NMEA2000.SetProductInformation("12345678",  // Serial code
+                                 100,         // Product code
+                                 "Battery Monitor",  // Model ID
+                                 "1.1.0.0",         // Software version
+                                 "1.0.0.0");        // Hardware version
+
+  NMEA2000.SetDeviceInformation(1,   // Unique number
+                                140, // Device function = Battery monitor
+                                85,  // Device class = Electrical Generation
+                                2046); // Manufacturer code (demo)
+
+  // Node only: nothing here listens to other nodes' PGNs (and
+  // the CAN filter would not let them through anyway)
+  NMEA2000.SetMode(tNMEA2000::N2km_NodeOnly);
+  NMEA2000.EnableForward(false);
+  NMEA2000.ExtendTransmitMessages(transmitPgns);
+  NMEA2000.SetISORqstHandler(onIsoRequest);
+  NMEA2000.Open();
+
+  for (uint8_t i = 0; i < NUM_BATTERIES; i++) buildBatteryConfig(i);
+  setupSchedule(halMillis());
+}
+
+// ===========================================================
+// PGN 127508 — Battery Status
+// From the latest sample; "not available" before the first.
+// The sample and the bank snapshot of its sensor pass share
+// a time, so it carries the snapshot's SID like PGN 127506.
+// ===========================================================
+void sendNmeaBatteryStatus(uint8_t instance) {
+  tN2kMsg N2kMsg;
+  const BankSample& s = latest[instance];
+  bool have = haveLatest[instance];
+
+  SetN2kPGN127508(N2kMsg, instance,
+                  have ? s.volts : N2kDoubleNA,
+                  have ? s.amps : N2kDoubleNA,
+                  have ? s.tempK : N2kDoubleNA,
+                  bankSid[instance]);
+
+  NMEA2000.SendMsg(N2kMsg);
+}
+
+// ===========================================================
+// PGN 127506 — DC Detailed Status
+// SoC and remaining capacity are "not available" until the
+// bank's SoC is valid. Time remaining is the time to empty
+// while discharging, the time to full while charging, and not
+// available when idle (Runtime.h).
+// ===========================================================
+void sendNmeaDcStatus(uint8_t instance) {
+  tN2kMsg N2kMsg;
+  const BankSnapshot& s = state[instance];
+  bool valid = s.socValid;
+  unsigned char soc = valid ? (unsigned char)s.socPercent : N2kUInt8NA;
+  float tte = s.timeToEmptyS;
+  float ttf = s.timeToFullS;
+  double remaining = !isnan(tte) ? tte : !isnan(ttf) ? ttf : N2kDoubleNA;
+
+  SetN2kPGN127506(N2kMsg,
+                  bankSid[instance], // SID
+                  instance,          // DCInstance
+                  N2kDCt_Battery,    // DC Type
+                  soc,               // SoC
+                  (unsigned char)s.sohPercent,  // SoH
+                  remaining,         // Time remaining (s)
+                  N2kDoubleNA,       // Ripple (not measured)
+                  valid ? s.remainingAh * 3600.0 : N2kDoubleNA);  // Remaining capacity (C)
+
+  NMEA2000.SendMsg(N2kMsg);
+}
+
+// ===========================================================
+// PGN 127513 — Battery Configuration
+// The payload only depends on Config.h, so it is built once
+// at setup and the cached frame is sent as is. N2K has no
+// battery type for lithium (types are flooded / gel / AGM):
+// LiFePO4 sends type "unavailable" with chemistry Li-ion. The
+// N2K temperature coefficient is a capacity coefficient, which
+// BATTn_TEMP_COEF (an OCV voltage slope) is not: not sent.
+// ===========================================================
+static tN2kMsg configMsg[NUM_BATTERIES];
+
+static void buildBatteryConfig(uint8_t instance) {
+  const BankConfig& cfg = bankConfig[instance];
+
+  tN2kBatType batType;
+  tN2kBatChem batChem;
+  switch (cfg.chemistry) {
+    case CHEM_FLA: batType = N2kDCbt_Flooded; batChem = N2kDCbc_LeadAcid; break;
+    case CHEM_GEL: batType = N2kDCbt_Gel;     batChem = N2kDCbc_LeadAcid; break;
+    case CHEM_AGM: batType = N2kDCbt_AGM;     batChem = N2kDCbc_LeadAcid; break;
+    case CHEM_LFP: batType = (tN2kBatType)0x0f; batChem = N2kDCbc_LiIon; break;
+    default:       batType = (tN2kBatType)0x0f; batChem = (tN2kBatChem)0x0f; break;
+  }
+
+  tN2kBatNomVolt nominalVolt = cfg.nominalV == 48 ? N2kDCbnv_48v
+                             : cfg.nominalV == 24 ? N2kDCbnv_24v
+                             : N2kDCbnv_12v;
+
+  SetN2kPGN127513(configMsg[instance],
+                  instance,
+                  batType,
+                  N2kDCES_No,                       // No equalization
+                  nominalVolt,
+                  batChem,
+                  cfg.capacityAh * 3600.0,          // Capacity (C)
+                  N2kInt8NA,                        // Temperature coefficient
+                  cfg.peukertExp,
+                  (int8_t)lroundf(cfg.chargeEff * 100.0f));  // Charge efficiency (%)
+}
+
+void sendNmeaBatteryConfig(uint8_t instance) {
+  NMEA2000.SendMsg(configMsg[instance]);
+}
+
+// ===========================================================
+// PGN 126983 — Alert
+// One alert per bank and fault type (Faults.h), identified by
+// its ID and by instance (bank) and index (fault type) as data
+// source. Low voltage is a warning, the other limits alarms.
+// The state is active while the fault is raised, normal once
+// it cleared.
+// ===========================================================
+void sendNmeaAlert(uint8_t instance, uint8_t fault) {
+  tN2kMsg N2kMsg;
+  bool active = faultBits[instance] & (1u << fault);
+  tN2kAlertThresholdStatus threshold = !active ? N2kts_AlertThresholdStatusNormal
+                                     : fault == FAULT_VOLT_LOW ? N2kts_AlertThresholdStatusLowExceeded
+                                     : N2kts_AlertThresholdStatusExceeded;
+
+  SetN2kPGN126983(N2kMsg,
+                  fault == FAULT_VOLT_LOW ? N2kts_AlertTypeWarning : N2kts_AlertTypeAlarm,
+                  N2kts_AlertCategoryTechnical,
+                  0, 0,                                   // Alert system / sub-system
+                  1 + instance * FAULT_TYPES + fault,     // Alert ID
+                  NMEA2000.GetDeviceInformation().GetName(),
+                  instance,                               // Data source instance
+                  fault,                                  // Data source index
+                  faultOccurrence[fault][instance],
+                  false, false, false,                    // Silenced, acknowledged, escalated
+                  false, false, false,                    // ... none supported
+                  0,                                      // Acknowledge source NAME
+                  N2kts_AlertTriggerAuto,
+                  threshold,
+                  fault == FAULT_VOLT_LOW ? 2 : 1,        // Alert priority
+                  active ? N2kts_AlertStateActive : N2kts_AlertStateNormal);
+
+  NMEA2000.SendMsg(N2kMsg);
+}
+
+// ===========================================================
+// Transmit schedule
+// ===========================================================
+//
+// One row per PGN: minimum and maximum interval, and how far
+// each tracked value may move before the PGN goes out early.
+// Every (PGN, instance) pair is a slot with its own timer:
+//   - sent when its maximum interval is up (heartbeat), or
+//   - earlier, once its minimum interval is up, if a tracked
+//     value moved by its threshold since the slot last went
+//     out (a load step shows within NMEA_508_MIN_MS instead
+//     of at the next fixed tick; an idle bank stays quiet)
+// First deadlines are spread over each PGN's maximum interval
+// (instances and PGNs phase-shifted), and at most
+// NMEA_FRAMES_PER_POLL frames go out per nmeaLoop() call, the
+// most overdue first, so slots that do fall due together
+// leave in consecutive polls instead of one burst. An ISO
+// request for a PGN (59904) marks its slots, which then go
+// ahead of everything else.
+
+#define NMEA_TRACKED 3
+
+struct NmeaRule {
+  uint32_t pgn;
+  uint32_t minMs, maxMs;
+  float    delta[NMEA_TRACKED];          // INFINITY: not tracked
+  void   (*send)(uint8_t instance);
+  void   (*values)(uint8_t instance, float* v);   // nullptr: periodic only
+};
+
+static void values508(uint8_t i, float* v) {
+  v[0] = haveLatest[i] ? latest[i].volts : NAN;
+  v[1] = haveLatest[i] ? latest[i].amps : NAN;
+  v[2] = haveLatest[i] ? latest[i].tempK : NAN;
+}
+
+// SoC as published (NAN until valid) and the load behind the
+// time remaining
+static void values506(uint8_t i, float* v) {
+  v[0] = state[i].socValid ? state[i].socPercent : NAN;
+  v[1] = state[i].loadA;
+  v[2] = NAN;
+}
+
+static const NmeaRule nmeaRules[] = {
+  { 127508L, NMEA_508_MIN_MS, NMEA_508_MAX_MS,
+    { NMEA_508_DELTA_V, NMEA_508_DELTA_A, NMEA_508_DELTA_K },
+    sendNmeaBatteryStatus, values508 },
+  { 127506L, NMEA_506_MIN_MS, NMEA_506_MAX_MS,
+    { NMEA_506_DELTA_SOC, NMEA_506_DELTA_A, INFINITY },
+    sendNmeaDcStatus, values506 },
+  { 127513L, NMEA_513_MS, NMEA_513_MS,
+    { INFINITY, INFINITY, INFINITY },
+    sendNmeaBatteryConfig, nullptr },
+};
+#define NMEA_RULES (sizeof(nmeaRules) / sizeof(nmeaRules[0]))
+#define NMEA_SLOTS (NMEA_RULES * NUM_BATTERIES)
+
+struct NmeaSlot {
+  uint32_t lastMs;                 // last sent (or phase start)
+  float    sent[NMEA_TRACKED];     // tracked values as last sent
+  bool     requested;              // ISO request pending
+};
+
+enum { TX_DEADLINE, TX_CHANGE, TX_REQUEST };
+
+static NmeaSlot slots[NMEA_SLOTS];   // slot k: rule k / NUM_BATTERIES, instance k % NUM_BATTERIES
+static NmeaTxStats txStats;
+
+// Alerts are not slots: they go ahead of the whole schedule
+static uint32_t alertLastMs[FAULT_TYPES][NUM_BATTERIES];
+static uint8_t  alertRequested[NUM_BATTERIES];   // bit per fault, ISO request pending
+
+// Start every slot phase-shifted: instance i of rule r is
+// first due at (i * rules + r) / slots of the rule's interval
+static void setupSchedule(uint32_t now) {
+  for (size_t k = 0; k < NMEA_SLOTS; k++) {
+    const NmeaRule& r = nmeaRules[k / NUM_BATTERIES];
+    size_t order = (k % NUM_BATTERIES) * NMEA_RULES + k / NUM_BATTERIES;
+    uint32_t phase = (uint32_t)((uint64_t)r.maxMs * order / NMEA_SLOTS);
+    slots[k].lastMs = now + phase - r.maxMs;
+    for (uint8_t f = 0; f < NMEA_TRACKED; f++) slots[k].sent[f] = NAN;
+    slots[k].requested = false;
+  }
+  for (uint8_t i = 0; i < NUM_BATTERIES; i++) {
+    alertRequested[i] = 0;
+    haveLatest[i] = false;
+    faultBits[i] = 0;
+    faultChanged[i] = 0;
+    for (uint8_t f = 0; f < FAULT_TYPES; f++) faultOccurrence[f][i] = 0;
+  }
+  txStats = NmeaTxStats();
+  rxStats = NmeaRxStats();
+}
+
+// A tracked value moved by its threshold since the last send
+// (NAN to a value or back counts as moved)
+static bool slotMoved(size_t k) {
+  const NmeaRule& r = nmeaRules[k / NUM_BATTERIES];
+  if (!r.values) return false;
+  float v[NMEA_TRACKED];
+  r.values(k % NUM_BATTERIES, v);
+  for (uint8_t f = 0; f < NMEA_TRACKED; f++) {
+    if (r.delta[f] == INFINITY || memcmp(&v[f], &slots[k].sent[f], sizeof(float)) == 0) continue;
+    if (!(fabsf(v[f] - slots[k].sent[f]) < r.delta[f])) return true;
+  }
+  return false;
+}
+
+static void sendSlot(size_t k, uint32_t now, uint8_t why) {
+  const NmeaRule& r = nmeaRules[k / NUM_BATTERIES];
+  uint8_t instance = k % NUM_BATTERIES;
+  uint32_t since = now - slots[k].lastMs;
+  r.send(instance);
+  if (r.values) r.values(instance, slots[k].sent);
+  slots[k].lastMs = now;
+  slots[k].requested = false;
+
+  txStats.frames++;
+  if (why == TX_REQUEST) {
+    txStats.onRequest++;
+  } else if (why == TX_CHANGE) {
+    txStats.onChange++;
+  } else {
+    txStats.onDeadline++;
+    if (since - r.maxMs > txStats.maxLateMs) txStats.maxLateMs = since - r.maxMs;
+  }
+}
+
+// One alert if any is due: a raised or cleared fault first
+// (oldest detection first), then a requested one, then an
+// active one every NMEA_ALERT_MS
+static bool sendDueAlert(uint32_t now) {
+  uint8_t bestI = 0, bestF = FAULT_TYPES;
+  uint32_t bestAge = 0;
+  for (uint8_t i = 0; i < NUM_BATTERIES; i++) {
+    for (uint8_t f = 0; f < FAULT_TYPES; f++) {
+      if (!(faultChanged[i] & (1u << f))) continue;
+      uint32_t age = now - faultChangedMs[f][i];
+      if (bestF == FAULT_TYPES || age > bestAge) {
+        bestI = i;
+        bestF = f;
+        bestAge = age;
+      }
+    }
+  }
+  uint8_t why = TX_CHANGE;
+  for (uint8_t pass = 0; bestF == FAULT_TYPES && pass < 2; pass++) {
+    for (uint8_t i = 0; bestF == FAULT_TYPES && i < NUM_BATTERIES; i++) {
+      for (uint8_t f = 0; bestF == FAULT_TYPES && f < FAULT_TYPES; f++) {
+        bool due = pass == 0 ? (alertRequested[i] & (1u << f)) != 0
+                             : (faultBits[i] & (1u << f)) && now - alertLastMs[f][i] >= NMEA_ALERT_MS;
+        if (!due) continue;
+        bestI = i;
+        bestF = f;
+        why = pass == 0 ? TX_REQUEST : TX_DEADLINE;
+      }
+    }
+  }
+  if (bestF == FAULT_TYPES) return false;
+
+  if ((faultChanged[bestI] & (1u << bestF)) && bestAge > txStats.alertMaxMs) txStats.alertMaxMs = bestAge;
+  faultChanged[bestI] &= (uint8_t)~(1u << bestF);
+  alertRequested[bestI] &= (uint8_t)~(1u << bestF);
+  sendNmeaAlert(bestI, bestF);
+  alertLastMs[bestF][bestI] = now;
+
+  txStats.frames++;
+  txStats.alerts++;
+  if (why == TX_REQUEST) txStats.onRequest++;
+  else if (why == TX_CHANGE) txStats.onChange++;
+  else txStats.onDeadline++;
+  return true;
+}
+
+// ===========================================================
+// ISO Request (PGN 59904)
+// ===========================================================
+// Address claim, product and configuration information and
+// the PGN lists are answered by the library. A request for
+// one of the battery PGNs marks the slots of every instance;
+// they go ahead of everything else, starting with the same
+// nmea stage run (NMEA_FRAMES_PER_POLL per run), and restart
+// those slots' timers. They are PDU2 (broadcast) PGNs, so the
+// answer goes to everyone, not just the requester. A request
+// for 126983 resends the active alerts. Unknown PGNs, and
+// 126983 while no alert is active, return false and the
+// library sends the NAK.
+static bool onIsoRequest(unsigned long pgn, unsigned char requester, int deviceIndex) {
+  (void)requester;
+  (void)deviceIndex;
+  bool known = false;
+  for (size_t k = 0; k < NMEA_SLOTS; k++) {
+    if (nmeaRules[k / NUM_BATTERIES].pgn != pgn) continue;
+    slots[k].requested = true;
+    known = true;
+  }
+  if (pgn == 126983L) {   // active alerts, again
+    for (uint8_t i = 0; i < NUM_BATTERIES; i++) {
+      alertRequested[i] |= faultBits[i];
+      known = known || faultBits[i] != 0;
+    }
+  }
+  if (known) txStats.requests++;
+  return known;
+}
+
+// Make the slots of a PGN due now (bypasses the minimum interval)
+static void slotsDue(uint32_t pgn, uint32_t now) {
+  for (size_t k = 0; k < NMEA_SLOTS; k++) {
+    const NmeaRule& r = nmeaRules[k / NUM_BATTERIES];
+    if (r.pgn == pgn) slots[k].lastMs = now - r.maxMs;
+  }
+}
+
+const NmeaTxStats& nmeaTxStats() { return txStats; }
+
+NmeaRxStats nmeaRxStats() {
+  HalCanStats can = halCanStats();
+  NmeaRxStats s = rxStats;
+  s.frames = can.received;
+  s.dropped = can.dropped;
+  return s;
+}
+
+// A snapshot with a new time is a new measurement: new SID
+static void readSnapshots() {
+  for (uint8_t i = 0; i < NUM_BATTERIES; i++) {
+    uint32_t lastMs = state[i].ms;
+    if (!bankSnapshots[i].read(state[i])) {
+      txStats.snapshotMisses++;
+      continue;
+    }
+    if (state[i].ms != lastMs) bankSid[i] = nextSid();
+  }
+}
+
+// ===========================================================
+// Dispatcher (nmea stage)
+// ===========================================================
+void nmeaLoop() {
+  uint32_t now = halMillis();
+
+  // Readings first: the frames below go out with them
+  drainSamples();
+  readSnapshots();
+
+  // Received frames first (ISO requests), so their answers go
+  // out in this run
+  uint32_t parseStart = halMicros();
+  NMEA2000.ParseMessages();
+  uint32_t parseUs = halMicros() - parseStart;
+  rxStats.parses++;
+  rxStats.parseSumUs += parseUs;
+  if (parseUs > rxStats.parseMaxUs) rxStats.parseMaxUs = parseUs;
+
+  // DC Status right away once every bank's SoC is valid after boot
+  bool allValid = true;
+  for (uint8_t i = 0; i < NUM_BATTERIES; i++) allValid = allValid && state[i].socValid;
+  if (!socAnnounced && allValid) {
+    slotsDue(127506L, now);
+    socAnnounced = true;
+  }
+
+  for (uint8_t n = 0; n < NMEA_FRAMES_PER_POLL; n++) {
+    if (sendDueAlert(now)) continue;
+
+    // Most overdue slot: deadlines by how far past their
+    // interval they are, changes by how far past the minimum
+    // (requests first)
+    size_t best = NMEA_SLOTS;
+    float bestLate = 0.0f;
+    uint8_t bestWhy = TX_DEADLINE;
+    for (size_t k = 0; k < NMEA_SLOTS; k++) {
+      const NmeaRule& r = nmeaRules[k / NUM_BATTERIES];
+      uint32_t since = now - slots[k].lastMs;
+      uint8_t why = slots[k].requested ? TX_REQUEST
+                  : since >= r.maxMs ? TX_DEADLINE
+                  : since >= r.minMs && slotMoved(k) ? TX_CHANGE
+                  : 0xff;
+      if (why == 0xff) continue;
+      float late = why == TX_REQUEST ? INFINITY : (float)since / (why == TX_DEADLINE ? r.maxMs : r.minMs);
+      if (best == NMEA_SLOTS || late > bestLate) {
+        best = k;
+        bestLate = late;
+        bestWhy = why;
+      }
+    }
+    if (best == NMEA_SLOTS) break;
+    sendSlot(best, now, bestWhy);
+  }
+}
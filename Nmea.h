@@ -0,0 +1,76 @@
+#ifndef NMEA_H
+#define NMEA_H
+
+#include <Arduino.h>
+#include "Hal.h"
+
+// ===========================================================
+// Nmea.h — NMEA2000 interface for Battery Monitor
+// ===========================================================
+//
+// Provides:
+//   - Setup for N2K CAN interface
+//   - Functions to send PGNs 127508, 127506, 127513
+//   - Table-driven transmit schedule: per PGN minimum and
+//     maximum interval and change thresholds, per instance
+//     phase-shifted timers, a frame budget per poll
+//   - PGN 126983 alerts for the bank faults (Faults.h), sent
+//     ahead of the schedule when a fault is raised or cleared
+//   - Answers to ISO requests (PGN 59904) for the battery PGNs;
+//     PGN 127513 is built once at setup and sent from cache
+//   - Receive accounting: frames read, frames lost before the
+//     library, time spent in ParseMessages()
+//   - Bank readings and fault bits taken from the sample ring
+//     (Sensors.h), filled by the sensors stage on the other
+//     core
+//   - Shared NMEA2000 bus instance (owned by the HAL)
+// ===========================================================
+
+// Initialize the NMEA2000 interface
+void setupNmea();
+
+// Send PGN 127508 Battery Status for a given battery instance
+void sendNmeaBatteryStatus(uint8_t instance);
+
+// Send PGN 127506 DC Detailed Status for a given battery instance
+void sendNmeaDcStatus(uint8_t instance);
+
+// Send PGN 127513 Battery Configuration for a given battery instance
+void sendNmeaBatteryConfig(uint8_t instance);
+
+// Send PGN 126983 Alert for a bank's fault (FaultType), in its
+// current state
+void sendNmeaAlert(uint8_t instance, uint8_t fault);
+
+// Transmit statistics since setupNmea()
+struct NmeaTxStats {
+  uint32_t frames;
+  uint32_t onChange;     // sent early: a tracked value moved
+  uint32_t onDeadline;   // sent at the maximum interval
+  uint32_t onRequest;    // sent to answer an ISO request
+  uint32_t requests;     // ISO requests for our PGNs
+  uint32_t maxLateMs;    // worst delay past a maximum interval
+  uint32_t alerts;       // PGN 126983 frames (also counted above)
+  uint32_t alertMaxMs;   // worst fault detection to alert delay
+  uint32_t snapshotMisses;   // bank snapshot reads that kept the previous copy
+};
+
+// Dispatcher: sends the slots that are due, at most
+// NMEA_FRAMES_PER_POLL per call (nmea stage)
+void nmeaLoop();
+
+const NmeaTxStats& nmeaTxStats();
+
+// Receive statistics since setupNmea(); frames are counted
+// after the CAN acceptance filter (Hal.h)
+struct NmeaRxStats {
+  uint32_t frames;       // read by the library
+  uint32_t dropped;      // lost: receive queue full, controller overrun
+  uint32_t parses;       // ParseMessages() calls
+  uint32_t parseMaxUs;   // longest ParseMessages()
+  uint64_t parseSumUs;
+};
+
+NmeaRxStats nmeaRxStats();
+
+#endif // NMEA_H
@@ -0,0 +1,165 @@
+#ifndef OCV_H
+#define OCV_H
+
+#include <Arduino.h>
+#include <math.h>
+#include "Config.h"
+
+// ===========================================================
+// Ocv.h — Open-circuit voltage → SoC lookup
+// ===========================================================
+//
+// Provides:
+//   - OCV tables per chemistry: SoC breakpoints at 25 C for a
+//     12V battery (OCV_*_12V)
+//   - ocvScanSoc(): linear scan with interpolation over such a
+//     table (the reference; constexpr, so usable at compile
+//     time)
+//   - OcvGrid: dense SoC table over temperature-compensated
+//     terminal voltage (uniform steps), generated at compile
+//     time from a chemistry table, the nominal voltage and
+//     the OCV temperature coefficient (V/C at the terminals):
+//       SoC(v, T) = scan((v - coef * (T - 25)) * 12 / nominalV)
+//     The 24V/48V scaling is folded into the voltage axis, and
+//     the linear coefficient into the column coordinate, so
+//     one row serves every temperature. The tables hold one
+//     25 C curve per chemistry; there is no per-temperature
+//     data for a second axis.
+//   - ocvGridSoc(): direct index into the grid plus one
+//     linear interpolation, O(1)
+//   - ocvVoltage(): the inverse, OCV and its slope at a SoC
+//     (for the model-based estimator, Ekf.h)
+//
+// Grid error against the scan is largest next to a table
+// breakpoint; bmocv reports it. Voltages outside the grid are
+// clamped to its first or last column.
+//
+// Written for C++11 constexpr (single-expression functions) so
+// it builds with every ESP32 Arduino core.
+// ===========================================================
+
+struct SocPoint { float soc; float v; };
+
+// ==========================
+// OCV Tables (12V Reference, 25 C)
+// ==========================
+
+static constexpr SocPoint OCV_FLA_12V[] = {
+  {10, 11.51},{20, 11.66},{30, 11.81},{40, 11.96},{50, 12.10},
+  {60, 12.24},{70, 12.37},{80, 12.50},{90, 12.62},{100, 12.73}
+};
+static constexpr SocPoint OCV_AGM_12V[] = {
+  {10, 11.60},{20, 11.78},{30, 11.95},{40, 12.10},{50, 12.20},
+  {60, 12.32},{70, 12.45},{80, 12.60},{90, 12.75},{100, 12.85}
+};
+static constexpr SocPoint OCV_GEL_12V[] = {
+  {10, 11.60},{20, 11.80},{30, 11.96},{40, 12.12},{50, 12.24},
+  {60, 12.36},{70, 12.48},{80, 12.62},{90, 12.78},{100, 12.90}
+};
+static constexpr SocPoint OCV_LFP_12V[] = {
+  {0, 12.00},{10, 12.90},{20, 13.00},{30, 13.10},{40, 13.15},
+  {50, 13.20},{60, 13.25},{70, 13.30},{80, 13.35},{90, 13.45},{100, 13.60}
+};
+
+typedef struct { const SocPoint* pts; size_t len; } OcvTableView;
+
+#define OCV_TABLE_VIEW(t) OcvTableView{ t, sizeof(t) / sizeof(t[0]) }
+
+// Unknown chemistries use the flooded table
+constexpr OcvTableView ocvTableForChem(int chem) {
+  return chem == CHEM_AGM ? OCV_TABLE_VIEW(OCV_AGM_12V)
+       : chem == CHEM_GEL ? OCV_TABLE_VIEW(OCV_GEL_12V)
+       : chem == CHEM_LFP ? OCV_TABLE_VIEW(OCV_LFP_12V)
+       :                    OCV_TABLE_VIEW(OCV_FLA_12V);
+}
+
+// SoC at 12V-reference voltage v12, clamped to the table ends
+constexpr float ocvScanSoc(const OcvTableView& tv, float v12, size_t k = 1) {
+  return v12 <= tv.pts[0].v ? tv.pts[0].soc
+       : k >= tv.len        ? tv.pts[tv.len - 1].soc
+       : v12 <= tv.pts[k].v ? tv.pts[k - 1].soc + (v12 - tv.pts[k - 1].v) *
+                              (tv.pts[k].soc - tv.pts[k - 1].soc) / (tv.pts[k].v - tv.pts[k - 1].v)
+       :                      ocvScanSoc(tv, v12, k + 1);
+}
+
+// 12V-reference OCV at SoC (%) and the slope there (V per %);
+// outside the table the end voltage with zero slope
+inline float ocvVoltage(const OcvTableView& tv, float soc, float& slope) {
+  slope = 0.0f;
+  if (soc <= tv.pts[0].soc) return tv.pts[0].v;
+  for (size_t i = 1; i < tv.len; i++) {
+    if (soc <= tv.pts[i].soc) {
+      slope = (tv.pts[i].v - tv.pts[i-1].v) / (tv.pts[i].soc - tv.pts[i-1].soc);
+      return tv.pts[i-1].v + (soc - tv.pts[i-1].soc) * slope;
+    }
+  }
+  return tv.pts[tv.len-1].v;
+}
+
+// ==========================
+// Dense grid
+// ==========================
+
+#define OCV_GRID_V        128      // voltage points
+
+struct OcvGrid {
+  float coef;                             // V/C at the terminals
+  float vMin;                             // compensated terminal volts at column 0
+  float vStep;
+  float stepsPerV;                        // 1 / vStep
+  float soc[OCV_GRID_V];
+};
+
+// Compile-time index list 0..N-1 (std::index_sequence is
+// C++14), built in halves to keep the template depth at log N
+template <size_t... K> struct OcvIndices {};
+template <class A, class B> struct OcvConcat;
+template <size_t... I, size_t... J> struct OcvConcat<OcvIndices<I...>, OcvIndices<J...> > {
+  typedef OcvIndices<I..., (sizeof...(I) + J)...> type;
+};
+template <size_t N> struct OcvMakeIndices {
+  typedef typename OcvConcat<typename OcvMakeIndices<N / 2>::type,
+                             typename OcvMakeIndices<N - N / 2>::type>::type type;
+};
+template <> struct OcvMakeIndices<0> { typedef OcvIndices<> type; };
+template <> struct OcvMakeIndices<1> { typedef OcvIndices<0> type; };
+
+// Cell k: SoC at the terminal voltage whose compensated
+// value is column k
+constexpr float ocvGridCell(const OcvTableView& tv, float scale, float vMin, float vStep, size_t k) {
+  return ocvScanSoc(tv, (vMin + k * vStep) / scale);
+}
+
+template <size_t... K>
+constexpr OcvGrid ocvGridBuild(const OcvTableView& tv, float scale, float coef,
+                               float vMin, float vStep, OcvIndices<K...>) {
+  return OcvGrid{ coef, vMin, vStep, 1.0f / vStep, { ocvGridCell(tv, scale, vMin, vStep, K)... } };
+}
+
+// Grid for a chemistry (CHEM_*), nominal voltage (12/24/48)
+// and OCV temperature coefficient (V/C); the voltage axis
+// spans the table scaled to the nominal voltage
+constexpr OcvGrid makeOcvGrid(int chem, int nominalV, float coef) {
+  return ocvGridBuild(ocvTableForChem(chem), nominalV / 12.0f, coef,
+                      nominalV / 12.0f * ocvTableForChem(chem).pts[0].v,
+                      nominalV / 12.0f * (ocvTableForChem(chem).pts[ocvTableForChem(chem).len - 1].v -
+                                          ocvTableForChem(chem).pts[0].v) / (OCV_GRID_V - 1),
+                      typename OcvMakeIndices<OCV_GRID_V>::type());
+}
+
+// Grid of bank n from its BATTn_* defines
+#define OCV_GRID(n) makeOcvGrid(BATT##n##_CHEMISTRY, BATT##n##_NOMINAL_V, BATT##n##_TEMP_COEF)
+
+// SoC at terminal voltage v and temperature tC: the column
+// comes from the compensated voltage, then one linear
+// interpolation
+inline float ocvGridSoc(const OcvGrid& g, float v, float tC) {
+  float x = (v - g.coef * (tC - 25.0f) - g.vMin) * g.stepsPerV;
+  x = x < 0.0f ? 0.0f : x > OCV_GRID_V - 1 ? OCV_GRID_V - 1 : x;
+  int j = (int)x;
+  if (j > OCV_GRID_V - 2) j = OCV_GRID_V - 2;
+  const float* c = &g.soc[j];
+  return c[0] + (x - j) * (c[1] - c[0]);
+}
+
+#endif // OCV_H
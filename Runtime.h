@@ -0,0 +1,109 @@
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+#include <Arduino.h>
+#include <math.h>
+#include "Config.h"
+
+// ===========================================================
+// Runtime.h — Time-to-empty / time-to-full prediction
+// ===========================================================
+//
+// LoadHorizons<N> keeps, per bank, exponentially weighted
+// means of the effective current (Peukert and charge
+// efficiency applied, i.e. what the counter subtracts) over
+// three horizons: RUNTIME_SHORT_S, RUNTIME_MID_S and
+// RUNTIME_LONG_S (1 min, 15 min, 1 h by default).
+//
+// Each horizon holds a weighted sum and its total weight;
+// every conversion decays both by tau / (tau + dt) and adds
+// the sample. The mean is sum / weight, so a horizon that was
+// just cleared is the exact weighted mean of the samples since
+// (no seed value, no ramp from zero). Cost per sample is
+// constant: a few multiplies per horizon, no expf.
+//
+// Load changes:
+//   - the 1 min mean leaving the 15 min mean by more than
+//     RUNTIME_STEP_PCT (engine start, inverter on, charger
+//     off) clears the 15 min and 1 h horizons
+//   - the 15 min mean leaving the 1 h mean by more than
+//     RUNTIME_DRIFT_PCT (evening lights) clears the 1 h one
+// Differences below the bank's rest current threshold never
+// count, so noise around idle does not clear anything.
+//
+// The load used is the 1 h mean once it holds RUNTIME_MID_S of
+// samples, else the 15 min mean once it holds RUNTIME_SHORT_S,
+// else the 1 min mean. A cycling load (fridge, pumps) is then
+// averaged over the hour, and after a step the prediction
+// follows the new load within about a minute.
+//
+// Time to empty is remaining Ah / load while discharging, time
+// to full (capacity - remaining Ah) / load while charging
+// (bulk rate: the absorption taper makes it optimistic near
+// full). predictBanks() in Battery.h applies it per bank.
+// ===========================================================
+
+#define RUNTIME_HORIZONS 3
+
+template <size_t N>
+struct LoadHorizons {
+  float sum[RUNTIME_HORIZONS][N];
+  float weight[RUNTIME_HORIZONS][N];
+  float spanS[RUNTIME_HORIZONS][N];   // seconds of samples since clear (saturating)
+
+  static float tauS(size_t h) {
+    return h == 0 ? RUNTIME_SHORT_S : h == 1 ? RUNTIME_MID_S : RUNTIME_LONG_S;
+  }
+
+  void begin() { for (size_t i = 0; i < N; i++) clear(i, 0); }
+
+  // Forget horizons from..RUNTIME_HORIZONS-1 of bank i
+  void clear(size_t i, size_t from) {
+    for (size_t h = from; h < RUNTIME_HORIZONS; h++) {
+      sum[h][i] = 0.0f;
+      weight[h][i] = 0.0f;
+      spanS[h][i] = 0.0f;
+    }
+  }
+
+  // Mean of horizon h, NAN before the first sample
+  float mean(size_t h, size_t i) const {
+    return weight[h][i] > 0.0f ? sum[h][i] / weight[h][i] : NAN;
+  }
+
+  // One sample of `amps` covering dtS seconds; floorA is the
+  // smallest difference that counts as a load change
+  void add(size_t i, float amps, float dtS, float floorA) {
+    for (size_t h = 0; h < RUNTIME_HORIZONS; h++) {
+      float tau = tauS(h);
+      float keep = tau / (tau + dtS);
+      sum[h][i] = sum[h][i] * keep + amps * dtS;
+      weight[h][i] = weight[h][i] * keep + dtS;
+      if (spanS[h][i] < tau) spanS[h][i] += dtS;
+    }
+    if (changed(mean(0, i), mean(1, i), RUNTIME_STEP_PCT, floorA)) {
+      clear(i, 1);
+    } else if (spanS[1][i] >= RUNTIME_SHORT_S &&
+               changed(mean(1, i), mean(2, i), RUNTIME_DRIFT_PCT, floorA)) {
+      clear(i, 2);
+    }
+  }
+
+  // Horizon a prediction uses (0 = short)
+  size_t horizon(size_t i) const {
+    if (spanS[2][i] >= RUNTIME_MID_S) return 2;
+    if (spanS[1][i] >= RUNTIME_SHORT_S) return 1;
+    return 0;
+  }
+
+  float load(size_t i) const { return mean(horizon(i), i); }
+
+  // a and b differ by more than pct % of the smaller one plus
+  // floorA (symmetric, and any sign change above the floor)
+  static bool changed(float a, float b, float pct, float floorA) {
+    if (isnan(a) || isnan(b)) return false;
+    return fabsf(a - b) > (pct / 100.0f) * fminf(fabsf(a), fabsf(b)) + floorA;
+  }
+};
+
+#endif // RUNTIME_H
@@ -0,0 +1,183 @@
+#include "Scheduler.h"
+#include "Config.h"
+#include "Hal.h"
+#include "Seqlock.h"
+
+// ==========================
+// Stage table
+// ==========================
+
+static SchedStage stages[SCHED_MAX_STAGES];
+static uint8_t stageCount = 0;
+static uint32_t lastPassUs[SCHED_CORES];
+static uint64_t elapsedUs[SCHED_CORES];   // wrap-safe time since schedulerBegin(), per core
+
+// A core's statistics as the other core sees them: the task
+// running the core copies them after each pass that ran a
+// stage, so the load and the debug print (on the publishing
+// core) never read the 64-bit sums while they are updated
+struct StageStats {
+  uint32_t runs, overruns, maxJitterUs, maxExecUs;
+  uint64_t sumJitterUs, sumExecUs;
+};
+struct CoreStats {
+  uint64_t elapsedUs;
+  StageStats stage[SCHED_MAX_STAGES];   // only the stages of this core are filled in
+};
+static Seqlock<CoreStats> coreStats[SCHED_CORES];
+
+// The table is filled before the tasks start and only read
+// afterwards; each stage's deadline and statistics belong to
+// the task running its core.
+bool schedulerAdd(const char* name, void (*fn)(), uint32_t hz, uint8_t core) {
+  if (stageCount >= SCHED_MAX_STAGES || hz == 0 || core >= SCHED_CORES) return false;
+  SchedStage& s = stages[stageCount++];
+  s = SchedStage();
+  s.name = name;
+  s.fn = fn;
+  s.periodUs = 1000000UL / hz;
+  s.core = core;
+  return true;
+}
+
+void schedulerBegin() {
+  uint32_t now = halMicros();
+  for (uint8_t c = 0; c < SCHED_CORES; c++) {
+    lastPassUs[c] = now;
+    elapsedUs[c] = 0;
+  }
+  for (uint8_t i = 0; i < stageCount; i++) stages[i].nextDueUs = now;
+  for (uint8_t c = 0; c < SCHED_CORES; c++) coreStats[c].write(CoreStats());
+}
+
+static bool runsOn(const SchedStage& s, uint8_t core) {
+  return core == SCHED_ALL_CORES || s.core == core;
+}
+
+static void publishStats(uint8_t c) {
+  CoreStats cs = CoreStats();
+  cs.elapsedUs = elapsedUs[c];
+  for (uint8_t i = 0; i < stageCount; i++) {
+    const SchedStage& s = stages[i];
+    if (s.core != c) continue;
+    StageStats& t = cs.stage[i];
+    t.runs        = s.runs;
+    t.overruns    = s.overruns;
+    t.maxJitterUs = s.maxJitterUs;
+    t.maxExecUs   = s.maxExecUs;
+    t.sumJitterUs = s.sumJitterUs;
+    t.sumExecUs   = s.sumExecUs;
+  }
+  coreStats[c].write(cs);
+}
+
+// ==========================
+// Dispatch
+// ==========================
+
+void schedulerRun(uint8_t core) {
+  uint32_t passUs = halMicros();
+  for (uint8_t c = 0; c < SCHED_CORES; c++) {
+    if (core != SCHED_ALL_CORES && c != core) continue;
+    elapsedUs[c] += passUs - lastPassUs[c];
+    lastPassUs[c] = passUs;
+  }
+
+  bool ran[SCHED_CORES] = {};
+  for (uint8_t i = 0; i < stageCount; i++) {
+    SchedStage& s = stages[i];
+    if (!runsOn(s, core)) continue;
+    uint32_t start = halMicros();
+    int32_t late = (int32_t)(start - s.nextDueUs);
+    if (late < 0) continue;
+    ran[s.core] = true;
+
+    s.fn();
+    uint32_t exec = halMicros() - start;
+
+    s.runs++;
+    s.sumJitterUs += (uint32_t)late;
+    if ((uint32_t)late > s.maxJitterUs) s.maxJitterUs = late;
+    s.sumExecUs += exec;
+    if (exec > s.maxExecUs) s.maxExecUs = exec;
+
+    // Advance on the fixed grid; drop slots we can no longer meet
+    s.nextDueUs += s.periodUs;
+    if ((int32_t)(halMicros() - s.nextDueUs) >= 0) {
+      uint32_t missed = (halMicros() - s.nextDueUs) / s.periodUs + 1;
+      s.overruns++;
+      s.skipped += missed;
+      s.nextDueUs += missed * s.periodUs;
+    }
+  }
+
+  for (uint8_t c = 0; c < SCHED_CORES; c++) {
+    if (ran[c]) publishStats(c);
+  }
+
+  // Sleep until the earliest deadline
+  uint32_t now = halMicros();
+  bool any = false;
+  int32_t wait = 0;
+  for (uint8_t i = 0; i < stageCount; i++) {
+    if (!runsOn(stages[i], core)) continue;
+    int32_t w = (int32_t)(stages[i].nextDueUs - now);
+    if (!any || w < wait) wait = w;
+    any = true;
+  }
+  if (any && wait > 0) halIdleUntil(now + wait);
+}
+
+// ==========================
+// Statistics
+// ==========================
+
+uint8_t schedulerStageCount() { return stageCount; }
+const SchedStage& schedulerStage(uint8_t i) { return stages[i]; }
+
+static float loadPercent(const CoreStats& cs) {
+  if (cs.elapsedUs == 0) return 0.0f;
+  uint64_t busy = 0;
+  for (uint8_t i = 0; i < stageCount; i++) busy += cs.stage[i].sumExecUs;
+  return 100.0f * (float)busy / (float)cs.elapsedUs;
+}
+
+float schedulerCpuLoadPercent(uint8_t core) {
+  if (core == SCHED_ALL_CORES) {
+    float sum = 0.0f;
+    for (uint8_t c = 0; c < SCHED_CORES; c++) sum += schedulerCpuLoadPercent(c);
+    return sum;
+  }
+  CoreStats cs;
+  if (core >= SCHED_CORES || !coreStats[core].read(cs)) return 0.0f;
+  return loadPercent(cs);
+}
+
+void schedulerDebugPrint() {
+#ifdef DEBUG_OUTPUT
+  // One copy per core, not the live counters of the other core
+  CoreStats cs[SCHED_CORES];
+  bool have[SCHED_CORES];
+  for (uint8_t c = 0; c < SCHED_CORES; c++) have[c] = coreStats[c].read(cs[c]);
+
+  for (uint8_t i = 0; i < stageCount; i++) {
+    const SchedStage& s = stages[i];
+    Serial.print("Sched "); Serial.print(s.name); Serial.print(" (core "); Serial.print(s.core); Serial.print(")");
+    if (!have[s.core]) {
+      Serial.println(": statistics busy");
+      continue;
+    }
+    const StageStats& t = cs[s.core].stage[i];
+    Serial.print(": runs "); Serial.print((unsigned long)t.runs);
+    Serial.print(", jitter avg/max "); Serial.print(t.runs ? (unsigned long)(t.sumJitterUs / t.runs) : 0UL);
+    Serial.print("/"); Serial.print((unsigned long)t.maxJitterUs);
+    Serial.print(" us, exec max "); Serial.print((unsigned long)t.maxExecUs);
+    Serial.print(" us, overruns "); Serial.println((unsigned long)t.overruns);
+  }
+  for (uint8_t c = 0; c < SCHED_CORES; c++) {
+    if (!have[c]) continue;
+    Serial.print("CPU load core "); Serial.print(c); Serial.print(": ");
+    Serial.print(loadPercent(cs[c])); Serial.println(" %");
+  }
+#endif
+}
@@ -0,0 +1,68 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+
+// ===========================================================
+// Scheduler.h — Fixed-rate stage scheduler
+// ===========================================================
+//
+// Provides:
+//   - A small table of stages, each run at its own rate
+//   - Monotonic deadlines (next = due + period, so no drift)
+//   - Idling until the next deadline instead of spinning
+//   - Per-stage jitter, overrun and execution-time statistics,
+//     published per core under a seqlock for the other core
+//   - Stages bound to a core: each core's task runs its own
+//     stages (schedulerRun(core)); one loop can run them all
+//
+// Stages due at the same instant run in registration order,
+// so sensors → SoC → NMEA keeps its data dependency.
+// ===========================================================
+
+#define SCHED_MAX_STAGES 8
+#define SCHED_CORES      2
+#define SCHED_ALL_CORES  0xff   // schedulerRun(): every stage, one loop
+
+struct SchedStage {
+  const char* name;
+  void (*fn)();
+  uint32_t periodUs;
+  uint32_t nextDueUs;
+  uint8_t  core;           // 0 .. SCHED_CORES-1
+
+  // Statistics since schedulerBegin()
+  uint32_t runs;
+  uint32_t overruns;       // started after the following slot was due
+  uint32_t skipped;        // slots dropped to catch up
+  uint32_t maxJitterUs;    // worst start delay after the deadline
+  uint64_t sumJitterUs;
+  uint32_t maxExecUs;
+  uint64_t sumExecUs;
+};
+
+// Register a stage running at `hz` on `core` (call before
+// schedulerBegin)
+bool schedulerAdd(const char* name, void (*fn)(), uint32_t hz, uint8_t core = 0);
+
+// Arm all stages; the first run of every stage is due now
+void schedulerBegin();
+
+// Run the due stages of `core` (SCHED_ALL_CORES: of every
+// core), then idle until the next of their deadlines. Each
+// core is run from one task only.
+void schedulerRun(uint8_t core = SCHED_ALL_CORES);
+
+// Statistics access. schedulerStage() is live: read it from
+// the task running the stage's core (or from the one loop).
+uint8_t schedulerStageCount();
+const SchedStage& schedulerStage(uint8_t i);
+// Execution time / elapsed time of a core's stages
+// (SCHED_ALL_CORES: summed over the cores), from the copy
+// published after the core's last pass; safe from any core
+float schedulerCpuLoadPercent(uint8_t core = SCHED_ALL_CORES);
+
+// Print per-stage statistics (only active if DEBUG_OUTPUT defined)
+void schedulerDebugPrint();
+
+#endif // SCHEDULER_H
@@ -1,9 +1,48 @@
 #include "Globals.h"
 #include "Config.h"
-#include <EEPROM.h>
+#include "Hal.h"
+#include "Sensors.h"
+#include "TempBus.h"
+#include "I2cBus.h"
+#include "Ina226.h"
+#include "Nmea.h"
+#include "Seqlock.h"
+#include <atomic>
 
-// Forward declarations
-float applyCalibration(float raw, float rawLow, float calLow, float rawHigh, float calHigh);
+SpscRing<BankSample, SAMPLE_RING_LEN> sampleRing;
+
+static TempBus tempBus;
+static uint32_t tempReads[NUM_BATTERIES];   // readings taken so far, per sensor
+
+// Last INA226 conversion per bank and its period, for
+// sensorSlackUs() on either core. Written by readSensors()
+// only: the time first, then the period with release; a
+// period of 0 means no conversion yet.
+static std::atomic<uint32_t> lastConversionUs[NUM_BATTERIES];
+static std::atomic<uint32_t> conversionPeriodUs[NUM_BATTERIES];
+
+#ifdef DEBUG_OUTPUT
+// I²C and DS18B20 driver counters for the debug output on the
+// other core (the latency sum is 64-bit: a plain read could
+// tear). Copied by readSensors() after each pass, so they are
+// at most one sensor pass old.
+struct SensorCounters {
+  I2cDeviceStats i2c[NUM_BATTERIES];
+  I2cBusStats    bus;
+  TempSensor     temp[NUM_BATTERIES];
+};
+static Seqlock<SensorCounters> sensorCounters;
+
+static void publishCounters() {
+  SensorCounters c;
+  for (uint8_t i = 0; i < NUM_BATTERIES; i++) {
+    c.i2c[i] = i2cDeviceStats(i);
+    c.temp[i] = tempBus.sensor(i);
+  }
+  c.bus = i2cBusStats();
+  sensorCounters.write(c);
+}
+#endif
 
 // =======================
 // Setup sensors
@@ -14,188 +53,236 @@ void setupSensors() {
   Serial.println("Debug output enabled");
 #endif
 
-  Wire.begin(I2C_SDA, I2C_SCL);
+  initBanks(banks, bankConfig);
+
+  i2cBegin(I2C_SDA, I2C_SCL);
 
-  if (!ina1.begin()) {
+  for (uint8_t i = 0; i < NUM_BATTERIES; i++) {
+    const BankConfig& c = bankConfig[i];
+    if (!inaBegin(i, c.inaAddr)) {
 #ifdef DEBUG_OUTPUT
-    Serial.println("INA226 #1 not connected!");
+      Serial.print("INA226 #"); Serial.print(i + 1); Serial.println(" not connected!");
 #endif
-  }
-  if (!ina2.begin()) {
+    }
+
+    int err = inaCalibrate(i, c.shuntMaxA, c.shuntOhms);
 #ifdef DEBUG_OUTPUT
-    Serial.println("INA226 #2 not connected!");
+    if (err != 0) {
+      Serial.print("INA226 #"); Serial.print(i + 1); Serial.print(" calibration error: ");
+      Serial.println(err);
+    }
+#else
+    (void)err;
 #endif
-  }
 
-  int err1 = ina1.setMaxCurrentShunt(SHUNT1_MAX_AMPS, SHUNT1_OHMS);
-#ifdef DEBUG_OUTPUT
-  if (err1 != INA226_ERR_NONE) {
-    Serial.print("INA226 #1 calibration error: ");
-    Serial.println(err1);
+    // On-chip averaging; one ALERT per finished conversion
+    inaConfigure(i, INA226_AVERAGE_CODE, INA226_VBUS_CT_CODE, INA226_VSHUNT_CT_CODE);
+    inaEnableReady(i, c.alertPin);
   }
-#endif
 
-  int err2 = ina2.setMaxCurrentShunt(SHUNT2_MAX_AMPS, SHUNT2_OHMS);
+  // DS18B20: configured on the bus by the first temp stage runs
+  halOneWireBegin();
+#ifdef DS18B20_DISCOVER
+  uint8_t bits[NUM_BATTERIES];
+  for (uint8_t i = 0; i < NUM_BATTERIES; i++) bits[i] = bankConfig[i].tempResolution;
+  uint8_t found = tempBus.discover(bits);
 #ifdef DEBUG_OUTPUT
-  if (err2 != INA226_ERR_NONE) {
-    Serial.print("INA226 #2 calibration error: ");
-    Serial.println(err2);
+  Serial.print("DS18B20 found: "); Serial.println(found);
+  for (uint8_t i = 0; i < found; i++) {
+    Serial.print("  B"); Serial.print(i + 1); Serial.print(" {");
+    for (uint8_t k = 0; k < 8; k++) {
+      uint8_t b = tempBus.sensor(i).rom[k];
+      Serial.print(b < 0x10 ? " 0x0" : " 0x"); Serial.print(b, HEX); Serial.print(k < 7 ? "," : " }");
+    }
+    Serial.println();
   }
+#else
+  (void)found;
+#endif
+#else
+  for (uint8_t i = 0; i < NUM_BATTERIES; i++)
+    tempBus.setSensor(i, bankConfig[i].tempRom, bankConfig[i].tempResolution);
 #endif
-
-  sensors.begin();
-  sensors.setWaitForConversion(false);
-  sensors.requestTemperatures();
-  lastTempRequest = millis();
-
-  ra_batt1_voltage.clear();
-  ra_batt1_current.clear();
-  ra_batt1_temp_C.clear();
-  ra_batt2_voltage.clear();
-  ra_batt2_current.clear();
-  ra_batt2_temp_C.clear();
 }
 
 // =======================
 // Read sensors + update globals
 // =======================
 void readSensors() {
-  // ----- INA226 -----
-  raw_battery1_voltage = ina1.getBusVoltage();
-  raw_battery1_current = ina1.getCurrent();
-  raw_battery2_voltage = ina2.getBusVoltage();
-  raw_battery2_current = ina2.getCurrent();
-  raw_battery1_power   = raw_battery1_voltage * raw_battery1_current;
-  raw_battery2_power   = raw_battery2_voltage * raw_battery2_current;
-
-  // ----- DS18B20 non-blocking -----
-  unsigned long now = millis();
-  if (now - lastTempRequest >= tempConversionTime) {
-    raw_battery1_temp_C = sensors.getTempC(sensor1);
-    raw_battery2_temp_C = sensors.getTempC(sensor2);
-    raw_battery1_temp_K = raw_battery1_temp_C + 273.15f;
-    raw_battery2_temp_K = raw_battery2_temp_C + 273.15f;
-
-    sensors.requestTemperatures();
-    lastTempRequest = now;
-
-    if (raw_battery1_temp_C == DEVICE_DISCONNECTED_C) ra_batt1_temp_C.clear();
-    if (raw_battery2_temp_C == DEVICE_DISCONNECTED_C) ra_batt2_temp_C.clear();
+  // ----- INA226: read only when a new conversion exists -----
+  // A bus error skips the conversion; the next one integrates
+  // over the gap.
+  for (uint8_t i = 0; i < NUM_BATTERIES; i++) {
+    uint32_t sampleUs;
+    int16_t shunt;
+    uint16_t bus;
+    banks.fresh[i] = inaSampleReady(i, sampleUs) && inaRead(i, shunt, bus);
+    if (banks.fresh[i]) {
+      banks.sampleUs[i] = sampleUs;
+      lastConversionUs[i].store(sampleUs, std::memory_order_relaxed);
+      conversionPeriodUs[i].store(inaConversionUs(i), std::memory_order_release);
+#ifdef COULOMB_FIXED_POINT
+      banks.busRaw[i]   = bus;
+      banks.shuntRaw[i] = shunt;
+#else
+      banks.raw_voltage[i] = bus * (float)INA226_BUS_LSB_V;
+      banks.raw_current[i] = shunt * (float)(INA226_SHUNT_LSB_V / bankConfig[i].shuntOhms);
+#endif
+    }
   }
 
-  // ----- Calibration -----
-  calibrated_battery1_temp_C = raw_battery1_temp_C + BATT1_TEMP_OFFSET;
-  calibrated_battery2_temp_C = raw_battery2_temp_C + BATT2_TEMP_OFFSET;
-  calibrated_battery1_temp_K = calibrated_battery1_temp_C + 273.15f;
-  calibrated_battery2_temp_K = calibrated_battery2_temp_C + 273.15f;
-
-  calibrated_battery1_voltage = applyCalibration(raw_battery1_voltage, BATT1_V_RAW_LOW, BATT1_V_CAL_LOW, BATT1_V_RAW_HIGH, BATT1_V_CAL_HIGH);
-  calibrated_battery1_current = applyCalibration(raw_battery1_current, BATT1_I_RAW_LOW, BATT1_I_CAL_LOW, BATT1_I_RAW_HIGH, BATT1_I_CAL_HIGH);
-  calibrated_battery2_voltage = applyCalibration(raw_battery2_voltage, BATT2_V_RAW_LOW, BATT2_V_CAL_LOW, BATT2_V_RAW_HIGH, BATT2_V_CAL_HIGH);
-  calibrated_battery2_current = applyCalibration(raw_battery2_current, BATT2_I_RAW_LOW, BATT2_I_CAL_LOW, BATT2_I_RAW_HIGH, BATT2_I_CAL_HIGH);
-  calibrated_battery1_power   = calibrated_battery1_voltage * calibrated_battery1_current;
-  calibrated_battery2_power   = calibrated_battery2_voltage * calibrated_battery2_current;
-
-  // ----- RunningAverage smoothing -----
-  ra_batt1_voltage.addValue(calibrated_battery1_voltage);
-  ra_batt1_current.addValue(calibrated_battery1_current);
-  if (calibrated_battery1_temp_C != DEVICE_DISCONNECTED_C) ra_batt1_temp_C.addValue(calibrated_battery1_temp_C);
-  ra_batt2_voltage.addValue(calibrated_battery2_voltage);
-  ra_batt2_current.addValue(calibrated_battery2_current);
-  if (calibrated_battery2_temp_C != DEVICE_DISCONNECTED_C) ra_batt2_temp_C.addValue(calibrated_battery2_temp_C);
-
-  smooth_battery1_voltage = ra_batt1_voltage.getAverage();
-  smooth_battery1_current = ra_batt1_current.getAverage();
-  smooth_battery1_temp_C  = ra_batt1_temp_C.getAverage();
-
-  smooth_battery2_voltage = ra_batt2_voltage.getAverage();
-  smooth_battery2_current = ra_batt2_current.getAverage();
-  smooth_battery2_temp_C  = ra_batt2_temp_C.getAverage();
-
-  smooth_battery1_power = smooth_battery1_voltage * smooth_battery1_current;
-  smooth_battery2_power = smooth_battery2_voltage * smooth_battery2_current;
-  smooth_battery1_temp_K = smooth_battery1_temp_C + 273.15f;
-  smooth_battery2_temp_K = smooth_battery2_temp_C + 273.15f;
-
-  // ----- Energy integration -----
-  unsigned long nowMs = millis();
-  float dtHours = (nowMs - lastLoopMillis) / 3600000.0f;
-  lastLoopMillis = nowMs;
-  battery1_remaining_Wh += -smooth_battery1_power * dtHours;
-  battery2_remaining_Wh += -smooth_battery2_power * dtHours;
+  // ----- DS18B20: latest reading of the temp stage -----
+  for (uint8_t i = 0; i < NUM_BATTERIES; i++) {
+    banks.raw_temp_C[i] = tempBus.tempC(i);
+    banks.raw_temp_K[i] = banks.raw_temp_C[i] + 273.15f;
+    banks.tempFresh[i] = tempBus.sensor(i).reads != tempReads[i];
+    tempReads[i] = tempBus.sensor(i).reads;
+    if (banks.raw_temp_C[i] == HAL_TEMP_DISCONNECTED) banks.filt_temp_C.clear(i);
+  }
+
+  // ----- Calibration + smoothing -----
+  processBankSamples(banks, bankConfig);
+
+  // ----- Fault limits, on the unsmoothed samples -----
+  checkBankFaults(banks, bankConfig, halMillis());
+
+  // ----- Coulomb counting (Ah + Wh, per conversion) -----
+  integrateBanks(banks, bankConfig);
+
+#ifdef SOC_ESTIMATOR_EKF
+  // ----- Voltage correction of the counter -----
+  estimateBanks(banks, bankConfig);
+#endif
+
+  // ----- Time to empty / full -----
+  predictBanks(banks, bankConfig);
+
+  // ----- Hand new readings to the publishing side -----
+  uint32_t nowMs = halMillis();
+  bool changed[NUM_BATTERIES];
+  for (uint8_t i = 0; i < NUM_BATTERIES; i++) changed[i] = banks.fresh[i] || banks.tempFresh[i];
+  publishBanks(banks, bankSnapshots, nowMs, changed);
+  for (uint8_t i = 0; i < NUM_BATTERIES; i++) {
+    if (!changed[i]) continue;
+    BankSample s;
+    s.ms       = nowMs;
+    s.sampleUs = banks.sampleUs[i];
+    s.bank     = i;
+    s.faults   = banks.faults.active[i];
+    s.volts    = banks.smooth_voltage[i];
+    s.amps     = banks.smooth_current[i];
+    s.tempK    = banks.smooth_temp_K[i];
+    sampleRing.push(s);   // full: dropped and counted
+  }
+#ifdef DEBUG_OUTPUT
+  publishCounters();
+#endif
 }
 
-// =======================
-// Simple calibration function
-// =======================
-float applyCalibration(float raw, float rawLow, float calLow, float rawHigh, float calHigh) {
-  float slope = (calHigh - calLow) / (rawHigh - rawLow);
-  float offset = calLow - slope * rawLow;
-  return slope * raw + offset;
+uint32_t sensorSlackUs() {
+  uint32_t slack = UINT32_MAX;
+  for (uint8_t i = 0; i < NUM_BATTERIES; i++) {
+    uint32_t period = conversionPeriodUs[i].load(std::memory_order_acquire);
+    uint32_t last = lastConversionUs[i].load(std::memory_order_relaxed);
+    uint32_t age = halMicros() - last;   // clock read after the load: never negative
+    if (period == 0 || age >= 2 * period) continue;   // no recent conversions
+    uint32_t left = age < period ? period - age : 0;
+    if (left < slack) slack = left;
+  }
+  return slack;
 }
 
+void tempStep() {
+  if (sensorSlackUs() < TEMP_STEP_GUARD_US) return;   // an INA226 read is near
+  tempBus.step();
+}
+
+const TempSensor& tempSensor(uint8_t ch) { return tempBus.sensor(ch); }
+
 // =======================
 // Debug printing
 // =======================
+#ifdef DEBUG_OUTPUT
+static void printTier(uint8_t i, const char* tier, const BankTier& t) {
+  Serial.print("B"); Serial.print(i + 1); Serial.print(" "); Serial.print(tier); Serial.print(": ");
+  Serial.print(t.volts); Serial.print(" V, ");
+  Serial.print(t.amps); Serial.print(" A, ");
+  Serial.print(t.watts); Serial.print(" W, ");
+  Serial.print(t.tempC); Serial.print(" C, ");
+  Serial.print(t.tempK); Serial.println(" K");
+}
+#endif
+
 void debugPrint() {
 #ifdef DEBUG_OUTPUT
-  // -------- RAW values --------
-  Serial.print("B1 raw: "); Serial.print(raw_battery1_voltage); Serial.print(" V, ");
-  Serial.print(raw_battery1_current); Serial.print(" A, ");
-  Serial.print(raw_battery1_power);   Serial.print(" W, ");
-  Serial.print(raw_battery1_temp_C);  Serial.print(" C, ");
-  Serial.print(raw_battery1_temp_K);  Serial.println(" K");
-
-  Serial.print("B2 raw: "); Serial.print(raw_battery2_voltage); Serial.print(" V, ");
-  Serial.print(raw_battery2_current); Serial.print(" A, ");
-  Serial.print(raw_battery2_power);   Serial.print(" W, ");
-  Serial.print(raw_battery2_temp_C);  Serial.print(" C, ");
-  Serial.print(raw_battery2_temp_K);  Serial.println(" K");
-
-  // -------- CALIBRATED values --------
-  Serial.print("B1 cal: "); Serial.print(calibrated_battery1_voltage); Serial.print(" V, ");
-  Serial.print(calibrated_battery1_current); Serial.print(" A, ");
-  Serial.print(calibrated_battery1_power);   Serial.print(" W, ");
-  Serial.print(calibrated_battery1_temp_C);  Serial.print(" C, ");
-  Serial.print(calibrated_battery1_temp_K);  Serial.println(" K");
-
-  Serial.print("B2 cal: "); Serial.print(calibrated_battery2_voltage); Serial.print(" V, ");
-  Serial.print(calibrated_battery2_current); Serial.print(" A, ");
-  Serial.print(calibrated_battery2_power);   Serial.print(" W, ");
-  Serial.print(calibrated_battery2_temp_C);  Serial.print(" C, ");
-  Serial.print(calibrated_battery2_temp_K);  Serial.println(" K");
-
-  // -------- SMOOTHED values --------
-  Serial.print("B1 smooth: "); Serial.print(smooth_battery1_voltage); Serial.print(" V, ");
-  Serial.print(smooth_battery1_current); Serial.print(" A, ");
-  Serial.print(smooth_battery1_power);   Serial.print(" W, ");
-  Serial.print(smooth_battery1_temp_C);  Serial.print(" C, ");
-  Serial.print(smooth_battery1_temp_K);  Serial.println(" K");
-
-  Serial.print("B2 smooth: "); Serial.print(smooth_battery2_voltage); Serial.print(" V, ");
-  Serial.print(smooth_battery2_current); Serial.print(" A, ");
-  Serial.print(smooth_battery2_power);   Serial.print(" W, ");
-  Serial.print(smooth_battery2_temp_C);  Serial.print(" C, ");
-  Serial.print(smooth_battery2_temp_K);  Serial.println(" K");
-
-  // -------- SOC & Capacity --------
-  Serial.print("SOC1: "); Serial.print(soc_battery1_percent); Serial.print("%, ");
-  Serial.print("SOH1: "); Serial.print(soh_battery1_percent); Serial.print("%, ");
-  Serial.print("Rem1: "); Serial.print(battery1_remaining_Ah); Serial.print(" Ah, ");
-  Serial.print(battery1_remaining_Wh); Serial.println(" Wh");
-
-  Serial.print("SOC2: "); Serial.print(soc_battery2_percent); Serial.print("%, ");
-  Serial.print("SOH2: "); Serial.print(soh_battery2_percent); Serial.print("%, ");
-  Serial.print("Rem2: "); Serial.print(battery2_remaining_Ah); Serial.print(" Ah, ");
-  Serial.print(battery2_remaining_Wh); Serial.println(" Wh");
-
-  // -------- Status flags --------
-  Serial.print("B1 Rest: "); Serial.print(batt1_isResting ? "YES" : "NO");
-  Serial.print(", Full: "); Serial.println(batt1_isFull ? "YES" : "NO");
-
-  Serial.print("B2 Rest: "); Serial.print(batt2_isResting ? "YES" : "NO");
-  Serial.print(", Full: "); Serial.println(batt2_isFull ? "YES" : "NO");
+  SensorCounters c;
+  bool haveCounters = sensorCounters.read(c);
+  for (uint8_t i = 0; i < NUM_BATTERIES; i++) {
+    // One consistent copy of the bank (the sensors stage may be
+    // running on the other core)
+    BankSnapshot s;
+    if (!bankSnapshots[i].read(s)) {
+      Serial.print("B"); Serial.print(i + 1); Serial.println(": snapshot busy");
+      continue;
+    }
+    printTier(i, "raw", s.raw);
+    printTier(i, "cal", s.cal);
+    printTier(i, "smooth", s.smooth);
+
+    // -------- SOC & Capacity --------
+    Serial.print("SOC"); Serial.print(i + 1); Serial.print(": "); Serial.print(s.socPercent); Serial.print("%, ");
+    Serial.print("SOH"); Serial.print(i + 1); Serial.print(": "); Serial.print(s.sohPercent); Serial.print("%, ");
+    Serial.print("Rem"); Serial.print(i + 1); Serial.print(": "); Serial.print(s.remainingAh); Serial.print(" Ah, ");
+    Serial.print(s.remainingWh); Serial.println(" Wh");
+
+    // -------- Time to empty / full --------
+    Serial.print("B"); Serial.print(i + 1); Serial.print(" Load: "); Serial.print(s.loadA);
+    Serial.print(" A ("); Serial.print((uint32_t)LoadHorizons<NUM_BATTERIES>::tauS(s.loadHorizon));
+    Serial.print(" s), TTE: "); Serial.print(s.timeToEmptyS / 3600.0f);
+    Serial.print(" h, TTF: "); Serial.print(s.timeToFullS / 3600.0f); Serial.println(" h");
 
+    // -------- Status flags --------
+    Serial.print("B"); Serial.print(i + 1); Serial.print(" Rest: "); Serial.print(s.resting ? "YES" : "NO");
+    Serial.print(", Full: "); Serial.print(s.full ? "YES" : "NO");
+    Serial.print(", Faults:");
+    if (s.faults == 0) Serial.print(" none");
+    if (s.faults & (1u << FAULT_VOLT_LOW))  Serial.print(" VOLT_LOW");
+    if (s.faults & (1u << FAULT_VOLT_HIGH)) Serial.print(" VOLT_HIGH");
+    if (s.faults & (1u << FAULT_CURR_HIGH)) Serial.print(" CURR_HIGH");
+    if (s.faults & (1u << FAULT_TEMP_HIGH)) Serial.print(" TEMP_HIGH");
+    Serial.print(", snapshot v"); Serial.println(bankSnapshots[i].version());
+
+    if (!haveCounters) continue;
+
+    // -------- I²C --------
+    const I2cDeviceStats& d = c.i2c[i];
+    Serial.print("B"); Serial.print(i + 1); Serial.print(" I2C: "); Serial.print(d.transactions); Serial.print(" transactions, ");
+    Serial.print(d.nacks); Serial.print(" NACK, "); Serial.print(d.timeouts); Serial.print(" timeouts, latency avg ");
+    Serial.print(d.transactions ? (uint32_t)(d.sumUs / d.transactions) : 0); Serial.print(" max ");
+    Serial.print(d.maxUs); Serial.println(" us");
+
+    // -------- DS18B20 --------
+    const TempSensor& t = c.temp[i];
+    Serial.print("B"); Serial.print(i + 1); Serial.print(" DS18B20: "); Serial.print(t.bits); Serial.print(" bit, ");
+    Serial.print(t.reads); Serial.print(" reads, "); Serial.print(t.crcErrors); Serial.print(" CRC errors, ");
+    Serial.print(t.absent); Serial.print(" absent, "); Serial.print(t.reconfigs); Serial.println(" reconfigs");
+  }
+  if (haveCounters) {
+    const I2cBusStats& bus = c.bus;
+    Serial.print("I2C bus: "); Serial.print(bus.recoveries); Serial.print(" recoveries, ");
+    Serial.print(bus.failedRecoveries); Serial.print(" failed, "); Serial.print(bus.skipped); Serial.print(" skipped");
+    Serial.println(bus.down ? " (DOWN)" : "");
+  } else {
+    Serial.println("Sensor counters busy");
+  }
+  NmeaRxStats rx = nmeaRxStats();
+  Serial.print("N2K RX: "); Serial.print(rx.frames); Serial.print(" frames, ");
+  Serial.print(rx.dropped); Serial.print(" dropped, parse avg ");
+  Serial.print(rx.parses ? (uint32_t)(rx.parseSumUs / rx.parses) : 0); Serial.print(" max ");
+  Serial.print(rx.parseMaxUs); Serial.println(" us");
+  Serial.print("Sample ring: "); Serial.print(sampleRing.pushes()); Serial.print(" pushed, ");
+  Serial.print(sampleRing.drops.load()); Serial.print(" dropped, max fill ");
+  Serial.print(sampleRing.maxFill.load()); Serial.print("/"); Serial.println(SAMPLE_RING_LEN);
   Serial.println();
 #endif
 }
@@ -1,6 +1,10 @@
 #ifndef SENSORS_H
 #define SENSORS_H
 
+#include <Arduino.h>
+#include "Config.h"
+#include "SpscRing.h"
+
 // ===========================================================
 // Sensors.h — Interface for all sensor-related functionality
 // ===========================================================
@@ -8,27 +12,63 @@
 // Provides:
 //   - Sensor setup (INA226 + DS18B20)
 //   - Periodic sensor reads (raw → calibrated → smoothed)
-//   - Energy tracking (Ah + Wh integration)
-//   - Fault detection (voltage, current, temperature)
+//   - Energy tracking (Ah + Wh, integrated per conversion)
+//   - Fault detection (voltage, current, temperature) on
+//     every sample, before smoothing (Faults.h)
+//   - The sample ring: each bank's new readings, handed from
+//     the sensors stage to the nmea stage on the other core
 //   - Debug printing of all tiers (raw, calibrated, smoothed)
 //
 // Globals are declared in Globals.h and defined in Globals.cpp.
 // ===========================================================
 
+struct TempSensor;
+
+// One bank's reading as pushed by readSensors(): a new INA226
+// conversion, a new DS18B20 reading, or both
+struct BankSample {
+  uint32_t ms;         // pushed (fault detection time)
+  uint32_t sampleUs;   // end of the INA226 conversion
+  uint8_t  bank;
+  uint8_t  faults;     // active faults after it (bit per FaultType)
+  float    volts;      // smoothed
+  float    amps;
+  float    tempK;
+};
+
+// Producer: the sensors stage; consumer: the nmea stage
+extern SpscRing<BankSample, SAMPLE_RING_LEN> sampleRing;
+
 // Initialize all sensors (INA226 + DS18B20)
 // - Sets up I²C, configures shunts
-// - Starts DS18B20 conversions
+// - Assigns the DS18B20s (configured ROMs or a bus search)
 void setupSensors();
 
 // Perform one round of sensor updates
 // - Reads INA226 volt/amp
 // - Updates raw_, calibrated_, smooth_ variables
-// - Handles non-blocking DS18B20 temp reads
-// - Integrates Ah and Wh usage
-// - Evaluates fault thresholds
+// - Takes the latest DS18B20 readings
+// - Integrates Ah and Wh over each new INA226 conversion
+// - Evaluates fault thresholds on the unsmoothed samples
+// - Publishes the banks with a new reading (bankSnapshots)
+//   and pushes the reading into sampleRing
 void readSensors();
 
+// One DS18B20 bus step (reset or a few bytes), skipped when an
+// INA226 conversion is due within TEMP_STEP_GUARD_US
+void tempStep();
+
+// DS18B20 state and statistics of bank `ch`
+const TempSensor& tempSensor(uint8_t ch);
+
+// Time until the next INA226 conversion finishes on any bank
+// (0 if one is ready and unread, UINT32_MAX without sensors).
+// Safe from either core: reads only what readSensors()
+// publishes for it.
+uint32_t sensorSlackUs();
+
 // Print debug info (only active if DEBUG_OUTPUT defined)
+// - From each bank's published snapshot (bankSnapshots)
 // - Shows raw, calibrated, smoothed values
 // - Includes SoC %, remaining Ah, remaining Wh
 // - Flags any faults detected
@@ -0,0 +1,69 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <string.h>
+#include <type_traits>
+
+// ===========================================================
+// Seqlock.h — Single-writer snapshot with lock-free readers
+// ===========================================================
+//
+// Seqlock<T> publishes a plain struct from one task to readers
+// on another core (or an ISR) without a lock:
+//   - the writer makes the sequence odd, stores the copy,
+//     then makes it even again (release)
+//   - a reader copies the struct between two loads of the
+//     sequence and keeps the copy only if both are the same
+//     even value, i.e. no write overlapped; otherwise it tries
+//     again (a write is a few dozen word stores)
+// The writer never waits. A reader that still sees a write
+// in progress after SEQLOCK_MAX_TRIES attempts gives up and
+// returns false, and keeps its previous copy. The struct is
+// held as 32-bit atomic words (relaxed), which is what a
+// memcpy would compile to on the ESP32, but is not a data race
+// for the compiler. The sequence / 2 is the version: the
+// number of writes so far.
+// ===========================================================
+
+#define SEQLOCK_MAX_TRIES 100
+
+template <typename T>
+struct Seqlock {
+  static_assert(std::is_trivially_copyable<T>::value, "Seqlock holds a plain struct");
+  static constexpr size_t WORDS = (sizeof(T) + 3) / 4;
+
+  std::atomic<uint32_t> seq{0};        // odd while a write is in progress
+  std::atomic<uint32_t> word[WORDS]{};
+
+  // Single writer
+  void write(const T& v) {
+    uint32_t buf[WORDS] = {};
+    memcpy(buf, &v, sizeof(T));
+    uint32_t s = seq.load(std::memory_order_relaxed);
+    seq.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t k = 0; k < WORDS; k++) word[k].store(buf[k], std::memory_order_relaxed);
+    seq.store(s + 2, std::memory_order_release);
+  }
+
+  // Any number of readers; false: no consistent copy (out unchanged)
+  bool read(T& out) const {
+    uint32_t buf[WORDS];
+    for (uint32_t tries = 0; tries < SEQLOCK_MAX_TRIES; tries++) {
+      uint32_t s0 = seq.load(std::memory_order_acquire);
+      if (s0 & 1) continue;   // write in progress
+      for (size_t k = 0; k < WORDS; k++) buf[k] = word[k].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (seq.load(std::memory_order_relaxed) != s0) continue;
+      memcpy(&out, buf, sizeof(T));
+      return true;
+    }
+    return false;
+  }
+
+  uint32_t version() const { return seq.load(std::memory_order_acquire) >> 1; }
+};
+
+#endif // SEQLOCK_H
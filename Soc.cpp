@@ -1,246 +1,461 @@
 #include "Globals.h"
 #include "Config.h"
-#include <EEPROM.h>
+#include "Hal.h"
+#include "Journal.h"
+#include "Ocv.h"
+#include "Sensors.h"
 #include <math.h>
+#include <string.h>
+#include <atomic>
 
 // ==========================
-// Data Structures
+// Persistence (flash journal)
 // ==========================
 
-struct SocPoint { float soc; float v; };
-typedef struct { const SocPoint* pts; size_t len; } OcvTableView;
+// Journaled state; field f of bank i is at PF(f, i), which is
+// also its bit in a delta record. Besides capacity and SoC it
+// holds what the estimator needs to resume where it stopped:
+//   PF_WH          remaining energy (Wh)
+//   PF_TEMP        smoothed temperature (0.5 C steps), the OCV
+//                  compensation seed until the first DS18B20
+//                  conversion; NAN if there was none
+//   PF_ANCHOR_SOC  learning anchor SoC; NAN without an anchor
+//   PF_ANCHOR_AH   net charge counted since the anchor
+//   PF_ANCHOR_AGE  hours since the anchor (0.1 h steps)
+//   PF_FULL_S      whole seconds at the absorb/tail condition,
+//                  -1 once full was detected
+// SoH is not stored: it follows from the capacity.
+enum { PF_CAPACITY, PF_SOC, PF_WH, PF_TEMP, PF_ANCHOR_SOC, PF_ANCHOR_AH,
+       PF_ANCHOR_AGE, PF_FULL_S, PF_COUNT };
+#define PF_FIELDS (PF_COUNT * NUM_BATTERIES)
+#define PF(f, i)  ((f) * NUM_BATTERIES + (i))
+struct PersistState { float v[PF_FIELDS]; };
+static_assert(PF_FIELDS <= 32, "delta record mask is 32 bits");
 
-// ==========================
-// EEPROM Manager Class
-// ==========================
+#if SOC_INIT_SAMPLES > VOLTAGE_FILTER_SAMPLES
+#error "SOC_INIT_SAMPLES must not exceed VOLTAGE_FILTER_SAMPLES"
+#endif
+
+// Record types (1 and 2 were the capacity/SoC/SoH layout
+// before the estimator state was added; they are ignored)
+#define JREC_FULL  3   // PersistState
+#define JREC_DELTA 4   // uint32 field mask, then one float per set bit
 
-class BatteryEepromManager {
-public:
-  void begin() { EEPROM.begin(EEPROM_NUM_SLOTS * SLOT_SIZE); }
-  bool load(float &b1cap, float &b2cap, float &b1soc, float &b2soc,
-            float &b1soh, float &b2soh);
-  void save(float b1cap, float b2cap, float b1soc, float b2soc,
-            float b1soh, float b2soh);
-private:
-  const int SLOT_SIZE = 2 + 6*4 + 2; // seq + 6 floats + checksum
-  int lastSlot = -1;
-  uint16_t seqNum = 0;
-  uint16_t calcChecksum(int addr, size_t len);
+// Only capacity and SoC cause a write; the other fields go
+// along with it
+static const float persistDeadband[PF_COUNT] = {
+  JOURNAL_CAP_DEADBAND_AH, JOURNAL_SOC_DEADBAND_PCT,
+  INFINITY, INFINITY, INFINITY, INFINITY, INFINITY, INFINITY
 };
 
-static BatteryEepromManager eepromMgr;
+static Journal journal;
+static PersistState journaled;     // values as of the last record
+static float tempSeedC[NUM_BATTERIES];
+static uint32_t socBootMs = 0;
 
-// ==========================
-// EEPROM Implementation
-// ==========================
+struct ReplayState { PersistState s; bool valid; };
+
+static void applyRecord(uint8_t type, const uint8_t* p, uint8_t len, void* ctx) {
+  ReplayState& r = *(ReplayState*)ctx;
+  if (type == JREC_FULL && len == sizeof(PersistState)) {
+    memcpy(&r.s, p, len);
+    r.valid = true;
+  } else if (type == JREC_DELTA && r.valid && len >= 4) {
+    uint32_t mask;
+    memcpy(&mask, p, 4);
+    uint8_t off = 4;
+    for (uint8_t k = 0; k < PF_FIELDS; k++) {
+      if (!(mask & (1UL << k))) continue;
+      if (off + 4 > len) return;
+      memcpy(&r.s.v[k], p + off, 4);
+      off += 4;
+    }
+  }
+}
+
+// State before anything was journaled: no SoC, no anchor
+static void defaultPersistState(PersistState& s) {
+  for (uint8_t i = 0; i < NUM_BATTERIES; i++) {
+    s.v[PF(PF_CAPACITY, i)]   = bankConfig[i].capacityAh;
+    s.v[PF(PF_SOC, i)]        = NAN;
+    s.v[PF(PF_WH, i)]         = 0.0f;
+    s.v[PF(PF_TEMP, i)]       = NAN;
+    s.v[PF(PF_ANCHOR_SOC, i)] = NAN;
+    s.v[PF(PF_ANCHOR_AH, i)]  = 0.0f;
+    s.v[PF(PF_ANCHOR_AGE, i)] = 0.0f;
+    s.v[PF(PF_FULL_S, i)]     = 0.0f;
+  }
+}
 
-uint16_t BatteryEepromManager::calcChecksum(int addr, size_t len) {
-  uint16_t sum = 0;
-  for (size_t i = 0; i < len; i++) sum += EEPROM.read(addr + i);
-  return sum;
-}
-
-bool BatteryEepromManager::load(float &b1cap, float &b2cap, float &b1soc, float &b2soc,
-                                float &b1soh, float &b2soh) {
-  int latestSlot = -1; uint16_t latestSeq = 0;
-  for (int i = 0; i < EEPROM_NUM_SLOTS; i++) {
-    int addr = EEPROM_BASE_ADDR + i * SLOT_SIZE;
-    uint16_t seq; EEPROM.get(addr, seq);
-    if (seq == 0xFFFF) continue;
-    uint16_t crcStored; EEPROM.get(addr + SLOT_SIZE - 2, crcStored);
-    uint16_t crcCalc = calcChecksum(addr, SLOT_SIZE - 2);
-    if (crcStored == crcCalc && seq >= latestSeq) {
-      latestSeq = seq; latestSlot = i;
+// A bank without a valid SoC yet keeps its journaled state
+static void currentPersistState(PersistState& s, uint32_t nowMs) {
+  for (uint8_t i = 0; i < NUM_BATTERIES; i++) {
+    if (!banks.socValid[i]) {
+      for (uint8_t f = 0; f < PF_COUNT; f++) s.v[PF(f, i)] = journaled.v[PF(f, i)];
+      continue;
     }
+    bool anchor = banks.haveAnchor[i];
+    s.v[PF(PF_CAPACITY, i)]   = banks.learned_capacity_Ah[i];
+    s.v[PF(PF_SOC, i)]        = banks.soc_percent[i];
+    s.v[PF(PF_WH, i)]         = banks.remaining_Wh[i];
+    s.v[PF(PF_TEMP, i)]       = roundf(banks.smooth_temp_C[i] * 2.0f) * 0.5f;
+    s.v[PF(PF_ANCHOR_SOC, i)] = anchor ? banks.anchorSoc[i] : NAN;
+    s.v[PF(PF_ANCHOR_AH, i)]  = anchor ? bankNetAh(banks, i) - banks.anchorNetAh[i] : 0.0f;
+    s.v[PF(PF_ANCHOR_AGE, i)] = anchor ? ((nowMs - banks.anchorMs[i]) / 360000UL) * 0.1f : 0.0f;
+    s.v[PF(PF_FULL_S, i)]     = banks.isFull[i] ? -1.0f : (float)((nowMs - banks.fullStartMs[i]) / 1000UL);
+  }
+}
+
+// Resume bank i from journaled state. Rejected if the values
+// are outside what the bank could hold (the bank then starts
+// from OCV).
+static void restoreBank(uint8_t i, const PersistState& s, uint32_t nowMs) {
+  const BankConfig& c = bankConfig[i];
+  float cap = s.v[PF(PF_CAPACITY, i)];
+  float soc = s.v[PF(PF_SOC, i)];
+  if (!(cap >= c.capacityAh * LEARN_CAPACITY_MIN_FACTOR && cap <= c.capacityAh * LEARN_CAPACITY_MAX_FACTOR)) return;
+  if (!(soc >= 0.0f && soc <= 100.0f)) return;
+
+  banks.learned_capacity_Ah[i] = cap;
+  banks.soh_percent[i] = fminf(fmaxf(100.0f * cap / c.capacityAh, 0.0f), 100.0f);
+  banks.stored_soc[i] = soc;
+  banks.soc_percent[i] = soc;
+  setBankCharge(banks, i, soc / 100.0f * cap, s.v[PF(PF_WH, i)]);
+  tempSeedC[i] = s.v[PF(PF_TEMP, i)];
+
+  float anchorSoc = s.v[PF(PF_ANCHOR_SOC, i)];
+  if (!isnan(anchorSoc)) {
+    banks.haveAnchor[i] = true;
+    banks.anchorSoc[i] = anchorSoc;
+    banks.anchorNetAh[i] = bankNetAh(banks, i) - s.v[PF(PF_ANCHOR_AH, i)];
+    banks.anchorMs[i] = nowMs - (uint32_t)(s.v[PF(PF_ANCHOR_AGE, i)] * 3600000.0f);
+  }
+  float fullS = s.v[PF(PF_FULL_S, i)];
+  banks.isFull[i] = fullS < 0.0f;
+  banks.fullStartMs[i] = nowMs - (fullS > 0.0f ? (uint32_t)fullS * 1000UL : 0);
+}
+
+// Commit when the capacity or SoC moved by its deadband (at
+// most once per JOURNAL_MIN_INTERVAL_MS), or on the
+// JOURNAL_MAX_INTERVAL_MS deadline if anything changed at all
+static bool journalDue(const PersistState& now, uint32_t nowMs) {
+  uint32_t since = nowMs - lastJournalSaveMillis;
+  if (since < JOURNAL_MIN_INTERVAL_MS) return false;
+  bool changed = false;
+  for (uint8_t k = 0; k < PF_FIELDS; k++) {
+    if (memcmp(&now.v[k], &journaled.v[k], 4) == 0) continue;
+    changed = true;
+    // NAN difference: a value appeared or went away
+    if (!(fabsf(now.v[k] - journaled.v[k]) < persistDeadband[k / NUM_BATTERIES])) return true;
   }
-  if (latestSlot < 0) return false;
-  int addr = EEPROM_BASE_ADDR + latestSlot * SLOT_SIZE;
-  uint16_t seq; EEPROM.get(addr, seq); addr += 2;
-  EEPROM.get(addr, b1cap); addr += 4;
-  EEPROM.get(addr, b2cap); addr += 4;
-  EEPROM.get(addr, b1soc); addr += 4;
-  EEPROM.get(addr, b2soc); addr += 4;
-  EEPROM.get(addr, b1soh); addr += 4;
-  EEPROM.get(addr, b2soh); addr += 4;
-  lastSlot = latestSlot; seqNum = seq;
-  return true;
-}
-
-void BatteryEepromManager::save(float b1cap, float b2cap, float b1soc, float b2soc,
-                                float b1soh, float b2soh) {
-  seqNum++;
-  int next = (lastSlot + 1) % EEPROM_NUM_SLOTS;
-  int addr = EEPROM_BASE_ADDR + next * SLOT_SIZE;
-  int start = addr;
-  EEPROM.put(addr, seqNum); addr += 2;
-  EEPROM.put(addr, b1cap);  addr += 4;
-  EEPROM.put(addr, b2cap);  addr += 4;
-  EEPROM.put(addr, b1soc);  addr += 4;
-  EEPROM.put(addr, b2soc);  addr += 4;
-  EEPROM.put(addr, b1soh);  addr += 4;
-  EEPROM.put(addr, b2soh);  addr += 4;
-  uint16_t crc = calcChecksum(start, SLOT_SIZE - 2);
-  EEPROM.put(start + SLOT_SIZE - 2, crc);
-  EEPROM.commit();
-  lastSlot = next;
+  return changed && since >= JOURNAL_MAX_INTERVAL_MS;
+}
+
+// Delta record of the fields that differ from the journal;
+// returns its length, 0 if nothing changed
+static uint8_t buildDelta(const PersistState& now, uint8_t* rec) {
+  uint32_t mask = 0;
+  uint8_t len = 4;
+  for (uint8_t k = 0; k < PF_FIELDS; k++) {
+    if (memcmp(&now.v[k], &journaled.v[k], 4) == 0) continue;
+    mask |= 1UL << k;
+    memcpy(rec + len, &now.v[k], 4);
+    len += 4;
+  }
+  memcpy(rec, &mask, 4);
+  return mask ? len : 0;
+}
+
+// Deferred writer: updateSoc() only snapshots the values into
+// `pending`; persistStep() writes them with at most one flash
+// operation per call. A full sector rotates with a complete
+// snapshot as the new base record, and its erase (tens of ms)
+// starts only when the next INA226 conversion is further away
+// than PERSIST_ERASE_US, so it never delays a sample. After
+// PERSIST_MAX_DEFER_MS it goes ahead regardless.
+// The two run on different cores: havePending hands `pending`
+// and `journaled` from one to the other, set with release
+// once the snapshot is complete, cleared with release once it
+// is written, read with acquire. updateSoc() touches neither
+// while it is set.
+static PersistState pending;
+static std::atomic<bool> havePending{false};
+static uint32_t pendingSinceMs = 0;
+
+static void persistWrite(bool force) {
+  uint8_t rec[4 + sizeof(PersistState)];
+  uint8_t len = buildDelta(pending, rec);
+  bool ok = true;
+
+  if (len == 0) {
+    havePending.store(false, std::memory_order_release);
+    return;
+  }
+  if (journal.fits(len)) {
+    ok = journal.append(JREC_DELTA, rec, len);
+  } else if (!journal.nextErased()) {
+    bool late = halMillis() - pendingSinceMs >= PERSIST_MAX_DEFER_MS;
+    if (!force && !late && sensorSlackUs() < PERSIST_ERASE_US) return;
+    if (journal.eraseNext()) return;   // base record on the next call
+    ok = false;
+  } else {
+    ok = journal.rotate(JREC_FULL, &pending, sizeof(PersistState));
+  }
+
+  // On a flash error the snapshot is dropped; the next one retries
+  if (ok) journaled = pending;
+  havePending.store(false, std::memory_order_release);
+}
+
+void persistStep() {
+  if (havePending.load(std::memory_order_acquire)) persistWrite(false);
 }
 
 // ==========================
-// OCV Tables (12V Reference)
+// OCV Lookup
 // ==========================
 
-static const SocPoint OCV_FLA_12V[] = {
-  {10, 11.51},{20, 11.66},{30, 11.81},{40, 11.96},{50, 12.10},
-  {60, 12.24},{70, 12.37},{80, 12.50},{90, 12.62},{100, 12.73}
-};
-static const SocPoint OCV_AGM_12V[] = {
-  {10, 11.60},{20, 11.78},{30, 11.95},{40, 12.10},{50, 12.20},
-  {60, 12.32},{70, 12.45},{80, 12.60},{90, 12.75},{100, 12.85}
-};
-static const SocPoint OCV_GEL_12V[] = {
-  {10, 11.60},{20, 11.80},{30, 11.96},{40, 12.12},{50, 12.24},
-  {60, 12.36},{70, 12.48},{80, 12.62},{90, 12.78},{100, 12.90}
-};
-static const SocPoint OCV_LFP_12V[] = {
-  {0, 12.00},{10, 12.90},{20, 13.00},{30, 13.10},{40, 13.15},
-  {50, 13.20},{60, 13.25},{70, 13.30},{80, 13.35},{90, 13.45},{100, 13.60}
+// Per-bank SoC grids over terminal voltage and temperature,
+// generated at compile time (Ocv.h)
+static constexpr OcvGrid ocvGrids[NUM_BATTERIES] = {
+  OCV_GRID(1),
+#if NUM_BATTERIES >= 2
+  OCV_GRID(2),
+#endif
+#if NUM_BATTERIES >= 3
+  OCV_GRID(3),
+#endif
+#if NUM_BATTERIES >= 4
+  OCV_GRID(4),
+#endif
 };
 
+// Local OCV slope (mV per % SoC, 12V reference) at a SoC
+static float ocvSlopeMv(const OcvTableView& tv, float soc) {
+  for (size_t i = 1; i < tv.len; i++) {
+    if (soc <= tv.pts[i].soc || i == tv.len - 1)
+      return 1000.0f * (tv.pts[i].v - tv.pts[i-1].v) / (tv.pts[i].soc - tv.pts[i-1].soc);
+  }
+  return 0.0f;
+}
+
+// No temperature reading yet: the journaled one from before
+// the reset; without either (or with the sensor lost) assume
+// 25 C, i.e. no compensation
+static float ocvTempC(uint8_t i) {
+  float t = banks.smooth_temp_C[i];
+  if (isnan(t)) t = tempSeedC[i];
+  return isnan(t) ? 25.0f : t;
+}
+
+static float computeOcvSoc(uint8_t i) {
+  float soc = ocvGridSoc(ocvGrids[i], banks.smooth_voltage[i], ocvTempC(i));
+  return fmaxf(0.0f, fminf(100.0f, soc));
+}
+
 // ==========================
-// Helpers
+// Capacity Learning
 // ==========================
 
-static OcvTableView getTableForChem(int chem) {
-  switch (chem) {
-    case CHEM_FLA: return { OCV_FLA_12V, sizeof(OCV_FLA_12V)/sizeof(OCV_FLA_12V[0]) };
-    case CHEM_AGM: return { OCV_AGM_12V, sizeof(OCV_AGM_12V)/sizeof(OCV_AGM_12V[0]) };
-    case CHEM_GEL: return { OCV_GEL_12V, sizeof(OCV_GEL_12V)/sizeof(OCV_GEL_12V[0]) };
-    case CHEM_LFP: return { OCV_LFP_12V, sizeof(OCV_LFP_12V)/sizeof(OCV_LFP_12V[0]) };
+// Streaming learner, O(1) per anchor. An anchor is a point
+// where the SoC is known independently of the counter: a
+// detected full charge (100 %) or a settled rest voltage on a
+// steep part of the OCV curve. Between two anchors the
+// unclamped net counter gives the charge moved, so
+//   capacity = dNetAh / (dSoC / 100)
+// Estimates over less than LEARN_MIN_DELTA_SOC_PCT or outside
+// the nominal guardrails are dropped; accepted ones are folded
+// in with CAPACITY_LEARNING_ALPHA. Every anchor resyncs the
+// counter to its SoC. The span start only moves once a span
+// was long enough to be evaluated, or after LEARN_MAX_SPAN_H
+// (bounds the current-offset error in the net counter).
+static void onSocAnchor(uint8_t i, float soc, uint32_t nowMs) {
+  const BankConfig& c = bankConfig[i];
+  float netAh = bankNetAh(banks, i);
+  bool moveAnchor = true;
+
+  if (banks.haveAnchor[i] && nowMs - banks.anchorMs[i] < LEARN_MAX_SPAN_H * 3600000UL) {
+    float dSoc = soc - banks.anchorSoc[i];
+    moveAnchor = fabsf(dSoc) >= LEARN_MIN_DELTA_SOC_PCT;
+    if (moveAnchor) {
+      float est = (netAh - banks.anchorNetAh[i]) / (dSoc / 100.0f);
+      float lo = c.capacityAh * LEARN_CAPACITY_MIN_FACTOR;
+      float hi = c.capacityAh * LEARN_CAPACITY_MAX_FACTOR;
+      if (est >= lo && est <= hi) {
+        float cap = banks.learned_capacity_Ah[i];
+        cap += CAPACITY_LEARNING_ALPHA * (est - cap);
+        banks.learned_capacity_Ah[i] = fmaxf(lo, fminf(hi, cap));
+        banks.learnUpdates[i]++;
+      }
+    }
   }
-  return { OCV_FLA_12V, sizeof(OCV_FLA_12V)/sizeof(OCV_FLA_12V[0]) };
+
+  if (moveAnchor) {
+    banks.haveAnchor[i] = true;
+    banks.anchorSoc[i] = soc;
+    banks.anchorNetAh[i] = netAh;
+    banks.anchorMs[i] = nowMs;
+  }
+  setBankAh(banks, i, soc / 100.0f * banks.learned_capacity_Ah[i]);
 }
 
-static float lerp(float x, float x0, float x1, float y0, float y1) {
-  if (fabsf(x1 - x0) < 1e-6f) return y0;
-  float t = (x - x0) / (x1 - x0);
-  return y0 + t * (y1 - y0);
+// Rest anchor: OCV SoC at the moment rest is entered, only where
+// the OCV curve is steep enough for the voltage to resolve it
+// (rejects the flat LFP plateau)
+static void onRestEntered(uint8_t i, uint32_t nowMs) {
+  const BankConfig& c = bankConfig[i];
+  OcvTableView tv = ocvTableForChem(c.chemistry);
+  float soc = computeOcvSoc(i);
+  if (soc <= tv.pts[0].soc || soc >= tv.pts[tv.len-1].soc) return;   // clamped to the table
+  if (ocvSlopeMv(tv, soc) < LEARN_OCV_MIN_SLOPE_MV) return;
+  onSocAnchor(i, soc, nowMs);
 }
 
-static float socFromOcvVoltage(float measuredV, const OcvTableView& tv, bool is24V) {
-  float v12 = is24V ? (measuredV * 0.5f) : measuredV;
-  if (v12 <= tv.pts[0].v) return tv.pts[0].soc;
-  if (v12 >= tv.pts[tv.len-1].v) return tv.pts[tv.len-1].soc;
-  for (size_t i = 1; i < tv.len; i++) {
-    if (v12 <= tv.pts[i].v)
-      return lerp(v12, tv.pts[i-1].v, tv.pts[i].v, tv.pts[i-1].soc, tv.pts[i].soc);
+// ==========================
+// Rest and Full Detection Helpers
+// ==========================
+
+// Rest: current below the threshold for the hold time, and the
+// voltage spread over that window within the stability limit
+// (mV at 12V, scaled for 24V). The window keeps sliding while
+// the current stays low, so rest is entered as soon as the
+// last REST_HOLD_TIME_S of voltage has settled.
+static void detectRest(uint8_t i, uint32_t nowMs) {
+  const BankConfig& c = bankConfig[i];
+  float v = banks.smooth_voltage[i];
+  if (isnan(v) || fabsf(banks.smooth_current[i]) >= c.restIThresholdA) {
+    banks.restWindow[i].reset(nowMs);
+    banks.restStartMs[i] = nowMs;
+    banks.isResting[i] = false;
+    return;
   }
-  return tv.pts[tv.len-1].soc;
-}
 
-static float compensateVoltageForTemp(float measuredV, float tempC, float coef) {
-  float dT = tempC - 25.0f;
-  return measuredV - (coef * dT);
+  MinMaxWindow& w = banks.restWindow[i];
+  w.add(v, nowMs);
+  float spreadMv12 = (w.max() - w.min()) * 1000.0f * (12.0f / c.nominalV);
+  bool wasResting = banks.isResting[i];
+  banks.isResting[i] = w.covered() && spreadMv12 <= c.restVStabilityMv;
+  if (banks.isResting[i]) banks.lastRestVoltage[i] = v;
+  if (banks.isResting[i] && !wasResting && banks.socValid[i]) onRestEntered(i, nowMs);
 }
 
-// Use globals’ helpers
-extern bool isBatt1_24V();
-extern bool isBatt2_24V();
+// Full: at or above the absorb voltage (12V reference, scaled
+// for 24V) with current within the tail threshold, held for
+// FULL_HOLD_TIME_S. Anchors the learner and the counter at
+// 100 %. Cleared once the bank discharges above the rest
+// threshold.
+static void detectFull(uint8_t i, uint32_t nowMs) {
+  const BankConfig& c = bankConfig[i];
+  float v = banks.smooth_voltage[i];
+  float a = banks.smooth_current[i];
 
-static float computeOcvSoc_batt1() {
-  OcvTableView tv = getTableForChem(BATT1_CHEMISTRY);
-  float vAdj = compensateVoltageForTemp(smooth_battery1_voltage, smooth_battery1_temp_C, BATT1_TEMP_COEF);
-  float soc = socFromOcvVoltage(vAdj, tv, isBatt1_24V());
-  return fmaxf(0.0f, fminf(100.0f, soc));
-}
-static float computeOcvSoc_batt2() {
-  OcvTableView tv = getTableForChem(BATT2_CHEMISTRY);
-  float vAdj = compensateVoltageForTemp(smooth_battery2_voltage, smooth_battery2_temp_C, BATT2_TEMP_COEF);
-  float soc = socFromOcvVoltage(vAdj, tv, isBatt2_24V());
-  return fmaxf(0.0f, fminf(100.0f, soc));
+  if (a > c.restIThresholdA) banks.isFull[i] = false;
+
+  bool atTail = v >= c.fullVAbsorbV * (c.nominalV / 12.0f) && fabsf(a) <= c.fullITailA;
+  if (!atTail) {
+    banks.fullStartMs[i] = nowMs;
+    return;
+  }
+  if (!banks.isFull[i] && nowMs - banks.fullStartMs[i] >= c.fullHoldS * 1000UL) {
+    banks.isFull[i] = true;
+    onSocAnchor(i, 100.0f, nowMs);
+  }
 }
 
 // ==========================
-// Rest and Full Detection Helpers
+// Boot
 // ==========================
-// (unchanged from before)
+
+// The SoC of bank i becomes valid once its voltage average
+// holds SOC_INIT_SAMPLES conversions (one sample is too noisy
+// to read OCV from): the journaled SoC if it agrees with OCV,
+// or if the bank is under load and OCV says nothing; OCV
+// otherwise. A bank without samples by SOC_BOOT_BUDGET_MS goes
+// with its journaled SoC unchecked.
+static void initBankSoc(uint8_t i, uint32_t nowMs) {
+  const BankConfig& c = bankConfig[i];
+  float stored = banks.stored_soc[i];
+  if (banks.filt_voltage.samples(i) < SOC_INIT_SAMPLES) {
+    if (!isnan(stored) && nowMs - socBootMs >= SOC_BOOT_BUDGET_MS) banks.socValid[i] = true;
+    return;
+  }
+
+  bool atRest = fabsf(banks.smooth_current[i]) < c.restIThresholdA;
+  float ocv = computeOcvSoc(i);
+  if (isnan(stored) || (atRest && fabsf(stored - ocv) > SOC_RESUME_TOLERANCE)) {
+    // No journal, or it is stale (battery swapped or charged
+    // while off): start over, the anchor no longer applies
+    float ah = (ocv / 100.0f) * banks.learned_capacity_Ah[i];
+    setBankCharge(banks, i, ah, banks.smooth_voltage[i] * ah);
+    banks.soc_percent[i] = ocv;
+    banks.haveAnchor[i] = false;
+    banks.isFull[i] = false;
+  }
+  banks.socValid[i] = true;
+}
 
 // ==========================
 // Public API
 // ==========================
 
 void setupSoc() {
-  eepromMgr.begin();
-  float b1cap, b2cap, b1soc, b2soc, b1soh, b2soh;
-  if (eepromMgr.load(b1cap, b2cap, b1soc, b2soc, b1soh, b2soh)) {
-    battery1_learned_capacity_Ah = b1cap;
-    battery2_learned_capacity_Ah = b2cap;
-    eeprom_soc_b1 = b1soc;
-    eeprom_soc_b2 = b2soc;
-    soc_battery1_percent = eeprom_soc_b1;
-    soc_battery2_percent = eeprom_soc_b2;
-    soh_battery1_percent = b1soh;
-    soh_battery2_percent = b2soh;
-    battery1_remaining_Ah = (soc_battery1_percent/100.0f) * battery1_learned_capacity_Ah;
-    battery2_remaining_Ah = (soc_battery2_percent/100.0f) * battery2_learned_capacity_Ah;
-    battery1_remaining_Wh = smooth_battery1_voltage * battery1_remaining_Ah;
-    battery2_remaining_Wh = smooth_battery2_voltage * battery2_remaining_Ah;
-    haveEepromSoc = true;
-  }
-  lastLoopMillis = millis();
+  uint32_t nowMs = halMillis();
+  socBootMs = nowMs;
+  for (uint8_t i = 0; i < NUM_BATTERIES; i++) {
+    banks.restWindow[i].begin(bankConfig[i].restHoldS * 1000UL, nowMs);
+    tempSeedC[i] = NAN;
+  }
+
+  // Mount and replay in one pass; the last full record plus
+  // the deltas after it is the state at the reset
+  ReplayState r = {};
+  defaultPersistState(r.s);
+  if (journal.begin(JOURNAL_SECTORS, applyRecord, &r) && r.valid) {
+    for (uint8_t i = 0; i < NUM_BATTERIES; i++) restoreBank(i, r.s, nowMs);
+  }
+  journaled = r.s;
+
+  // Readers start from the resumed state
+  publishBanks(banks, bankSnapshots, nowMs);
 }
 
 void updateSoc() {
+  uint32_t nowMs = halMillis();
   if (needSocInitFromOCV) {
-    float ocv1 = computeOcvSoc_batt1();
-    float ocv2 = computeOcvSoc_batt2();
-    if (haveEepromSoc) {
-      soc_battery1_percent = (fabsf(eeprom_soc_b1 - ocv1) <= SOC_RESUME_TOLERANCE) ? eeprom_soc_b1 : ocv1;
-      soc_battery2_percent = (fabsf(eeprom_soc_b2 - ocv2) <= SOC_RESUME_TOLERANCE) ? eeprom_soc_b2 : ocv2;
-    } else {
-      soc_battery1_percent = ocv1;
-      soc_battery2_percent = ocv2;
+    bool all = true;
+    for (uint8_t i = 0; i < NUM_BATTERIES; i++) {
+      if (!banks.socValid[i]) initBankSoc(i, nowMs);
+      all = all && banks.socValid[i];
     }
-    battery1_remaining_Ah = (soc_battery1_percent/100.0f) * battery1_learned_capacity_Ah;
-    battery2_remaining_Ah = (soc_battery2_percent/100.0f) * battery2_learned_capacity_Ah;
-    battery1_remaining_Wh = smooth_battery1_voltage * battery1_remaining_Ah;
-    battery2_remaining_Wh = smooth_battery2_voltage * battery2_remaining_Ah;
-    needSocInitFromOCV = false;
+    needSocInitFromOCV = !all;
   }
 
-  unsigned long nowMs = millis();
-  float dtHours = (nowMs - lastLoopMillis) / 3600000.0f;
-  lastLoopMillis = nowMs;
-
-  battery1_remaining_Ah += -smooth_battery1_current * dtHours;
-  battery2_remaining_Ah += -smooth_battery2_current * dtHours;
-  battery1_remaining_Wh += -smooth_battery1_power * dtHours;
-  battery2_remaining_Wh += -smooth_battery2_power * dtHours;
-
-  if (battery1_remaining_Ah > battery1_learned_capacity_Ah) battery1_remaining_Ah = battery1_learned_capacity_Ah;
-  if (battery1_remaining_Ah < 0) battery1_remaining_Ah = 0;
-  if (battery2_remaining_Ah > battery2_learned_capacity_Ah) battery2_remaining_Ah = battery2_learned_capacity_Ah;
-  if (battery2_remaining_Ah < 0) battery2_remaining_Ah = 0;
-
-  soc_battery1_percent = 100.0f * (battery1_remaining_Ah / battery1_learned_capacity_Ah);
-  soc_battery2_percent = 100.0f * (battery2_remaining_Ah / battery2_learned_capacity_Ah);
-
-  // --- Update SoH (learned vs nominal capacity) ---
-  soh_battery1_percent = 100.0f * (battery1_learned_capacity_Ah / BATT1_CAPACITY_AH);
-  soh_battery2_percent = 100.0f * (battery2_learned_capacity_Ah / BATT2_CAPACITY_AH);
-  soh_battery1_percent = fminf(fmaxf(soh_battery1_percent, 0.0f), 100.0f);
-  soh_battery2_percent = fminf(fmaxf(soh_battery2_percent, 0.0f), 100.0f);
-
-  // --- Rest detection ---
-  // (unchanged)
+  // --- Rest detection, full charge detection ---
+  for (uint8_t i = 0; i < NUM_BATTERIES; i++) {
+    detectRest(i, nowMs);
+    if (banks.socValid[i]) detectFull(i, nowMs);
+  }
 
-  // --- Full charge detection + learning ---
-  // (unchanged)
+  // --- SoC, SoH (charge is counted per conversion in readSensors) ---
+  updateBankSoc(banks, bankConfig);
 
-  // --- Periodic EEPROM save ---
-  if (millis() - lastEepromSaveMillis >= EEPROM_SAVE_INTERVAL_MS) {
-    eepromMgr.save(battery1_learned_capacity_Ah, battery2_learned_capacity_Ah,
-                   soc_battery1_percent, soc_battery2_percent,
-                   soh_battery1_percent, soh_battery2_percent);
-    lastEepromSaveMillis = millis();
+  // --- Snapshot changed values for the journal ---
+  // `journaled` is only read once the persist stage is done
+  // with the last snapshot
+  if (journal.mounted() && !havePending.load(std::memory_order_acquire)) {
+    PersistState now;
+    currentPersistState(now, nowMs);
+    if (journalDue(now, nowMs)) {
+      pending = now;
+      pendingSinceMs = nowMs;
+      lastJournalSaveMillis = nowMs;
+      havePending.store(true, std::memory_order_release);
+#ifdef PERSIST_INLINE
+      while (havePending.load(std::memory_order_acquire)) persistWrite(true);
+#endif
+    }
   }
+
+  // --- Publish for the NMEA2000 and debug output ---
+  publishBanks(banks, bankSnapshots, nowMs);
 }
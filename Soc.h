@@ -7,8 +7,9 @@
 //
 // Provides:
 //   - Initialization of SOC/SOH system
-//   - EEPROM persistence (wear-leveled slots)
-//   - OCV-based initialization when EEPROM unavailable
+//   - Flash persistence (append-only journal, Journal.h),
+//     written in the background by persistStep()
+//   - OCV-based initialization when nothing is stored
 //   - Coulomb counting updates
 //   - Rest & full charge detection
 //   - Learned capacity adjustment
@@ -16,17 +17,22 @@
 // ===========================================================
 
 // Initialize State of Charge / Health system
-// - Loads EEPROM data (learned capacity, last SOC, last SOH)
+// - Replays the journal (learned capacity, last SOC, last SOH)
 // - Initializes variables for coulomb counting
-// - Falls back to OCV-based SOC if no EEPROM data
+// - Falls back to OCV-based SOC if the journal is empty
 void setupSoc();
 
 // Update State of Charge / Health
-// - Computes SOC using coulomb counting
+// - Computes SOC from the coulomb counter (see readSensors)
 // - Applies temperature-compensated OCV lookup if needed
 // - Updates remaining Ah and learned capacity
 // - Updates State of Health (SoH) based on learned vs nominal capacity
-// - Saves periodically to EEPROM with wear-leveling
+// - Snapshots changed values for the journal (deadband or deadline)
 void updateSoc();
 
+// Write the pending journal snapshot, one flash operation per
+// call, timed around the INA226 conversions. Run as its own
+// stage right after readSensors().
+void persistStep();
+
 #endif // SOC_H
@@ -0,0 +1,76 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <Arduino.h>
+#include <atomic>
+
+// ===========================================================
+// SpscRing.h — Lock-free single-producer / single-consumer ring
+// ===========================================================
+//
+// SpscRing<T, N> hands fixed-size elements from one task to
+// another (one pushes, one pops, possibly on the other core)
+// without a lock or a critical section:
+//   - head is only written by the producer, tail only by the
+//     consumer; each is a free-running 32-bit count, so the
+//     fill is head - tail (wrap-safe) and a slot is count & (N-1)
+//   - the producer writes the slot, then publishes it with a
+//     release store of head; the consumer's acquire load of
+//     head makes the slot visible before it is copied out, and
+//     its release store of tail hands the slot back
+//   - a full ring drops the new element (counted) rather than
+//     overwrite one the consumer may be copying
+// head and tail sit on their own cache lines, so the two
+// cores do not bounce one line on every element. N is a power
+// of two; storage is static (no heap).
+// ===========================================================
+
+#define SPSC_LINE_BYTES 64
+
+template <typename T, size_t N>
+struct SpscRing {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing length must be a power of two");
+
+  // Producer side
+  alignas(SPSC_LINE_BYTES) std::atomic<uint32_t> head{0};   // elements pushed
+  std::atomic<uint32_t> drops{0};     // pushes refused, ring full
+  std::atomic<uint32_t> maxFill{0};   // most elements waiting at once
+
+  // Consumer side
+  alignas(SPSC_LINE_BYTES) std::atomic<uint32_t> tail{0};   // elements popped
+
+  alignas(SPSC_LINE_BYTES) T slot[N];
+
+  // Producer only
+  bool push(const T& v) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    uint32_t fill = h - tail.load(std::memory_order_acquire);
+    if (fill >= N) {
+      drops.store(drops.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return false;
+    }
+    slot[h & (N - 1)] = v;
+    head.store(h + 1, std::memory_order_release);
+    if (fill + 1 > maxFill.load(std::memory_order_relaxed)) maxFill.store(fill + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Consumer only
+  bool pop(T& out) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) return false;
+    out = slot[t & (N - 1)];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Statistics, from either side
+  uint32_t pushes() const { return head.load(std::memory_order_relaxed); }
+  uint32_t fill() const {
+    uint32_t t = tail.load(std::memory_order_acquire);   // tail first: head is then at least t
+    return head.load(std::memory_order_acquire) - t;
+  }
+  static constexpr size_t capacity() { return N; }
+};
+
+#endif // SPSC_RING_H
@@ -0,0 +1,187 @@
+#include "TempBus.h"
+#include <string.h>
+
+// DS18B20 commands
+#define OW_MATCH_ROM      0x55
+#define DS_CONVERT        0x44
+#define DS_READ_SCRATCH   0xBE
+#define DS_WRITE_SCRATCH  0x4E
+
+// Alarm registers, written with the resolution but never
+// copied to EEPROM: reading back anything else means the
+// sensor restarted from its EEPROM values
+#define DS_TH  0x7F
+#define DS_TL  0x80
+
+// Sensor states: the next transaction it needs
+enum { ST_CONFIG, ST_CONVERT, ST_CONVERTING };
+
+// Configuration register: R1 R0 in bits 6..5, the rest read as 1
+static uint8_t configByte(uint8_t bits) { return (uint8_t)(((bits - 9) << 5) | 0x1F); }
+
+uint8_t crc8(const uint8_t* data, size_t len) {
+  uint8_t crc = 0;
+  while (len--) {
+    crc ^= *data++;
+    for (uint8_t b = 0; b < 8; b++) crc = (crc & 1) ? (crc >> 1) ^ 0x8C : crc >> 1;
+  }
+  return crc;
+}
+
+// ==========================
+// Sensors
+// ==========================
+
+void TempBus::setSensor(uint8_t ch, const uint8_t rom[8], uint8_t bits) {
+  TempSensor& s = sensors[ch];
+  memset(&s, 0, sizeof(s));
+  memcpy(s.rom, rom, 8);
+  s.bits = bits < 9 ? 9 : bits > 12 ? 12 : bits;
+  s.state = ST_CONFIG;
+  s.tempC = HAL_TEMP_DISCONNECTED;
+  used[ch] = false;
+  for (uint8_t k = 0; k < 8; k++) used[ch] |= rom[k] != 0;
+}
+
+uint8_t TempBus::discover(const uint8_t* bits) {
+  uint8_t found[NUM_BATTERIES][8];
+  uint8_t n = 0;
+  uint8_t rom[8];
+
+  // Keep the lowest NUM_BATTERIES ROMs, sorted
+  halOneWireSearchReset();
+  while (halOneWireSearch(rom)) {
+    if (rom[0] != DS18B20_FAMILY || crc8(rom, 7) != rom[7]) continue;
+    uint8_t k = n;
+    while (k > 0 && memcmp(rom, found[k - 1], 8) < 0) k--;
+    if (k >= NUM_BATTERIES) continue;
+    uint8_t last = n < NUM_BATTERIES ? n : NUM_BATTERIES - 1;
+    for (uint8_t j = last; j > k; j--) memcpy(found[j], found[j - 1], 8);
+    memcpy(found[k], rom, 8);
+    if (n < NUM_BATTERIES) n++;
+  }
+
+  static const uint8_t none[8] = {};
+  for (uint8_t ch = 0; ch < NUM_BATTERIES; ch++) setSensor(ch, ch < n ? found[ch] : none, bits[ch]);
+  return n;
+}
+
+// ==========================
+// Bus steps
+// ==========================
+
+// Pick the next sensor with a due transaction, round-robin
+void TempBus::startNext() {
+  uint32_t now = halMicros();
+  for (uint8_t k = 0; k < NUM_BATTERIES; k++) {
+    uint8_t c = (nextCh + k) % NUM_BATTERIES;
+    const TempSensor& s = sensors[c];
+    if (!used[c] || now - s.sinceUs < s.waitUs) continue;
+
+    ch = c;
+    nextCh = (c + 1) % NUM_BATTERIES;
+    out[0] = OW_MATCH_ROM;
+    memcpy(out + 1, s.rom, 8);
+    outLen = 10;
+    inLen = 0;
+    if (s.state == ST_CONFIG) {
+      op = OP_CONFIG;
+      out[9]  = DS_WRITE_SCRATCH;
+      out[10] = DS_TH;
+      out[11] = DS_TL;
+      out[12] = configByte(s.bits);
+      outLen = 13;
+    } else if (s.state == ST_CONVERT) {
+      op = OP_CONVERT;
+      out[9] = DS_CONVERT;
+    } else {
+      op = OP_READ;
+      out[9] = DS_READ_SCRATCH;
+      inLen = 9;
+    }
+    active = true;
+    resetDone = false;
+    outPos = 0;
+    inPos = 0;
+    return;
+  }
+}
+
+bool TempBus::step() {
+  if (!active) startNext();
+  if (!active) return false;
+
+  if (!resetDone) {
+    resetDone = true;
+    if (!halOneWireReset()) {
+      sensors[ch].absent++;
+      fail();
+    }
+    return true;
+  }
+
+  if (outPos < outLen) {
+    uint8_t n = outLen - outPos < TEMP_STEP_BYTES ? outLen - outPos : TEMP_STEP_BYTES;
+    halOneWireWrite(out + outPos, n);
+    outPos += n;
+  } else {
+    uint8_t n = inLen - inPos < TEMP_STEP_BYTES ? inLen - inPos : TEMP_STEP_BYTES;
+    halOneWireRead(in + inPos, n);
+    inPos += n;
+  }
+  if (outPos == outLen && inPos == inLen) finish();
+  return true;
+}
+
+void TempBus::finish() {
+  TempSensor& s = sensors[ch];
+  active = false;
+  s.sinceUs = halMicros();
+  s.waitUs = 0;
+
+  if (op == OP_CONFIG) {
+    s.state = ST_CONVERT;
+    return;
+  }
+  if (op == OP_CONVERT) {
+    s.state = ST_CONVERTING;
+    s.waitUs = conversionUs(s.bits);
+    return;
+  }
+
+  // Scratchpad: temp LSB, MSB, TH, TL, config, 3 reserved, CRC
+  bool zeros = true;
+  for (uint8_t k = 0; k < 9; k++) zeros &= in[k] == 0;
+  if (zeros || crc8(in, 8) != in[8]) {
+    s.crcErrors++;
+    fail();
+    return;
+  }
+  int16_t raw = (int16_t)((uint16_t)in[1] << 8 | in[0]);
+  s.state = ST_CONVERT;
+  s.fails = 0;
+  if (in[2] != DS_TH || in[3] != DS_TL || in[4] != configByte(s.bits)) {
+    // Power was lost: 85 °C is the power-on value, not a reading
+    s.reconfigs++;
+    s.state = ST_CONFIG;
+    if (raw == 0x0550) return;
+  }
+  uint8_t bits = 9 + ((in[4] >> 5) & 3);
+  raw &= (int16_t)~((1 << (12 - bits)) - 1);   // undefined below the resolution
+  s.tempC = raw / 16.0f;
+  s.reads++;
+}
+
+// Failed transaction: retry at once, or back off once the
+// sensor is considered disconnected
+void TempBus::fail() {
+  TempSensor& s = sensors[ch];
+  active = false;
+  s.sinceUs = halMicros();
+  s.waitUs = 0;
+  if (s.fails < TEMP_MAX_FAILS) s.fails++;
+  if (s.fails >= TEMP_MAX_FAILS) {
+    s.tempC = HAL_TEMP_DISCONNECTED;
+    s.waitUs = conversionUs(s.bits);
+  }
+}
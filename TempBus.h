@@ -0,0 +1,102 @@
+#ifndef TEMPBUS_H
+#define TEMPBUS_H
+
+#include <Arduino.h>
+#include "Config.h"
+#include "Hal.h"
+
+// ===========================================================
+// TempBus.h — Non-blocking DS18B20 engine on one 1-Wire bus
+// ===========================================================
+//
+// Provides:
+//   - Per-sensor state machine: configure resolution → start
+//     conversion → wait the conversion time of its resolution
+//     → read scratchpad → check CRC → publish
+//   - Bus work sliced into steps of one reset or at most
+//     TEMP_STEP_BYTES bytes (1-Wire slots are timed by the
+//     master, so a transaction can pause between bytes); a
+//     scratchpad read is ~11 short steps instead of one long
+//     blocking call
+//   - Resolution per sensor (9..12 bit: 94 / 188 / 375 /
+//     750 ms), checked on every read and rewritten if the
+//     sensor lost it (a power cycle restores its EEPROM
+//     values; the 85 °C power-on reading is then dropped)
+//   - Sensors at configured ROM addresses, or discovered by a
+//     bus search and assigned in ascending ROM order
+//
+// Every sensor converts on its own (Match ROM), so a 9-bit
+// sensor is read four times as often as a 12-bit one. That
+// needs powered sensors (VDD wired), not parasite power.
+//
+// A reading is published only if its CRC-8 matches and the
+// scratchpad is not all zeros (a bus shorted low reads zeros,
+// which have a valid CRC). TEMP_MAX_FAILS failed transactions
+// in a row (no presence pulse, bad CRC) mark the sensor
+// disconnected; it is then retried once per conversion time
+// until it reads again.
+// ===========================================================
+
+#define DS18B20_FAMILY 0x28
+
+// Dallas/Maxim CRC-8 (poly x^8 + x^5 + x^4 + 1, reflected)
+uint8_t crc8(const uint8_t* data, size_t len);
+
+struct TempSensor {
+  uint8_t  rom[8];
+  uint8_t  bits;             // resolution, 9..12
+  uint8_t  state;
+  uint32_t sinceUs;          // next action is due waitUs after this
+  uint32_t waitUs;           // (conversion time, or retry back-off)
+  float    tempC;            // last good reading, HAL_TEMP_DISCONNECTED if none
+  uint8_t  fails;            // failed transactions in a row
+
+  // Statistics
+  uint32_t reads;
+  uint32_t crcErrors;
+  uint32_t absent;           // resets without presence pulse
+  uint32_t reconfigs;
+};
+
+class TempBus {
+public:
+  // Sensor `ch` at a known ROM address; an all-zero ROM leaves
+  // the channel unused
+  void setSensor(uint8_t ch, const uint8_t rom[8], uint8_t bits);
+  // Search the bus and assign DS18B20s to the channels in ROM
+  // order (blocking, for setup); returns the number found
+  uint8_t discover(const uint8_t* bits);
+
+  // One bus step: a reset or up to TEMP_STEP_BYTES bytes.
+  // False if there was nothing to do.
+  bool step();
+
+  float tempC(uint8_t ch) const { return sensors[ch].tempC; }
+  bool  present(uint8_t ch) const { return used[ch]; }
+  const TempSensor& sensor(uint8_t ch) const { return sensors[ch]; }
+
+  static uint32_t conversionUs(uint8_t bits) { return 750000UL >> (12 - bits); }
+
+private:
+  enum { OP_CONFIG, OP_CONVERT, OP_READ };
+
+  void startNext();
+  void finish();
+  void fail();
+
+  TempSensor sensors[NUM_BATTERIES];
+  bool       used[NUM_BATTERIES] = {};
+  uint8_t    nextCh = 0;
+
+  // Transaction in progress (active = false: bus idle)
+  bool    active = false;
+  bool    resetDone;
+  uint8_t ch;
+  uint8_t op;
+  uint8_t out[13];           // Match ROM + ROM + function + data
+  uint8_t outLen, outPos;
+  uint8_t in[9];             // scratchpad
+  uint8_t inLen, inPos;
+};
+
+#endif // TEMPBUS_H
@@ -0,0 +1,552 @@
+#include "HalHost.h"
+#include "Config.h"
+#include "Ina226.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+// ===========================================================
+// In-memory stand-ins for the ESP32 peripherals
+// ===========================================================
+
+HardwareSerial Serial;
+
+static tNMEA2000 simBus;
+tNMEA2000& NMEA2000 = simBus;
+
+struct SimChannel {
+  float volts;
+  float amps;
+  float tempC;
+  bool  powerPresent;
+  bool  tempPresent;
+  float shuntOhms;
+
+  // INA226 conversion timing
+  uint32_t convPeriodUs;
+  uint64_t convEpochUs;
+  uint64_t convConsumed;   // conversions reported ready so far
+  uint64_t convLastRead;   // conversion index of the last current read
+  uint64_t alertEdgeFor;   // convConsumed when ALERT last fell
+  int      alertPin;
+  uint16_t maskEnable;
+  uint8_t  inaPointer;
+
+  // DS18B20
+  uint8_t  rom[8];
+  uint8_t  th, tl, config;
+  int16_t  tempRaw;          // scratchpad: last finished conversion
+  int16_t  pendingRaw;
+  uint64_t convDoneUs;
+  bool     converting;
+  uint32_t corruptEvery;     // flip a bit in every n-th scratchpad read
+  uint32_t scratchReads;
+};
+
+static const uint16_t INA_CT_US[8]  = { 140, 204, 332, 588, 1100, 2116, 4156, 8244 };
+static const uint16_t INA_AVG_N[8]  = { 1, 4, 16, 64, 128, 256, 512, 1024 };
+
+static uint64_t clockUs = 0;
+static SimChannel channels[SIM_MAX_CHANNELS];
+static SimCounters counters;
+
+// Flash log partition (two sectors, as in partitions.csv)
+static std::vector<uint8_t> flash(2 * HAL_FLASH_SECTOR_SIZE, 0xFF);
+static std::vector<unsigned long> flashErases(2, 0);
+static long flashBudget = -1;   // bytes until a simulated power cut
+static bool flashDead = false;  // power is off
+static uint32_t flashNoise = 12345;
+static uint32_t flashEraseUs = 0, flashProgramUs = 0;   // virtual time per operation
+
+// CAN receive path
+static bool     canAcceptAll = false;
+static uint32_t canReceived = 0, canDropped = 0;
+
+// I²C bus
+static uint32_t i2cClockHz = 100000;
+static uint32_t i2cTimeoutUs = 1000;
+static uint64_t sdaHeldUntilUs = 0;    // hang: SDA low until then
+static bool     sdaGlitch = false;     // slave stuck mid-byte: 9 clocks free it
+
+// 1-Wire bus: what the selected devices expect next
+enum OwMode { OW_IDLE, OW_ROM_CMD, OW_MATCH, OW_FUNCTION, OW_READ, OW_WRITE };
+static OwMode owMode = OW_IDLE;
+static int owSelected = -1;            // channel, SIM_MAX_CHANNELS = all (Skip ROM), -1 = none
+static uint8_t owMatch[8];
+static uint8_t owPos = 0;
+static uint8_t owScratch[9];
+static uint8_t owSearchNext = 0;
+
+static uint8_t simCrc8(const uint8_t* p, size_t len) {
+  uint8_t crc = 0;
+  while (len--) {
+    crc ^= *p++;
+    for (uint8_t b = 0; b < 8; b++) crc = (crc & 1) ? (crc >> 1) ^ 0x8C : crc >> 1;
+  }
+  return crc;
+}
+
+static void resetChannels() {
+  for (SimChannel& c : channels) {
+    c.volts = 0.0f;
+    c.amps = 0.0f;
+    c.tempC = 25.0f;
+    c.powerPresent = true;
+    c.tempPresent = true;
+    c.maskEnable = 0;
+    c.inaPointer = 0;
+    c.alertEdgeFor = UINT64_MAX;
+    c.convPeriodUs = 2 * INA_CT_US[4] * INA_AVG_N[0];  // power-on default
+    c.convEpochUs = 0;
+    c.convConsumed = 0;
+    c.convLastRead = UINT64_MAX;
+    c.alertPin = -1;
+  }
+  // The shunts and DS18B20s of banks 1-4 as configured
+  static const float shunts[4] = { SHUNT1_OHMS, SHUNT2_OHMS, SHUNT3_OHMS, SHUNT4_OHMS };
+  static const uint8_t configured[4][8] = { DS18B20_ADDR1, DS18B20_ADDR2, DS18B20_ADDR3, DS18B20_ADDR4 };
+  for (uint8_t ch = 0; ch < SIM_MAX_CHANNELS; ch++) {
+    SimChannel& c = channels[ch];
+    const uint8_t rom[8] = { 0x28, 0xFF, 0x5B, 0x31, (uint8_t)(0x90 + ch), 0x16, 0x04, 0 };
+    c.shuntOhms = shunts[ch < 4 ? ch : 0];
+    memcpy(c.rom, ch < 4 ? configured[ch] : rom, 8);
+    c.rom[7] = simCrc8(c.rom, 7);
+    c.corruptEvery = 0;
+    c.scratchReads = 0;
+    simTempPowerCycle(ch);
+  }
+  owMode = OW_IDLE;
+  owSelected = -1;
+  sdaHeldUntilUs = 0;
+  sdaGlitch = false;
+}
+
+static struct SimInit { SimInit() { resetChannels(); } } simInit;
+
+// ----- Clock -----
+uint64_t simMicros()                { return clockUs; }
+void     simSetMicros(uint64_t us)  { clockUs = us; }
+void     simAdvanceMicros(uint64_t us) { clockUs += us; }
+
+uint32_t halMillis() { return (uint32_t)(clockUs / 1000ULL); }
+uint32_t halMicros() { return (uint32_t)clockUs; }
+
+void halIdleUntil(uint32_t deadlineUs) {
+  int32_t remaining = (int32_t)(deadlineUs - (uint32_t)clockUs);
+  if (remaining > 0) clockUs += remaining;   // jump the virtual clock
+}
+
+// ----- Tasks -----
+// One thread and one virtual clock: loop() runs every stage,
+// in a reproducible order
+bool halStartTask(const char* name, void (*fn)(), uint8_t core) {
+  (void)name; (void)fn; (void)core;
+  return false;
+}
+
+// ----- Plant -----
+void simSetBattery(uint8_t ch, float volts, float amps, float tempC) {
+  channels[ch].volts = volts;
+  channels[ch].amps = amps;
+  channels[ch].tempC = tempC;
+}
+
+void simSetPowerPresent(uint8_t ch, bool present) { channels[ch].powerPresent = present; }
+void simSetTempPresent(uint8_t ch, bool present)  { channels[ch].tempPresent = present; }
+void simSetTempCorrupt(uint8_t ch, uint32_t every) { channels[ch].corruptEvery = every; }
+
+void simTempPowerCycle(uint8_t ch) {
+  SimChannel& c = channels[ch];
+  c.th = 0x4B;               // EEPROM defaults: 75 / 70 °C, 12 bit
+  c.tl = 0x46;
+  c.config = 0x7F;
+  c.tempRaw = 0x0550;        // power-on value, 85 °C
+  c.converting = false;
+}
+
+const uint8_t* simTempRom(uint8_t ch) { return channels[ch].rom; }
+
+// ----- I²C / INA226 -----
+// Register-level model of one INA226 per channel at its
+// configured address. Transfers take their bit time at the bus
+// clock on the virtual clock; a held SDA line times out.
+
+static const uint8_t inaAddr[4] = { INA226_ADDR1, INA226_ADDR2, INA226_ADDR3, INA226_ADDR4 };
+
+// A harness may set the clock back a little (replays restart
+// at a sample's time after setup's bus traffic)
+static uint64_t conversionIndex(const SimChannel& c) {
+  return clockUs > c.convEpochUs ? (clockUs - c.convEpochUs) / c.convPeriodUs : 0;
+}
+
+uint64_t simPowerConversions(uint8_t ch) { return conversionIndex(channels[ch]); }
+
+void simI2cHoldSda(uint64_t untilUs) { sdaHeldUntilUs = untilUs; }
+void simI2cGlitch()                  { sdaGlitch = true; }
+
+static bool sdaHeld() { return sdaGlitch || clockUs < sdaHeldUntilUs; }
+
+static void busTime(uint32_t bits) {
+  uint64_t us = ((uint64_t)bits * 1000000ULL + i2cClockHz - 1) / i2cClockHz;
+  clockUs += us;
+  counters.i2cBusUs += us;
+}
+
+static int inaChannel(uint8_t addr) {
+  for (uint8_t ch = 0; ch < SIM_MAX_CHANNELS; ch++) {
+    uint8_t a = ch < 4 ? inaAddr[ch] : (uint8_t)(0x48 + ch);
+    if (a == addr) return ch;
+  }
+  return -1;
+}
+
+static void countCurrentRead(uint8_t ch) {
+  counters.currentReads++;
+  uint64_t idx = conversionIndex(channels[ch]);
+  if (idx == channels[ch].convLastRead) counters.duplicateReads++;
+  channels[ch].convLastRead = idx;
+}
+
+static void inaWrite(SimChannel& c, uint8_t reg, uint16_t v) {
+  if (reg == 0x00) {
+    c.convPeriodUs = (uint32_t)(INA_CT_US[(v >> 6) & 7] + INA_CT_US[(v >> 3) & 7]) * INA_AVG_N[(v >> 9) & 7];
+    c.convEpochUs = clockUs;   // writing the config register restarts conversion
+    c.convConsumed = 0;
+    c.convLastRead = UINT64_MAX;
+    c.alertEdgeFor = UINT64_MAX;
+  } else if (reg == 0x06) {
+    c.maskEnable = v & 0xFC1F;
+  }
+}
+
+static uint16_t inaRead(uint8_t ch, uint8_t reg) {
+  SimChannel& c = channels[ch];
+  switch (reg) {
+  case 0x01: {
+    countCurrentRead(ch);
+    long lsb = lround(c.amps * c.shuntOhms / INA226_SHUNT_LSB_V);
+    return (uint16_t)(int16_t)(lsb > 32767 ? 32767 : lsb < -32768 ? -32768 : lsb);
+  }
+  case 0x02: {
+    counters.busVoltageReads++;
+    long lsb = lround(c.volts / INA226_BUS_LSB_V);
+    return (uint16_t)(lsb > 0x7FFF ? 0x7FFF : lsb < 0 ? 0 : lsb);
+  }
+  case 0x06: {
+    // Reading clears the conversion-ready flag (and ALERT)
+    counters.powerFlagReads++;
+    uint64_t idx = conversionIndex(c);
+    bool ready = idx > c.convConsumed;
+    if (ready && c.convConsumed > 0) {
+      // How long the oldest unread conversion waited
+      uint64_t waitUs = clockUs - (c.convEpochUs + (c.convConsumed + 1) * c.convPeriodUs);
+      if (waitUs > counters.maxReadLatencyUs) counters.maxReadLatencyUs = waitUs;
+      if (idx > c.convConsumed + 1) counters.missedConversions += idx - c.convConsumed - 1;
+    }
+    c.convConsumed = idx;
+    return c.maskEnable | (ready ? 0x0008 : 0);
+  }
+  case 0xFE: return 0x5449;   // "TI"
+  case 0xFF: return 0x2260;
+  default:   return 0;
+  }
+}
+
+void halI2cBegin(int, int, uint32_t clockHz, uint32_t timeoutUs) {
+  i2cClockHz = clockHz;
+  i2cTimeoutUs = timeoutUs;
+}
+
+uint8_t halI2cTransfer(uint8_t addr, const uint8_t* out, size_t outLen, uint8_t* in, size_t inLen) {
+  counters.i2cTransfers++;
+  if (sdaHeld()) {
+    clockUs += i2cTimeoutUs;   // the controller waits for the bus
+    return HAL_I2C_TIMEOUT;
+  }
+  int ch = inaChannel(addr);
+  if (ch < 0 || !channels[ch].powerPresent) {
+    busTime(2 + 9);            // START, address NACKed, STOP
+    return HAL_I2C_NACK;
+  }
+  SimChannel& c = channels[ch];
+  busTime(2 + 9 * (1 + outLen) + (inLen ? 1 + 9 * (1 + inLen) : 0));
+  if (outLen >= 1) c.inaPointer = out[0];
+  if (outLen >= 3) inaWrite(c, out[0], (uint16_t)out[1] << 8 | out[2]);
+  if (inLen) {
+    uint16_t v = inaRead(ch, c.inaPointer);
+    for (size_t k = 0; k < inLen; k++) in[k] = k == 0 ? (uint8_t)(v >> 8) : k == 1 ? (uint8_t)v : 0xFF;
+  }
+  return HAL_I2C_OK;
+}
+
+bool halI2cRecover() {
+  counters.i2cRecoveries++;
+  clockUs += 100;              // 9 clocks + STOP, bit-banged at 100 kHz
+  sdaGlitch = false;
+  return !sdaHeld();
+}
+
+// ALERT falls when a conversion finishes with the flag clear;
+// the interrupt latches that time
+void halAlertAttach(uint8_t ch, int pin) { channels[ch].alertPin = pin; }
+
+bool halAlertTake(uint8_t ch, uint32_t& edgeUs) {
+  SimChannel& c = channels[ch];
+  if (c.alertPin < 0 || !(c.maskEnable & 0x0400)) return false;
+  if (conversionIndex(c) <= c.convConsumed || c.alertEdgeFor == c.convConsumed) return false;
+  c.alertEdgeFor = c.convConsumed;
+  edgeUs = (uint32_t)(c.convEpochUs + (c.convConsumed + 1) * c.convPeriodUs);
+  return true;
+}
+
+// ----- 1-Wire / DS18B20 -----
+// Byte-level model of DS18B20s on one bus, one per channel:
+// Match/Skip ROM, Convert T, Read/Write Scratchpad and the ROM
+// search. A conversion latches the plant temperature at its
+// start and lands in the scratchpad after its conversion time.
+static bool owSelects(int ch) {
+  return channels[ch].tempPresent && (owSelected == ch || owSelected == SIM_MAX_CHANNELS);
+}
+
+static void finishConversion(SimChannel& c) {
+  if (c.converting && clockUs >= c.convDoneUs) {
+    c.tempRaw = c.pendingRaw;
+    c.converting = false;
+  }
+}
+
+static uint8_t owScratchByte(uint8_t ch, uint8_t pos) {
+  SimChannel& c = channels[ch];
+  if (pos == 0) {
+    finishConversion(c);
+    owScratch[0] = (uint8_t)c.tempRaw;
+    owScratch[1] = (uint8_t)((uint16_t)c.tempRaw >> 8);
+    owScratch[2] = c.th;
+    owScratch[3] = c.tl;
+    owScratch[4] = c.config;
+    owScratch[5] = 0xFF;
+    owScratch[6] = 0x0C;
+    owScratch[7] = 0x10;
+    owScratch[8] = simCrc8(owScratch, 8);
+    counters.tempReads++;
+    if (c.corruptEvery && ++c.scratchReads % c.corruptEvery == 0) owScratch[c.scratchReads % 9] ^= 0x04;
+  }
+  return owScratch[pos];
+}
+
+static void owCommand(uint8_t b) {
+  switch (owMode) {
+  case OW_ROM_CMD:
+    if (b == 0x55)      { owMode = OW_MATCH; owPos = 0; }
+    else if (b == 0xCC) { owMode = OW_FUNCTION; owSelected = SIM_MAX_CHANNELS; }
+    else                owMode = OW_IDLE;
+    break;
+  case OW_MATCH:
+    owMatch[owPos++] = b;
+    if (owPos < 8) break;
+    owSelected = -1;
+    for (uint8_t ch = 0; ch < SIM_MAX_CHANNELS; ch++)
+      if (channels[ch].tempPresent && !memcmp(channels[ch].rom, owMatch, 8)) owSelected = ch;
+    owMode = owSelected < 0 ? OW_IDLE : OW_FUNCTION;
+    break;
+  case OW_FUNCTION:
+    owPos = 0;
+    owMode = OW_IDLE;
+    if (b == 0xBE) owMode = OW_READ;
+    else if (b == 0x4E) owMode = OW_WRITE;
+    else if (b == 0x44) {
+      counters.tempRequests++;
+      for (uint8_t ch = 0; ch < SIM_MAX_CHANNELS; ch++) {
+        if (!owSelects(ch)) continue;
+        SimChannel& c = channels[ch];
+        uint8_t bits = 9 + ((c.config >> 5) & 3);
+        long raw = lround(c.tempC * 16.0f);
+        c.pendingRaw = (int16_t)(raw & ~((1L << (12 - bits)) - 1));
+        c.convDoneUs = clockUs + (750000ULL >> (12 - bits));
+        c.converting = true;
+      }
+    }
+    break;
+  case OW_WRITE:
+    for (uint8_t ch = 0; ch < SIM_MAX_CHANNELS; ch++) {
+      if (!owSelects(ch)) continue;
+      SimChannel& c = channels[ch];
+      if (owPos == 0) c.th = b;
+      else if (owPos == 1) c.tl = b;
+      else if (owPos == 2) c.config = (uint8_t)((b & 0x60) | 0x1F);
+    }
+    if (++owPos == 3) owMode = OW_IDLE;
+    break;
+  default:
+    break;
+  }
+}
+
+void halOneWireBegin() {}
+
+bool halOneWireReset() {
+  counters.oneWireResets++;
+  clockUs += SIM_ONEWIRE_RESET_US;
+  owMode = OW_ROM_CMD;
+  owSelected = -1;
+  for (const SimChannel& c : channels)
+    if (c.tempPresent) return true;
+  owMode = OW_IDLE;
+  return false;
+}
+
+void halOneWireWrite(const uint8_t* buf, size_t len) {
+  counters.oneWireBytes += len;
+  clockUs += len * SIM_ONEWIRE_BYTE_US;
+  for (size_t i = 0; i < len; i++) owCommand(buf[i]);
+}
+
+void halOneWireRead(uint8_t* buf, size_t len) {
+  counters.oneWireBytes += len;
+  clockUs += len * SIM_ONEWIRE_BYTE_US;
+  for (size_t i = 0; i < len; i++) {
+    bool single = owMode == OW_READ && owSelected >= 0 && owSelected < SIM_MAX_CHANNELS &&
+                  channels[owSelected].tempPresent && owPos < 9;
+    buf[i] = single ? owScratchByte(owSelected, owPos++) : 0xFF;   // idle bus reads 1s
+  }
+}
+
+// The search walks the ROM bits (two reads and a write per
+// bit); the order of the ROMs it finds does not matter here
+void halOneWireSearchReset() { owSearchNext = 0; }
+
+bool halOneWireSearch(uint8_t rom[8]) {
+  while (owSearchNext < SIM_MAX_CHANNELS && !channels[owSearchNext].tempPresent) owSearchNext++;
+  if (owSearchNext >= SIM_MAX_CHANNELS) return false;
+  halOneWireReset();
+  clockUs += 64 * 3 * SIM_ONEWIRE_BYTE_US / 8;
+  memcpy(rom, channels[owSearchNext++].rom, 8);
+  owMode = OW_IDLE;
+  return true;
+}
+
+// ----- CAN -----
+void simCanAcceptAll(bool all) { canAcceptAll = all; }
+
+void simCanReceive(const tN2kMsg& m) {
+  unsigned frames = tNMEA2000::Frames(m);
+  counters.canOffered += frames;
+#ifndef CAN_ACCEPT_ALL
+  if (!canAcceptAll && !halCanAccepts(N2ktoCanID(m.Priority, m.PGN, m.Source, m.Destination))) {
+    counters.canRejected += frames;
+    return;
+  }
+#endif
+  unsigned queued = 0;
+  for (const tN2kMsg& q : simBus.Rx) queued += tNMEA2000::Frames(q);
+  if (queued + frames > CAN_RX_QUEUE_LEN) {
+    canDropped += frames;
+    return;
+  }
+  simBus.Rx.push_back(m);
+}
+
+// The library read frames (from ParseMessages())
+void simCanRead(unsigned frames) {
+  canReceived += frames;
+  clockUs += frames * SIM_CAN_FRAME_US;
+}
+
+HalCanStats halCanStats() { return { canReceived, canDropped }; }
+
+// ----- Flash -----
+std::vector<uint8_t>& simFlash() { return flash; }
+const std::vector<unsigned long>& simFlashErases() { return flashErases; }
+
+void simFlashResize(size_t sectors) {
+  flash.assign(sectors * HAL_FLASH_SECTOR_SIZE, 0xFF);
+  flashErases.assign(sectors, 0);
+}
+
+void simFlashSetTiming(uint32_t eraseUs, uint32_t programUs) {
+  flashEraseUs = eraseUs;
+  flashProgramUs = programUs;
+}
+
+void simFlashPowerCut(long afterBytes) {
+  flashBudget = afterBytes;
+  flashDead = false;
+}
+
+// Consume n units of the power budget; returns how many
+// complete before the cut (the operation that runs out of
+// budget is the one interrupted)
+static size_t flashSpend(size_t n) {
+  if (flashBudget < 0) return n;
+  size_t ok = (size_t)flashBudget < n ? (size_t)flashBudget : n;
+  flashBudget -= ok;
+  if (ok < n) flashDead = true;
+  return ok;
+}
+
+size_t halFlashBegin() { return flash.size(); }
+
+bool halFlashRead(uint32_t addr, void* buf, size_t len) {
+  if ((size_t)addr + len > flash.size()) return false;
+  memcpy(buf, &flash[addr], len);
+  counters.flashReads++;
+  counters.flashReadBytes += len;
+  return true;
+}
+
+bool halFlashProgram(uint32_t addr, const void* buf, size_t len) {
+  if ((size_t)addr + len > flash.size() || flashDead) return false;
+  const uint8_t* p = (const uint8_t*)buf;
+  size_t n = flashSpend(len);
+  for (size_t i = 0; i < n; i++) {
+    if (p[i] & ~flash[addr + i]) counters.flashOverwrites++;   // 0 -> 1 needs an erase
+    flash[addr + i] &= p[i];
+  }
+  counters.flashPrograms++;
+  counters.flashBytes += n;
+  clockUs += flashProgramUs;   // the caller is blocked meanwhile
+  return n == len;
+}
+
+bool halFlashErase(uint32_t sector) {
+  if ((size_t)(sector + 1) * HAL_FLASH_SECTOR_SIZE > flash.size() || flashDead) return false;
+  uint8_t* p = &flash[sector * HAL_FLASH_SECTOR_SIZE];
+  if (flashSpend(1) == 0) {
+    // Interrupted erase: leaves arbitrary content
+    for (size_t i = 0; i < HAL_FLASH_SECTOR_SIZE; i++) {
+      flashNoise = flashNoise * 1103515245u + 12345u;
+      p[i] &= (uint8_t)(flashNoise >> 16) | 0x0F;
+    }
+    return false;
+  }
+  memset(p, 0xFF, HAL_FLASH_SECTOR_SIZE);
+  flashErases[sector]++;
+  clockUs += flashEraseUs;
+  return true;
+}
+
+// ----- Counters / reset -----
+const SimCounters& simCounters() { return counters; }
+
+// Every allocation through new, for the no-heap checks
+void* operator new(size_t n) {
+  counters.heapAllocs++;
+  counters.heapBytes += n;
+  void* p = malloc(n ? n : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+void* operator new[](size_t n) { return operator new(n); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+void simReset() {
+  clockUs = 0;
+  resetChannels();
+  counters = SimCounters();
+  canReceived = canDropped = 0;
+  simBus = tNMEA2000();
+}
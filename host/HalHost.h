@@ -0,0 +1,118 @@
+#ifndef HAL_HOST_H
+#define HAL_HOST_H
+
+// ===========================================================
+// HalHost.h — Host implementation of Hal.h
+// ===========================================================
+//
+// Provides the controls a harness needs to drive the firmware
+// on a workstation:
+//   - Virtual clock (64-bit µs; halMillis/halMicros wrap at 32
+//     bits exactly like on the ESP32)
+//   - Simulated plant per channel (voltage, current, temp)
+//   - INA226s on a register-level I²C bus at their configured
+//     addresses and shunts, with bus time and timeouts on the
+//     virtual clock and injectable SDA faults
+//   - DS18B20s on a byte-level 1-Wire bus, with bus time on the
+//     virtual clock, CRC errors and power cycles on demand
+//   - CAN receive path: the acceptance filter of Hal.h, a
+//     bounded receive queue and the library's per-frame cost
+//     on the virtual clock
+//   - In-memory NOR flash image with erase counters and
+//     simulated power cuts
+//   - Peripheral access counters
+//   - Heap allocation counters (global operator new is
+//     replaced, so every new in the firmware is counted)
+//
+// The NMEA2000 instance is the in-memory bus from
+// mock/NMEA2000.h; sent frames are in NMEA2000.Sent.
+// ===========================================================
+
+#include <stdint.h>
+#include <vector>
+#include "Hal.h"
+
+#define SIM_MAX_CHANNELS 8
+
+// ----- Virtual clock -----
+uint64_t simMicros();
+void     simSetMicros(uint64_t us);
+void     simAdvanceMicros(uint64_t us);
+inline void simAdvanceMillis(uint64_t ms) { simAdvanceMicros(ms * 1000ULL); }
+
+// ----- Plant -----
+void simSetBattery(uint8_t ch, float volts, float amps, float tempC);
+void simSetPowerPresent(uint8_t ch, bool present);  // INA226 answers on I²C
+// I²C faults: SDA held low until a time (every transfer times
+// out, recovery fails until then), or a slave stuck mid-byte
+// that the recovery clocks release
+void simI2cHoldSda(uint64_t untilUs);
+void simI2cGlitch();
+void simSetTempPresent(uint8_t ch, bool present);   // DS18B20 answers on 1-Wire
+void simSetTempCorrupt(uint8_t ch, uint32_t every); // flip a bit in every n-th scratchpad read (0 = off)
+void simTempPowerCycle(uint8_t ch);                 // DS18B20 back to EEPROM config and 85 °C
+const uint8_t* simTempRom(uint8_t ch);
+
+// 1-Wire bus time on the virtual clock (standard speed)
+#define SIM_ONEWIRE_RESET_US  960
+#define SIM_ONEWIRE_BYTE_US   560
+
+// ----- CAN bus -----
+// Another node sends a message: the acceptance filter
+// (halCanAccepts(), off with CAN_ACCEPT_ALL or
+// simCanAcceptAll()) drops it in "hardware", or it waits in
+// NMEA2000.Rx for ParseMessages(), at most CAN_RX_QUEUE_LEN
+// frames; frames beyond that are dropped. Each frame the
+// library reads costs SIM_CAN_FRAME_US on the virtual clock.
+#define SIM_CAN_FRAME_US 30   // tNMEA2000::ParseMessages() per frame, ESP32 @ 240 MHz
+void simCanReceive(const tN2kMsg& m);
+void simCanAcceptAll(bool all);
+
+// ----- Flash image -----
+// Survives simReset() so a harness can model a reboot.
+#define SIM_FLASH_ENDURANCE 100000   // erase cycles per sector (ESP32 SPI NOR)
+
+std::vector<uint8_t>& simFlash();
+const std::vector<unsigned long>& simFlashErases();   // per sector
+void simFlashResize(size_t sectors);                   // erased, counters cleared
+// Power fails after `afterBytes` more programmed bytes (an erase
+// counts as one); the write in progress is left torn, an erase
+// in progress leaves garbage. -1 restores power.
+void simFlashPowerCut(long afterBytes);
+// Virtual time an erase / program blocks the caller (default 0)
+#define SIM_FLASH_ERASE_US    45000   // 4 KB sector, typical SPI NOR
+#define SIM_FLASH_PROGRAM_US  600     // one page program, typical
+void simFlashSetTiming(uint32_t eraseUs, uint32_t programUs);
+
+// ----- Counters -----
+struct SimCounters {
+  unsigned long busVoltageReads;
+  unsigned long currentReads;
+  unsigned long duplicateReads;    // current reads of an already-read conversion
+  unsigned long powerFlagReads;    // Mask/Enable register reads (conversion ready)
+  unsigned long missedConversions; // overwritten by the next one before being read
+  uint64_t      maxReadLatencyUs;  // oldest unread conversion finished -> read
+  unsigned long i2cTransfers;
+  uint64_t      i2cBusUs;          // bus time of completed transfers
+  unsigned long i2cRecoveries;     // recovery sequences clocked
+  unsigned long tempRequests;      // DS18B20 Convert T commands
+  unsigned long tempReads;         // DS18B20 scratchpad reads
+  unsigned long oneWireResets;
+  unsigned long oneWireBytes;
+  unsigned long canOffered;        // frames other nodes sent
+  unsigned long canRejected;       // frames the acceptance filter dropped
+  unsigned long flashReads;
+  unsigned long flashReadBytes;
+  unsigned long flashPrograms;
+  unsigned long flashBytes;
+  unsigned long flashOverwrites;   // programs that needed a 0 -> 1 bit
+  unsigned long heapAllocs;        // operator new calls (harness included)
+  unsigned long heapBytes;
+};
+const SimCounters& simCounters();
+uint64_t simPowerConversions(uint8_t ch);  // INA226 conversions completed so far
+
+// Reset clock, plant and counters (not the flash image)
+void simReset();
+
+#endif // HAL_HOST_H
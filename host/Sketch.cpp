@@ -0,0 +1,5 @@
+// ===========================================================
+// Compiles the Arduino sketch entry points (setup/loop) as a
+// regular translation unit for the host build.
+// ===========================================================
+#include "BatteryMonitor.ino"
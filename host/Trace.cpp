@@ -0,0 +1,176 @@
+#include "Trace.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ===========================================================
+// Recorded trace (CSV)
+// ===========================================================
+
+CsvTrace::CsvTrace(const char* path) {
+  f = fopen(path, "r");
+  if (!f) return;
+  char line[1024];
+  if (!fgets(line, sizeof(line), f)) return;
+  int cols = 1;
+  for (char* p = line; *p; p++) if (*p == ',') cols++;
+  nch = (cols - 1) / 3;
+  if (nch > TRACE_MAX_CHANNELS) nch = TRACE_MAX_CHANNELS;
+}
+
+CsvTrace::~CsvTrace() { if (f) fclose(f); }
+
+bool CsvTrace::next(TraceSample& s) {
+  char line[1024];
+  while (f && fgets(line, sizeof(line), f)) {
+    char* p = line;
+    char* end;
+    s.tMs = strtoull(p, &end, 10);
+    if (end == p) continue;  // blank or comment line
+    p = end;
+    for (int ch = 0; ch < nch; ch++) {
+      s.volts[ch] = strtof(p + 1, &p);
+      s.amps[ch]  = strtof(p + 1, &p);
+      s.tempC[ch] = strtof(p + 1, &p);
+    }
+    return true;
+  }
+  return false;
+}
+
+void writeTraceHeader(FILE* f, int channels) {
+  fprintf(f, "t_ms");
+  for (int ch = 1; ch <= channels; ch++) fprintf(f, ",v%d,i%d,t%d", ch, ch, ch);
+  fprintf(f, "\n");
+}
+
+void writeTraceSample(FILE* f, const TraceSample& s, int channels) {
+  fprintf(f, "%llu", (unsigned long long)s.tMs);
+  for (int ch = 0; ch < channels; ch++)
+    fprintf(f, ",%.4f,%.3f,%.2f", s.volts[ch], s.amps[ch], s.tempC[ch]);
+  fprintf(f, "\n");
+}
+
+// ===========================================================
+// Synthetic boat: house bank (FLA) + start/thruster bank (LFP)
+// ===========================================================
+
+struct CurvePoint { double soc; double v; };
+
+static const CurvePoint PLANT_FLA[] = {
+  {0.00, 11.10},{0.10, 11.50},{0.20, 11.66},{0.30, 11.81},{0.40, 11.96},{0.50, 12.10},
+  {0.60, 12.24},{0.70, 12.37},{0.80, 12.50},{0.90, 12.62},{1.00, 12.73}
+};
+static const CurvePoint PLANT_LFP[] = {
+  {0.00, 12.00},{0.10, 12.90},{0.20, 13.00},{0.30, 13.10},{0.40, 13.15},{0.50, 13.20},
+  {0.60, 13.25},{0.70, 13.30},{0.80, 13.35},{0.90, 13.45},{1.00, 13.60}
+};
+
+static double curve(const CurvePoint* c, size_t n, double soc) {
+  if (soc <= c[0].soc) return c[0].v;
+  for (size_t i = 1; i < n; i++) {
+    if (soc <= c[i].soc) {
+      double t = (soc - c[i-1].soc) / (c[i].soc - c[i-1].soc);
+      return c[i-1].v + t * (c[i].v - c[i-1].v);
+    }
+  }
+  return c[n-1].v;
+}
+
+SyntheticTrace::SyntheticTrace(double days, uint32_t dtMs_, uint32_t seed)
+  : endMs((uint64_t)(days * 86400000.0)), dtMs(dtMs_), rng(seed) {
+  // House bank is aged: nominal 100 Ah (BATT1_CAPACITY_AH), 85 Ah left
+  bank[0] = { 85.0,  0.80, 0.010, 14.4, 1.12, -0.030, 25.0, false, false };
+  bank[1] = { 100.0, 0.90, 0.004, 14.2, 1.03,  0.0,   25.0, true,  false };
+}
+
+double SyntheticTrace::ocv(const PlantBank& b) const {
+  double v = b.lfp ? curve(PLANT_LFP, sizeof(PLANT_LFP)/sizeof(PLANT_LFP[0]), b.soc)
+                   : curve(PLANT_FLA, sizeof(PLANT_FLA)/sizeof(PLANT_FLA[0]), b.soc);
+  v += b.tempCoefV * (b.tempC - 25.0);
+  return b.is24V ? 2.0 * v : v;
+}
+
+// House DC loads: low standby at night, fridge cycling and
+// lights during the day/evening.
+double SyntheticTrace::houseLoadA(double h) {
+  double dtS = dtMs / 1000.0;
+  bool night = h < 6.0;
+  double load = night ? 0.6 : 2.5;
+  if (h >= 18.0 && h < 23.0) load += 4.0;
+
+  fridgeTimerS -= dtS;
+  if (fridgeTimerS <= 0) {
+    fridgeOn = !fridgeOn;
+    fridgeTimerS = (fridgeOn ? 900.0 : 1500.0) * std::uniform_real_distribution<double>(0.8, 1.2)(rng);
+  }
+  if (fridgeOn && !night) load += 4.5;
+  return load;
+}
+
+double SyntheticTrace::solarA(double h, int) const {
+  if (h < 6.0 || h > 20.0) return 0.0;
+  return 25.0 * cloud * sin(M_PI * (h - 6.0) / 14.0);
+}
+
+void SyntheticTrace::step(int ch, double demandA, double chargeAvailA, double dtS, TraceSample& s) {
+  PlantBank& b = bank[ch];
+  double scale = b.is24V ? 2.0 : 1.0;
+  double ocvV = ocv(b);
+
+  // Charge acceptance falls off as the bank approaches full,
+  // which gives the charger its CV/tail-current phase.
+  double rPol = b.lfp ? 0.004 / (1.005 - b.soc) : 0.02 / (1.02 - b.soc);
+  double acceptA = fmax(0.0, (b.absorbV * scale - ocvV) / (b.rOhm + rPol));
+  double chargeA = fmin(chargeAvailA, acceptA);
+  double netA = demandA - chargeA;
+
+  double eff = b.lfp ? 0.99 : 0.95;
+  double i20 = b.capacityAh / 20.0;
+  double peukert = netA > i20 ? pow(netA / i20, b.peukertExp - 1.0) : 1.0;
+  double dAh = (netA > 0 ? netA * peukert : netA * eff) * dtS / 3600.0;
+  b.soc = fmin(1.0, fmax(0.0, b.soc - dAh / b.capacityAh));
+
+  double v = ocvV - netA * b.rOhm - (netA < 0 ? netA * rPol : 0.0);
+  std::normal_distribution<double> vNoise(0.0, 0.003 * scale), iNoise(0.0, 0.03);
+  s.volts[ch] = (float)(v + vNoise(rng));
+  s.amps[ch]  = (float)(netA + iNoise(rng));
+}
+
+bool SyntheticTrace::next(TraceSample& s) {
+  if (tMs > endMs) return false;
+  double dtS = dtMs / 1000.0;
+  int day = (int)(tMs / 86400000ULL);
+  double h = (tMs % 86400000ULL) / 3600000.0;
+
+  if (day != lastDay) {
+    cloud = std::uniform_real_distribution<double>(0.3, 1.0)(rng);
+    lastDay = day;
+  }
+
+  // Every third day the engine runs 09:00–10:30: crank, thruster
+  // bursts when leaving and docking, alternator charging.
+  bool engineDay = (day % 3) == 1;
+  bool engineOn = engineDay && h >= 9.0 && h < 10.5;
+  double crank = (engineDay && h >= 9.0 && h < 9.0 + 3.0 / 3600.0) ? 150.0 : 0.0;
+  bool thruster = engineDay && ((h >= 9.02 && h < 9.02 + 20.0 / 3600.0) ||
+                                (h >= 10.45 && h < 10.45 + 20.0 / 3600.0));
+  double alternatorA = engineOn && crank == 0.0 ? 40.0 : 0.0;
+
+  // One day a week in the marina: shore charger on the house bank
+  double shoreA = (day % 7) == 5 ? 30.0 : 0.0;
+
+  double tAir = 18.0 + 6.0 * sin(2.0 * M_PI * (h - 9.0) / 24.0);
+  bank[0].tempC = tAir + 1.0;
+  bank[1].tempC = tAir + 3.0;
+
+  s.tMs = tMs;
+  step(0, houseLoadA(h), solarA(h, day) + alternatorA + shoreA, dtS, s);
+  step(1, 0.05 + crank + (thruster ? 120.0 : 0.0), alternatorA * 0.75, dtS, s);
+
+  s.tempC[0] = (float)bank[0].tempC;
+  s.tempC[1] = (float)bank[1].tempC;
+
+  tMs += dtMs;
+  return true;
+}
@@ -0,0 +1,97 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// ===========================================================
+// Trace.h — Sample sources for replaying the SoC pipeline
+// ===========================================================
+//
+// Provides:
+//   - TraceSample: one timestamped V/I/T reading per channel
+//   - CsvTrace: recorded traces (t_ms,v1,i1,t1,v2,i2,t2,...)
+//   - SyntheticTrace: a plant model of a boat's banks that
+//     generates months of load/solar/engine/shore cycles and keeps
+//     the true SoC for ground truth
+//
+// Current follows the firmware convention: positive =
+// discharge, negative = charge.
+// ===========================================================
+
+#include <stdint.h>
+#include <stdio.h>
+#include <random>
+
+#define TRACE_MAX_CHANNELS 8
+
+struct TraceSample {
+  uint64_t tMs;
+  float volts[TRACE_MAX_CHANNELS];
+  float amps[TRACE_MAX_CHANNELS];
+  float tempC[TRACE_MAX_CHANNELS];
+};
+
+class TraceSource {
+public:
+  virtual ~TraceSource() {}
+  virtual bool next(TraceSample& s) = 0;   // false at end of trace
+  virtual int channels() const = 0;
+  // True state of charge (0..100) if the source knows it, else < 0
+  virtual double trueSocPercent(int) const { return -1.0; }
+  virtual double trueCapacityAh(int) const { return -1.0; }
+};
+
+// ----- Recorded trace -----
+class CsvTrace : public TraceSource {
+public:
+  explicit CsvTrace(const char* path);
+  ~CsvTrace();
+  bool ok() const { return f != nullptr && nch > 0; }
+  bool next(TraceSample& s) override;
+  int channels() const override { return nch; }
+private:
+  FILE* f = nullptr;
+  int nch = 0;
+};
+
+// ----- Plant model -----
+struct PlantBank {
+  double capacityAh;     // true capacity
+  double soc;            // 0..1
+  double rOhm;           // internal resistance
+  double absorbV;        // charger CV setpoint
+  double peukertExp;     // rate-capacity effect above the 20 h rate
+  double tempCoefV;      // OCV shift per °C from 25 °C (12V reference)
+  double tempC;
+  bool   lfp;            // OCV curve selection
+  bool   is24V;
+};
+
+class SyntheticTrace : public TraceSource {
+public:
+  SyntheticTrace(double days, uint32_t dtMs, uint32_t seed);
+  bool next(TraceSample& s) override;
+  int channels() const override { return 2; }
+  double trueSocPercent(int ch) const override { return bank[ch].soc * 100.0; }
+  double trueCapacityAh(int ch) const override { return bank[ch].capacityAh; }
+
+  PlantBank bank[2];
+private:
+  double ocv(const PlantBank& b) const;
+  double houseLoadA(double hourOfDay);
+  double solarA(double hourOfDay, int day) const;
+  void   step(int ch, double demandA, double chargeAvailA, double dtS, TraceSample& s);
+
+  uint64_t tMs = 0;
+  uint64_t endMs;
+  uint32_t dtMs;
+  std::mt19937 rng;
+  double fridgeTimerS = 0;
+  bool   fridgeOn = false;
+  double cloud = 1.0;
+  int    lastDay = -1;
+};
+
+// ----- Recorder -----
+void writeTraceHeader(FILE* f, int channels);
+void writeTraceSample(FILE* f, const TraceSample& s, int channels);
+
+#endif // TRACE_H
@@ -0,0 +1,138 @@
+// ===========================================================
+// bmbanks — per-bank update cost vs. bank count
+// ===========================================================
+//
+// Runs the per-sample pipeline (processBankSamples(),
+// checkBankFaults(), integrateBanks(), predictBanks(),
+// updateBankSoc(), publishBanks()) on
+// BatteryTable<N> for N = 1..8 and reports the cost per pass
+// and per bank, to check that the cost grows linearly with
+// the number of banks. Banks beyond the configured ones
+// reuse bankConfig[] round-robin. bmbanks_fixed is the same
+// with the integer counter (COULOMB_FIXED_POINT), bmbanks_ekf
+// with the model-based estimator (SOC_ESTIMATOR_EKF) in the
+// pipeline; the difference to bmbanks is the filter's cost
+// per conversion.
+//
+// Also reports, per configured bank, the Peukert lookup
+// table's worst-case error against powf() and the cost of
+// both.
+//
+//   bmbanks [--passes P]
+// ===========================================================
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include "Globals.h"
+
+static float peukertExact(const BankConfig& c, float a) {
+  float i20 = c.capacityAh / 20.0f;
+  return a > i20 ? a * powf(a / i20, c.peukertExp - 1.0f) : a;
+}
+
+static float peukertTable(const BatteryTable<NUM_BATTERIES>& t, size_t i, float a) {
+#ifdef COULOMB_FIXED_POINT
+  return effectiveCurrentQ(t, i, llroundf(a * 65536.0f)) * (1.0f / 65536.0f);
+#else
+  return effectiveCurrent(t, bankConfig[i], i, a);
+#endif
+}
+
+static void benchPeukert(unsigned long passes) {
+  static BatteryTable<NUM_BATTERIES> t;
+  initBanks(t, bankConfig);
+
+  for (size_t i = 0; i < NUM_BATTERIES; i++) {
+    const BankConfig& c = bankConfig[i];
+    double maxErr = 0, atA = 0;
+    for (float a = 0.01f; a <= c.shuntMaxA; a += 0.01f) {
+      double err = fabs(peukertTable(t, i, a) / peukertExact(c, a) - 1.0);
+      if (err > maxErr) { maxErr = err; atA = a; }
+    }
+
+    volatile float sink = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (unsigned long p = 0; p < passes; p++) sink = sink + peukertTable(t, i, (p & 1023) * 0.17f);
+    auto t1 = std::chrono::steady_clock::now();
+    for (unsigned long p = 0; p < passes; p++) sink = sink + peukertExact(c, (p & 1023) * 0.17f);
+    auto t2 = std::chrono::steady_clock::now();
+
+    printf("peukert B%zu k=%.2f  max error %.2e @ %.1f A  table %.1f ns  powf %.1f ns\n",
+           i + 1, c.peukertExp, maxErr, atA,
+           std::chrono::duration<double, std::nano>(t1 - t0).count() / passes,
+           std::chrono::duration<double, std::nano>(t2 - t1).count() / passes);
+  }
+}
+
+template <size_t N>
+static void benchBanks(unsigned long passes) {
+  static BatteryTable<N> t;
+  static Seqlock<BankSnapshot> snaps[N];
+  BankConfig cfg[N];
+  for (size_t i = 0; i < N; i++) cfg[i] = bankConfig[i % NUM_BATTERIES];
+  initBanks(t, cfg);
+
+  for (size_t i = 0; i < N; i++) {
+#ifdef COULOMB_FIXED_POINT
+    t.busRaw[i]   = (uint16_t)(10080 + 8 * i);   // 12.6 V
+    t.shuntRaw[i] = (int16_t)(300 - 50 * i);     // 3 A at 0.25 mOhm
+#else
+    t.raw_voltage[i] = 12.6f + 0.01f * i;
+    t.raw_current[i] = 3.0f - 0.5f * i;
+#endif
+    t.raw_temp_C[i]  = 20.0f + i;
+    t.fresh[i] = true;
+    t.socValid[i] = true;
+  }
+
+  volatile float sink = 0;   // keeps the loop from being optimized out
+  auto t0 = std::chrono::steady_clock::now();
+  for (unsigned long p = 0; p < passes; p++) {
+#ifdef COULOMB_FIXED_POINT
+    t.shuntRaw[p % N] += ((p / N) & 1) ? 1 : -1;   // keep the inputs moving
+#else
+    t.raw_current[p % N] += ((p / N) & 1) ? 0.01f : -0.01f;
+#endif
+    for (size_t i = 0; i < N; i++) t.sampleUs[i] += 75264;   // one conversion
+    processBankSamples(t, cfg);
+    checkBankFaults(t, cfg, (uint32_t)p);
+    integrateBanks(t, cfg);
+#ifdef SOC_ESTIMATOR_EKF
+    estimateBanks(t, cfg);
+#endif
+    predictBanks(t, cfg);
+    updateBankSoc(t, cfg);
+    publishBanks(t, snaps, (uint32_t)p);
+    sink = sink + t.soc_percent[N - 1];
+  }
+  auto t1 = std::chrono::steady_clock::now();
+
+  double ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / passes;
+  printf("N=%zu  %8.1f ns/pass  %6.1f ns/bank  table %5zu B\n",
+         N, ns, ns / N, sizeof(BatteryTable<N>));
+}
+
+int main(int argc, char** argv) {
+  unsigned long passes = 2000000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--passes") && i + 1 < argc) passes = strtoul(argv[++i], nullptr, 10);
+    else {
+      fprintf(stderr, "usage: %s [--passes P]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  benchBanks<1>(passes);
+  benchBanks<2>(passes);
+  benchBanks<3>(passes);
+  benchBanks<4>(passes);
+  benchBanks<5>(passes);
+  benchBanks<6>(passes);
+  benchBanks<7>(passes);
+  benchBanks<8>(passes);
+  benchPeukert(passes);
+  return 0;
+}
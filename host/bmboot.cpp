@@ -0,0 +1,235 @@
+// ===========================================================
+// bmboot — time to the first valid SoC after a reset
+// ===========================================================
+//
+// Every firmware run happens in a forked child of a process
+// that never ran the firmware, so each boot starts from zeroed
+// globals exactly like after a reset. Only the flash image is
+// handed from one run to the next (through a pipe).
+//
+// Runs:
+//   operate    empty flash, house bank discharging at 5 A and
+//              LFP bank charging at 3 A for --hours; its
+//              journal is the one the boots below start from
+//   cold       empty flash: SoC from OCV
+//   warm       house bank at rest, voltage within
+//              SOC_RESUME_TOLERANCE of the journaled SoC:
+//              the journaled state resumes
+//   warm-load  same, house bank under load with its voltage
+//              sagging: OCV is not trusted, the journal resumes
+//   stale      house bank at rest, voltage far below the
+//              journaled SoC (discharged while off): OCV wins
+//
+// For each boot it reports the virtual time from reset until
+// PGN 127506 has carried a SoC for every bank, the SoC and Wh
+// published, the flash read by the journal mount and the wall-
+// clock cost of setup().
+//
+// --check fails if a boot takes longer than SOC_BOOT_BUDGET_MS
+// or resumes a different SoC than the firmware had before the
+// reset (or the stale journal instead of OCV).
+//
+//   bmboot [--hours H] [--check]
+// ===========================================================
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "HalHost.h"
+#include "Config.h"
+#include "Globals.h"
+
+void setup();
+void loop();
+
+#define BOOT_TIMEOUT_MS 10000
+
+struct Plant { float v[2]; float a[2]; float tempC; };
+
+struct RunResult {
+  bool     ok;
+  uint32_t validMs;                 // first PGN 127506 with every SoC (boot runs)
+  int      publishedSoc[NUM_BATTERIES];
+  float    soc[NUM_BATTERIES];      // firmware state at the end of the run
+  float    wh[NUM_BATTERIES];
+  unsigned long mountReadBytes;
+  unsigned long mountReads;
+  double   setupUs;
+};
+
+static void applyPlant(const Plant& p) {
+  for (uint8_t ch = 0; ch < NUM_BATTERIES && ch < 2; ch++) simSetBattery(ch, p.v[ch], p.a[ch], p.tempC);
+}
+
+static void runSetup(RunResult& r) {
+  auto t0 = std::chrono::steady_clock::now();
+  setup();
+  r.setupUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+  r.mountReadBytes = simCounters().flashReadBytes;
+  r.mountReads = simCounters().flashReads;
+}
+
+static void captureState(RunResult& r) {
+  for (uint8_t i = 0; i < NUM_BATTERIES; i++) {
+    r.soc[i] = banks.soc_percent[i];
+    r.wh[i] = banks.remaining_Wh[i];
+  }
+}
+
+// Firmware running normally for a while
+static void operate(const Plant& p, double hours, RunResult& r) {
+  NMEA2000.Record = false;
+  applyPlant(p);
+  runSetup(r);
+  uint64_t endUs = (uint64_t)(hours * 3.6e9);
+  while (simMicros() < endUs) loop();
+  captureState(r);
+  r.ok = true;
+}
+
+// Reset: run until every bank's SoC was on the bus
+static void boot(const Plant& p, RunResult& r) {
+  bool seen[NUM_BATTERIES] = {};
+  uint8_t pending = NUM_BATTERIES;
+  applyPlant(p);
+  runSetup(r);
+  while (pending > 0 && simMicros() < BOOT_TIMEOUT_MS * 1000ULL) {
+    loop();
+    for (const tN2kMsg& m : NMEA2000.Sent) {
+      uint8_t inst = m.Data[1];
+      if (m.PGN != 127506L || inst >= NUM_BATTERIES || seen[inst] || m.Data[3] == N2kUInt8NA) continue;
+      seen[inst] = true;
+      pending--;
+      r.publishedSoc[inst] = m.Data[3];
+      r.validMs = m.MsgTime;
+    }
+    NMEA2000.Sent.clear();
+  }
+  captureState(r);
+  r.ok = pending == 0;
+}
+
+// Run fn in a pristine child on the given flash image; returns
+// its result and the flash image it left
+template <typename Fn>
+static RunResult runChild(std::vector<uint8_t>& image, Fn fn) {
+  RunResult r = {};
+  int fd[2];
+  if (pipe(fd) != 0) { perror("pipe"); exit(2); }
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid < 0) { perror("fork"); exit(2); }
+  if (pid == 0) {
+    close(fd[0]);
+    simFlash() = image;
+    simFlashSetTiming(SIM_FLASH_ERASE_US, SIM_FLASH_PROGRAM_US);
+    fn(r);
+    bool ok = write(fd[1], &r, sizeof(r)) == (ssize_t)sizeof(r) &&
+              write(fd[1], simFlash().data(), simFlash().size()) == (ssize_t)simFlash().size();
+    _exit(ok ? 0 : 1);
+  }
+  close(fd[1]);
+  std::vector<uint8_t> buf;
+  uint8_t chunk[4096];
+  ssize_t n;
+  while ((n = read(fd[0], chunk, sizeof(chunk))) > 0) buf.insert(buf.end(), chunk, chunk + n);
+  close(fd[0]);
+  int status = 0;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || buf.size() != sizeof(r) + image.size()) {
+    fprintf(stderr, "child run failed\n");
+    exit(2);
+  }
+  memcpy(&r, buf.data(), sizeof(r));
+  image.assign(buf.begin() + sizeof(r), buf.end());
+  return r;
+}
+
+static void printBoot(const char* name, const RunResult& r) {
+  printf("%-10s: ", name);
+  if (!r.ok) {
+    printf("no valid SoC within %d ms\n", BOOT_TIMEOUT_MS);
+    return;
+  }
+  printf("SoC valid at %4u ms, published", r.validMs);
+  for (uint8_t i = 0; i < NUM_BATTERIES; i++) printf(" %3d %%", r.publishedSoc[i]);
+  printf(", Wh");
+  for (uint8_t i = 0; i < NUM_BATTERIES; i++) printf(" %6.1f", r.wh[i]);
+  printf(", mount %lu reads / %lu B, setup %.0f us\n", r.mountReads, r.mountReadBytes, r.setupUs);
+}
+
+int main(int argc, char** argv) {
+  double hours = 1.0;
+  bool check = false;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--hours") && i + 1 < argc) hours = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--check")) check = true;
+    else {
+      fprintf(stderr, "usage: %s [--hours H] [--check]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  // Lead-acid house bank (FLA) and LiFePO4 bank, as in bmhost
+  const Plant running  = { { 12.55f, 13.25f }, { 5.0f, -3.0f }, 22.0f };
+  const Plant atRest   = { { 12.55f, 13.25f }, { 0.3f,  0.0f }, 22.0f };
+  const Plant underLoad = { { 12.10f, 13.25f }, { 40.0f, -3.0f }, 22.0f };
+  const Plant drained  = { { 12.00f, 13.25f }, { 0.3f,  0.0f }, 22.0f };
+
+  std::vector<uint8_t> empty(simFlash().size(), 0xFF);
+  std::vector<uint8_t> image = empty;
+  RunResult op = runChild(image, [&](RunResult& r) { operate(running, hours, r); });
+  printf("operate   : %.1f h, SoC before reset", hours);
+  for (uint8_t i = 0; i < NUM_BATTERIES; i++) printf(" %.1f %%", op.soc[i]);
+  printf(", Wh");
+  for (uint8_t i = 0; i < NUM_BATTERIES; i++) printf(" %.1f", op.wh[i]);
+  printf("\n");
+
+  std::vector<uint8_t> flash = empty;
+  RunResult cold = runChild(flash, [&](RunResult& r) { boot(atRest, r); });
+  flash = image;
+  RunResult warm = runChild(flash, [&](RunResult& r) { boot(atRest, r); });
+  flash = image;
+  RunResult warmLoad = runChild(flash, [&](RunResult& r) { boot(underLoad, r); });
+  flash = image;
+  RunResult stale = runChild(flash, [&](RunResult& r) { boot(drained, r); });
+
+  printBoot("cold", cold);
+  printBoot("warm", warm);
+  printBoot("warm-load", warmLoad);
+  printBoot("stale", stale);
+  printf("budget    : %d ms\n", SOC_BOOT_BUDGET_MS);
+
+  if (!check) return 0;
+  bool pass = true;
+  const RunResult* boots[] = { &cold, &warm, &warmLoad, &stale };
+  const char* names[] = { "cold", "warm", "warm-load", "stale" };
+  for (int b = 0; b < 4; b++) {
+    if (!boots[b]->ok || boots[b]->validMs > SOC_BOOT_BUDGET_MS) {
+      printf("FAIL %s boot over the %d ms budget\n", names[b], SOC_BOOT_BUDGET_MS);
+      pass = false;
+    }
+  }
+  // The journal lags by up to its deadband, the bus truncates to 1 %
+  float tol = JOURNAL_SOC_DEADBAND_PCT + 1.0f;
+  for (const RunResult* r : { &warm, &warmLoad }) {
+    for (uint8_t i = 0; i < NUM_BATTERIES; i++) {
+      if (fabsf(r->publishedSoc[i] - op.soc[i]) > tol || fabsf(r->wh[i] - op.wh[i]) > op.wh[i] * 0.05f) {
+        printf("FAIL %s boot bank %d resumed %d %% / %.1f Wh, had %.1f %% / %.1f Wh\n",
+               r == &warm ? "warm" : "warm-load", i + 1, r->publishedSoc[i], r->wh[i], op.soc[i], op.wh[i]);
+        pass = false;
+      }
+    }
+  }
+  if (fabsf(stale.publishedSoc[0] - op.soc[0]) <= SOC_RESUME_TOLERANCE) {
+    printf("FAIL stale boot kept the journaled SoC (%d %%)\n", stale.publishedSoc[0]);
+    pass = false;
+  }
+  printf(pass ? "PASS\n" : "FAIL\n");
+  return pass ? 0 : 1;
+}
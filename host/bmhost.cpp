@@ -0,0 +1,672 @@
+// ===========================================================
+// bmhost — run the firmware setup()/loop() on the host
+// ===========================================================
+//
+// Drives the sketch with a constant plant on the virtual
+// clock for a given virtual duration and reports the
+// wall-clock cost of each loop() pass plus the scheduler's
+// per-stage statistics, so regressions show up without a
+// board.
+//
+// Flash operations take their typical time on the virtual
+// clock, and the INA226 model reports the worst latency from
+// conversion to read and any conversions lost to a stall.
+// --stress swings the house bank between 60 A discharge and
+// charge every 30 min, so the journal writes every minute and
+// rotates every few hours at varying phases to the INA226
+// conversions. --prefill fills the journal so the first write has to erase
+// a sector, --erase-us overrides the erase time (datasheet
+// maximum is several hundred ms); --check-stall fails if a
+// conversion was lost.
+// Heap allocations are counted in setup() and in loop();
+// --check-heap fails if the firmware allocated at all.
+// The DS18B20s sit on a simulated 1-Wire bus whose bus time
+// runs on the virtual clock. --temp-faults corrupts every 5th
+// scratchpad read and power-cycles each sensor every 10 min;
+// --check-temp fails if a stage held the bus longer than
+// TEMP_HOLD_MAX_US, a bank got no temperature, or a value other
+// than the plant's (CRC error, 85 °C power-on) got through.
+// The INA226s sit on a register-level I²C bus. --i2c-faults
+// makes a sensor hang mid-byte every 5 min (the recovery clocks
+// free it) and holds SDA low for 3 s every 20 min; --check-i2c
+// fails if the sensor stage ran longer than I2C_HOLD_MAX_US,
+// the SoC stage lost a slot, a fault was not recovered, or
+// sampling did not resume after the faults.
+// --load-step raises the house bank load from 5 A to 20 A at
+// half time; --check-runtime decodes every PGN 127506 sent and
+// fails if its time remaining is off the bank's remaining /
+// effective current by more than RUNTIME_TOL_PCT (or has not
+// settled RUNTIME_SETTLE_MAX_S after the step), or if the
+// ripple or remaining capacity fields are wrong.
+// --check-nmea fails if more than NMEA_FRAMES_PER_POLL frames
+// left in one millisecond, a PGN went out more than
+// NMEA_LATE_MAX_MS past its maximum interval, or (with
+// --load-step) the step took longer than NMEA_STEP_MAX_MS to
+// show in PGN 127508.
+// --iso-requests has another node (address 0x22) request
+// PGNs 127513, 127506, 126996 (product information), 126983
+// (alerts: the NAK while none is active) and an unsupported
+// one right after boot and every 5 min;
+// --check-iso fails if an answer (every instance, or the NAK)
+// took longer than ISO_ANSWER_MAX_MS or never came, or if a
+// 127513 does not decode to the bank's configuration.
+// --bus-load puts a busy backbone on the CAN bus (heading,
+// GNSS, two engines, wind, 100 AIS targets/s, heartbeats,
+// address claims, requests to other nodes: about 40 % of
+// 250 kbit/s); --no-can-filter receives it all, as without an
+// acceptance filter. --check-can fails if the filter lets
+// through a PGN the node does not handle or blocks one it
+// does, a frame was dropped, or a ParseMessages() call took
+// longer than CAN_PARSE_MAX_US.
+// --faults drives the plant past the fault limits: a one
+// conversion dip, low voltage on the house bank, over-current
+// on bank 2, over-temperature, and over-voltage that falls
+// back into the hysteresis band before it clears.
+// --check-faults fails if a fault was raised or cleared other
+// than expected, detection took longer than the debounce
+// allows, or its PGN 126983 left more than ALERT_FRAME_MAX_MS
+// after detection.
+// bmhost_inline is the same with PERSIST_INLINE.
+//
+//   bmhost [--seconds S] [--debug] [--stress] [--prefill]
+//          [--erase-us US] [--check-stall] [--check-heap]
+//          [--temp-faults] [--check-temp]
+//          [--i2c-faults] [--check-i2c]
+//          [--load-step] [--check-runtime] [--check-nmea]
+//          [--iso-requests] [--check-iso]
+//          [--bus-load] [--no-can-filter] [--check-can]
+//          [--faults] [--check-faults]
+// ===========================================================
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "HalHost.h"
+#include "Config.h"
+#include "Journal.h"
+#include "Scheduler.h"
+#include "Globals.h"
+#include "Sensors.h"
+#include "TempBus.h"
+#include "I2cBus.h"
+#include "Nmea.h"
+#include "Ina226.h"
+#include <N2kMessages.h>
+
+#define TEMP_HOLD_MAX_US 2000   // one reset or TEMP_STEP_BYTES bytes fit easily
+#define I2C_HOLD_MAX_US  (I2C_TIMEOUT_US + 2000)   // one timeout + recovery + a normal pass
+#define RUNTIME_TOL_PCT      2.0   // time remaining vs remaining Ah / load
+#define RUNTIME_SETTLE_MAX_S 180   // after a load step
+#define NMEA_LATE_MAX_MS     100   // a few nmea stage periods
+#define NMEA_STEP_MAX_MS     500   // current filter + NMEA_508_MIN_MS
+#define ISO_ANSWER_MAX_MS    100   // one frame per nmea stage run
+#define ISO_UNSUPPORTED_PGN  130306L   // wind data
+#define CAN_PARSE_MAX_US     200   // a few system frames per nmea stage run
+#define ALERT_FRAME_MAX_MS   (2000 / NMEA_POLL_HZ)   // next nmea stage run, one run of slack
+#define TEMP_READ_MAX_MS     1500  // DS18B20 reading period, 12 bit, in temp stage steps
+
+// Fault transitions --faults must cause, with the plant edge
+// behind each (seconds after start)
+struct FaultExpect {
+  double atS;
+  uint8_t bank, fault;
+  bool raise;
+};
+
+static const FaultExpect faultExpect[] = {
+  {  900, 0, FAULT_VOLT_LOW,  true  }, {  930, 0, FAULT_VOLT_LOW,  false },
+  { 1200, 1, FAULT_CURR_HIGH, true  }, { 1210, 1, FAULT_CURR_HIGH, false },
+  { 1500, 0, FAULT_TEMP_HIGH, true  }, { 1560, 0, FAULT_TEMP_HIGH, false },
+  { 1800, 1, FAULT_VOLT_HIGH, true  }, { 1840, 1, FAULT_VOLT_HIGH, false },
+};
+#define FAULT_EXPECTED (sizeof(faultExpect) / sizeof(faultExpect[0]))
+
+// Plant of --faults at t seconds (the house bank dips below
+// its minimum for less than one conversion at 600 s, which
+// must not trip; bank 2 sits in the over-voltage hysteresis
+// band from 1820 s to 1840 s, which must not clear)
+static void faultPlant(double t, float* tempC) {
+  double dipS = inaConversionUs(0) * 0.9e-6;
+  float v0 = 12.55f, a0 = 5.0f, v1 = 13.25f, a1 = -2.0f;
+  tempC[0] = 22.0f;
+  tempC[1] = 24.0f;
+  if ((t >= 600 && t < 600 + dipS) || (t >= 900 && t < 930)) v0 = 10.0f;
+  if (t >= 1200 && t < 1210) a1 = -170.0f;
+  if (t >= 1500 && t < 1560) tempC[0] = 65.0f;
+  if (t >= 1800 && t < 1820) v1 = 14.8f;
+  else if (t >= 1820 && t < 1840) v1 = 14.5f;
+  simSetBattery(0, v0, a0, tempC[0]);
+  simSetBattery(1, v1, a1, tempC[1]);
+}
+
+// A fault transition seen in the bank table, until its alert
+// goes out
+struct FaultSeen {
+  uint8_t bank, fault;
+  bool raise;
+  uint32_t detectMs;
+};
+
+// An ISO request sent to the monitor and the answers seen so far
+struct IsoPending {
+  unsigned long pgn;
+  uint64_t atUs;
+  unsigned answered;      // bit per instance (one bit for single answers)
+  unsigned expected;
+};
+
+static void isoRequest(std::vector<IsoPending>& pending, unsigned long pgn, bool perInstance) {
+  tN2kMsg m;
+  m.SetPGN(59904L);
+  m.Source = 0x22;
+  m.Add3ByteInt((int32_t)pgn);
+  simCanReceive(m);
+  pending.push_back({ pgn, simMicros(), 0, perInstance ? (1u << NUM_BATTERIES) - 1 : 1u });
+}
+
+// Other nodes' traffic (--bus-load)
+struct BusTraffic {
+  unsigned long pgn;
+  uint8_t prio, src, dest, len;
+  uint32_t periodMs;
+};
+
+static const BusTraffic busTraffic[] = {
+  { 127250L, 2, 0x10, 0xff,  8,   100 },   // heading
+  { 127251L, 2, 0x10, 0xff,  8,   100 },   // rate of turn
+  { 127257L, 3, 0x10, 0xff,  8,   100 },   // attitude
+  { 127245L, 2, 0x11, 0xff,  8,   100 },   // rudder
+  { 129025L, 2, 0x20, 0xff,  8,   100 },   // position, rapid
+  { 129026L, 2, 0x20, 0xff,  8,   250 },   // COG & SOG, rapid
+  { 129029L, 3, 0x20, 0xff, 43,  1000 },   // GNSS position (fast packet)
+  { 127488L, 2, 0x30, 0xff,  8,   100 },   // engine rapid, port
+  { 127488L, 2, 0x31, 0xff,  8,   100 },   // engine rapid, starboard
+  { 127489L, 2, 0x30, 0xff, 26,   500 },   // engine dynamic (fast packet)
+  { 127489L, 2, 0x31, 0xff, 26,   500 },
+  { 130306L, 2, 0x40, 0xff,  8,   100 },   // wind
+  { 128259L, 2, 0x41, 0xff,  8,  1000 },   // speed through water
+  { 128267L, 3, 0x41, 0xff,  8,  1000 },   // depth
+  { 129038L, 4, 0x50, 0xff, 28,    10 },   // AIS class A position (fast packet)
+  { 129039L, 4, 0x50, 0xff, 26,    40 },   // AIS class B position (fast packet)
+  { 127508L, 6, 0x60, 0xff,  8,  1000 },   // another battery monitor
+  { 126993L, 7, 0x10, 0xff,  8, 60000 },   // heartbeat
+  { 59904L,  6, 0x70, 0x10,  3,  5000 },   // ISO request to another node
+  { 60928L,  6, 0x71, 0xff,  8, 30000 },   // address claim
+};
+#define BUS_SOURCES (sizeof(busTraffic) / sizeof(busTraffic[0]))
+
+static void busSend(const BusTraffic& t) {
+  tN2kMsg m;
+  m.SetPGN(t.pgn);
+  m.Priority = t.prio;
+  m.Source = t.src;
+  m.Destination = t.dest;
+  if (t.pgn == 59904L) m.Add3ByteInt(126996L);
+  while (m.DataLen < t.len) m.AddByte(0);
+  simCanReceive(m);
+}
+
+// Every PGN the node handles passes the acceptance filter, at
+// any priority, source and destination; none of the others do
+static bool canFilterOk() {
+  static const unsigned long handled[] = { 59392L, 59904L, 60160L, 60416L, 60928L, 126208L };
+  static const unsigned long ignored[] = { 126993L, 126996L, 127245L, 127250L, 127251L, 127257L, 127488L,
+                                           127489L, 127506L, 127508L, 127513L, 128259L, 128267L, 129025L,
+                                           129026L, 129029L, 129038L, 129039L, 130306L, 65240L };
+  for (unsigned prio = 0; prio < 8; prio++) {
+    for (unsigned addr = 0; addr < 256; addr += 17) {
+      for (unsigned long pgn : handled)
+        if (!halCanAccepts(N2ktoCanID(prio, pgn, addr, (unsigned char)(255 - addr)))) return false;
+      for (unsigned long pgn : ignored)
+        if (halCanAccepts(N2ktoCanID(prio, pgn, addr, (unsigned char)(255 - addr)))) return false;
+    }
+  }
+  return true;
+}
+
+// 127513 as sent matches the bank's configuration
+static bool configFrameOk(const tN2kMsg& m) {
+  uint8_t inst = m.Data[0];
+  if (inst >= NUM_BATTERIES) return false;
+  const BankConfig& c = bankConfig[inst];
+  uint8_t type = m.Data[1] & 0x0f;
+  uint8_t chem = m.Data[2] >> 4;
+  uint8_t nomV = m.Data[2] & 0x0f;
+  int idx = 3;
+  double capAh = m.Get2ByteDouble(1, idx);
+  uint8_t peukert = m.Data[6];
+  uint8_t eff = m.Data[7];
+  uint8_t wantType = c.chemistry == CHEM_FLA ? N2kDCbt_Flooded : c.chemistry == CHEM_GEL ? N2kDCbt_Gel
+                   : c.chemistry == CHEM_AGM ? N2kDCbt_AGM : 0x0f;
+  uint8_t wantChem = c.chemistry == CHEM_LFP ? N2kDCbc_LiIon : N2kDCbc_LeadAcid;
+  uint8_t wantNomV = c.nominalV == 48 ? N2kDCbnv_48v : c.nominalV == 24 ? N2kDCbnv_24v : N2kDCbnv_12v;
+  return type == wantType && chem == wantChem && nomV == wantNomV && fabs(capAh - c.capacityAh) < 1.0 &&
+         abs((int)peukert - (int)lround((c.peukertExp - 1.0) / 0.002)) <= 1 &&
+         eff == (uint8_t)lroundf(c.chargeEff * 100.0f);
+}
+
+void setup();
+void loop();
+
+// Fill the journal with records the firmware ignores, leaving
+// no room in the active sector
+static void prefillJournal() {
+  uint8_t pad[JOURNAL_MAX_PAYLOAD];
+  memset(pad, 0x5A, sizeof(pad));
+  Journal j;
+  j.begin(JOURNAL_SECTORS);
+  j.rotate(0x7F, pad, sizeof(pad));
+  for (int len = JOURNAL_MAX_PAYLOAD; len >= 0; len--) {
+    while (j.append(0x7F, pad, (uint8_t)len)) {}
+  }
+}
+
+int main(int argc, char** argv) {
+  double seconds = 600.0;
+  bool debug = false;
+  bool prefill = false;
+  bool stress = false;
+  bool checkStall = false;
+  bool checkHeap = false;
+  bool tempFaults = false;
+  bool checkTemp = false;
+  bool i2cFaults = false;
+  bool checkI2c = false;
+  bool loadStep = false;
+  bool checkRuntime = false;
+  bool checkNmea = false;
+  bool isoRequests = false;
+  bool checkIso = false;
+  bool busLoad = false;
+  bool noCanFilter = false;
+  bool checkCan = false;
+  bool faults = false;
+  bool checkFaults = false;
+  uint32_t eraseUs = SIM_FLASH_ERASE_US;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--seconds") && i + 1 < argc) seconds = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--debug")) debug = true;
+    else if (!strcmp(argv[i], "--prefill")) prefill = true;
+    else if (!strcmp(argv[i], "--stress")) stress = true;
+    else if (!strcmp(argv[i], "--erase-us") && i + 1 < argc) eraseUs = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "--check-stall")) checkStall = true;
+    else if (!strcmp(argv[i], "--check-heap")) checkHeap = true;
+    else if (!strcmp(argv[i], "--temp-faults")) tempFaults = true;
+    else if (!strcmp(argv[i], "--check-temp")) checkTemp = true;
+    else if (!strcmp(argv[i], "--i2c-faults")) i2cFaults = true;
+    else if (!strcmp(argv[i], "--check-i2c")) checkI2c = true;
+    else if (!strcmp(argv[i], "--load-step")) loadStep = true;
+    else if (!strcmp(argv[i], "--check-runtime")) checkRuntime = true;
+    else if (!strcmp(argv[i], "--check-nmea")) checkNmea = true;
+    else if (!strcmp(argv[i], "--iso-requests")) isoRequests = true;
+    else if (!strcmp(argv[i], "--check-iso")) checkIso = true;
+    else if (!strcmp(argv[i], "--bus-load")) busLoad = true;
+    else if (!strcmp(argv[i], "--no-can-filter")) noCanFilter = true;
+    else if (!strcmp(argv[i], "--check-can")) checkCan = true;
+    else if (!strcmp(argv[i], "--faults")) faults = true;
+    else if (!strcmp(argv[i], "--check-faults")) checkFaults = true;
+    else {
+      fprintf(stderr, "usage: %s [--seconds S] [--debug] [--stress] [--prefill] [--erase-us US] [--check-stall] [--check-heap] [--temp-faults] [--check-temp] [--i2c-faults] [--check-i2c] [--load-step] [--check-runtime] [--check-nmea] [--iso-requests] [--check-iso] [--bus-load] [--no-can-filter] [--check-can] [--faults] [--check-faults]\n", argv[0]);
+      return 2;
+    }
+  }
+  Serial.enabled = debug;
+  NMEA2000.Record = checkRuntime || checkNmea || checkIso || checkFaults;
+  simCanAcceptAll(noCanFilter);
+
+  simSetBattery(0, 12.55f, 5.0f, 22.0f);   // lead-acid house bank, 5 A load
+  simSetBattery(1, 13.25f, -2.0f, 24.0f);  // LiFePO4 bank, 2 A charge
+  float plantTempC[2] = { 22.0f, 24.0f };
+  if (tempFaults) for (uint8_t ch = 0; ch < 2; ch++) simSetTempCorrupt(ch, 5);
+
+  if (prefill) prefillJournal();
+  simFlashSetTiming(eraseUs, SIM_FLASH_PROGRAM_US);
+  unsigned long heap0 = simCounters().heapAllocs;
+  setup();
+  unsigned long setupAllocs = simCounters().heapAllocs - heap0;
+
+  uint64_t endUs = simMicros() + (uint64_t)(seconds * 1e6);
+  std::vector<uint32_t> costNs;
+  costNs.reserve((size_t)(seconds * 1000.0));
+  unsigned long loopAllocs = 0;
+  unsigned long badTemps = 0;
+  uint64_t nextCycleUs = simMicros() + 600000000ULL;
+  uint64_t nextGlitchUs = simMicros() + 300000000ULL;
+  uint64_t nextHangUs = simMicros() + 1000000000ULL;
+  unsigned glitches = 0, hangs = 0;
+  uint64_t startUs = simMicros();
+  uint64_t stepUs = loadStep ? startUs + (uint64_t)(seconds * 0.5e6) : UINT64_MAX;
+  bool stepped = false;
+  double runtimeWorstPct = 0.0;
+  double settleS = -1.0;
+  unsigned long runtimeFrames = 0, fieldErrors = 0;
+  unsigned long frames508 = 0, frames506 = 0, frames513 = 0;
+  unsigned long lastFrameMs = ULONG_MAX;
+  unsigned framesInMs = 0, maxFramesPerMs = 0;
+  double stepShownMs = -1.0;
+  std::vector<IsoPending> isoPending;
+  uint64_t nextIsoUs = simMicros();
+  double isoWorstMs = 0.0;
+  unsigned long isoAnswered = 0, badConfigs = 0;
+  uint64_t busNextMs[BUS_SOURCES];
+  std::vector<FaultSeen> faultSeen;
+  uint8_t lastFaults[NUM_BATTERIES] = {};
+  size_t faultsMatched = 0;
+  unsigned long faultErrors = 0;
+  double detectWorstPct = 0.0;   // injection to detection, % of the debounce bound
+  uint32_t alertWorstMs = 0;
+  for (size_t s = 0; s < BUS_SOURCES; s++)
+    busNextMs[s] = simMicros() / 1000 + (s * 37) % busTraffic[s].periodMs;   // phases spread
+  while (simMicros() < endUs) {
+    if (tempFaults && simMicros() >= nextCycleUs) {
+      for (uint8_t ch = 0; ch < 2; ch++) simTempPowerCycle(ch);
+      nextCycleUs += 600000000ULL;
+    }
+    if (i2cFaults && simMicros() >= nextGlitchUs) {
+      simI2cGlitch();
+      glitches++;
+      nextGlitchUs += 300000000ULL;
+    }
+    if (i2cFaults && simMicros() >= nextHangUs) {
+      simI2cHoldSda(simMicros() + 3000000ULL);
+      hangs++;
+      nextHangUs += 1200000000ULL;
+    }
+    if (isoRequests && simMicros() >= nextIsoUs) {
+      isoRequest(isoPending, 127513L, true);
+      isoRequest(isoPending, 127506L, true);
+      isoRequest(isoPending, 126996L, false);
+      isoRequest(isoPending, 126983L, false);
+      isoRequest(isoPending, ISO_UNSUPPORTED_PGN, false);
+      nextIsoUs += 300000000ULL;
+    }
+    for (size_t s = 0; busLoad && s < BUS_SOURCES; s++) {
+      for (; simMicros() / 1000 >= busNextMs[s]; busNextMs[s] += busTraffic[s].periodMs) busSend(busTraffic[s]);
+    }
+    if (faults) faultPlant((simMicros() - startUs) / 1e6, plantTempC);
+    if (!stepped && simMicros() >= stepUs) {
+      simSetBattery(0, 12.35f, 20.0f, 22.0f);
+      stepped = true;
+    }
+    if (stress) {
+      bool charging = (simMicros() / 1800000000ULL) & 1;
+      simSetBattery(0, charging ? 13.6f : 12.2f, charging ? -63.0f : 60.0f, 22.0f);
+    }
+    unsigned long heapBefore = simCounters().heapAllocs;
+    auto t0 = std::chrono::steady_clock::now();
+    loop();
+    auto t1 = std::chrono::steady_clock::now();
+    loopAllocs += simCounters().heapAllocs - heapBefore;
+    for (uint8_t ch = 0; ch < NUM_BATTERIES && ch < 2; ch++) {
+      float t = banks.raw_temp_C[ch];
+      if (t != HAL_TEMP_DISCONNECTED && t != plantTempC[ch]) badTemps++;
+    }
+    costNs.push_back((uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+
+    // Fault transitions against the expected ones
+    for (uint8_t i = 0; i < NUM_BATTERIES; i++) {
+      uint8_t diff = banks.faults.active[i] ^ lastFaults[i];
+      lastFaults[i] = banks.faults.active[i];
+      for (uint8_t f = 0; f < FAULT_TYPES; f++) {
+        if (!(diff & (1u << f))) continue;
+        bool raise = banks.faults.isActive(i, f);
+        uint32_t detectMs = banks.faults.changedMs[f][i];
+        faultSeen.push_back({ i, f, raise, detectMs });
+        if (faultsMatched >= FAULT_EXPECTED) {
+          faultErrors++;
+          continue;
+        }
+        const FaultExpect& e = faultExpect[faultsMatched++];
+        if (e.bank != i || e.fault != f || e.raise != raise) {
+          faultErrors++;
+          continue;
+        }
+        double periodMs = f == FAULT_TEMP_HIGH ? TEMP_READ_MAX_MS : inaConversionUs(i) / 1000.0;
+        double boundMs = ((raise ? FAULT_SET_SAMPLES : FAULT_CLEAR_SAMPLES) + 1) * periodMs;
+        double tookMs = detectMs - (startUs / 1000.0 + e.atS * 1000.0);
+        detectWorstPct = std::max(detectWorstPct, 100.0 * tookMs / boundMs);
+      }
+    }
+
+    // Time remaining in each 127506 against the bank's state
+    // at the time it was sent
+    for (const tN2kMsg& m : NMEA2000.Sent) {
+      framesInMs = m.MsgTime == lastFrameMs ? framesInMs + 1 : 1;
+      lastFrameMs = m.MsgTime;
+      maxFramesPerMs = std::max(maxFramesPerMs, framesInMs);
+      frames508 += m.PGN == 127508L;
+      frames506 += m.PGN == 127506L;
+      frames513 += m.PGN == 127513L;
+      if (m.PGN == 127508L && m.Data[0] == 0 && stepped && stepShownMs < 0 &&
+          (int16_t)(m.Data[3] | m.Data[4] << 8) >= 100)   // 10 A
+        stepShownMs = (simMicros() - stepUs) / 1e3;
+      if (m.PGN == 127508L && m.Data[7] > 252) fieldErrors++;   // SID out of range
+      if (m.PGN == 127513L && !configFrameOk(m)) badConfigs++;
+      if (m.PGN == 126983L) {
+        uint8_t state = m.Data[27];
+        for (size_t r = 0; r < faultSeen.size(); r++) {
+          const FaultSeen& fs = faultSeen[r];
+          if (fs.bank != m.Data[13] || fs.fault != m.Data[14] ||
+              state != (fs.raise ? N2kts_AlertStateActive : N2kts_AlertStateNormal)) continue;
+          alertWorstMs = std::max(alertWorstMs, (uint32_t)(m.MsgTime - fs.detectMs));
+          faultSeen.erase(faultSeen.begin() + r);
+          break;
+        }
+      }
+      for (size_t r = 0; r < isoPending.size(); r++) {
+        IsoPending& p = isoPending[r];
+        unsigned long answersPgn = m.PGN;
+        unsigned bit = 1;
+        if (m.PGN == 59392L) answersPgn = m.Data[5] | m.Data[6] << 8 | (unsigned long)m.Data[7] << 16;
+        else if (m.PGN == 127513L || m.PGN == 127506L) bit = 1u << (m.PGN == 127513L ? m.Data[0] : m.Data[1]);
+        if (answersPgn != p.pgn) continue;
+        p.answered |= bit;
+        if (p.answered != p.expected) continue;
+        isoWorstMs = std::max(isoWorstMs, (simMicros() - p.atUs) / 1e3);
+        isoAnswered++;
+        isoPending.erase(isoPending.begin() + r);
+        break;
+      }
+      if (m.PGN != 127506L) continue;
+      uint8_t inst = m.Data[1];
+      uint16_t minutes = m.Data[5] | m.Data[6] << 8;
+      uint16_t ripple = m.Data[7] | m.Data[8] << 8;
+      uint16_t capAh = m.Data[9] | m.Data[10] << 8;
+      if (m.Data[0] > 252 || ripple != N2kUInt16NA) fieldErrors++;
+      if (!banks.socValid[inst]) continue;
+      if (fabsf(capAh - banks.remaining_Ah[inst]) > 1.0f) fieldErrors++;
+
+      double nowS = (simMicros() - startUs) / 1e6;
+      if (nowS < 2 * RUNTIME_SHORT_S) continue;   // horizons warming up
+      float eff = banks.effective_current[inst];
+      float rem = banks.remaining_Ah[inst];
+      if (fabsf(eff) < bankConfig[inst].restIThresholdA) {   // idle: must be "not available"
+        if (minutes != N2kUInt16NA) fieldErrors++;
+        continue;
+      }
+      double expectS = 3600.0 * (eff > 0 ? rem : banks.learned_capacity_Ah[inst] - rem) / fabsf(eff);
+      double errPct = minutes == N2kUInt16NA ? 100.0 : 100.0 * fabs(minutes * 60.0 - expectS) / expectS;
+      runtimeFrames++;
+      if (inst == 0 && stepped && settleS < 0) {
+        if (errPct > RUNTIME_TOL_PCT) continue;
+        settleS = (simMicros() - stepUs) / 1e6;
+      }
+      runtimeWorstPct = std::max(runtimeWorstPct, errPct);
+    }
+    NMEA2000.Sent.clear();
+  }
+
+  size_t n = costNs.size();
+  std::vector<uint32_t> sorted(costNs);
+  std::sort(sorted.begin(), sorted.end());
+  double sum = 0;
+  for (uint32_t c : costNs) sum += c;
+
+  const SimCounters& sc = simCounters();
+  printf("loop passes       : %zu (virtual %.1f s)\n", n, simMicros() / 1e6);
+  printf("loop cost ns      : mean %.0f  p50 %u  p99 %u  max %u\n",
+         n ? sum / n : 0.0, n ? sorted[n / 2] : 0, n ? sorted[(n * 99) / 100] : 0, n ? sorted.back() : 0);
+  for (uint8_t i = 0; i < schedulerStageCount(); i++) {
+    const SchedStage& s = schedulerStage(i);
+    printf("stage %-11s : %u runs @ %u us, jitter avg %.1f max %u us, exec max %u us, overruns %u, skipped %u\n",
+           s.name, s.runs, s.periodUs, s.runs ? (double)s.sumJitterUs / s.runs : 0.0,
+           s.maxJitterUs, s.maxExecUs, s.overruns, s.skipped);
+  }
+  printf("INA226 reads      : %lu bus, %lu current, %lu duplicate, %lu ready-flag\n",
+         sc.busVoltageReads, sc.currentReads, sc.duplicateReads, sc.powerFlagReads);
+  printf("INA226 conversions: %llu + %llu, read latency max %llu us, %lu missed\n",
+         (unsigned long long)simPowerConversions(0), (unsigned long long)simPowerConversions(1),
+         (unsigned long long)sc.maxReadLatencyUs, sc.missedConversions);
+  for (uint8_t ch = 0; ch < NUM_BATTERIES && ch < 2; ch++) {
+    const I2cDeviceStats& d = i2cDeviceStats(ch);
+    printf("I2C B%u            : %u transactions, %u NACK, %u timeouts, latency avg %.0f max %u us\n",
+           ch + 1, d.transactions, d.nacks, d.timeouts,
+           d.transactions ? (double)d.sumUs / d.transactions : 0.0, d.maxUs);
+  }
+  const I2cBusStats& bus = i2cBusStats();
+  printf("I2C bus           : %lu transfers, %.2f %% busy, %u recoveries, %u failed, %u skipped%s\n",
+         sc.i2cTransfers, 100.0 * sc.i2cBusUs / simMicros(), bus.recoveries, bus.failedRecoveries,
+         bus.skipped, bus.down ? " (down)" : "");
+  printf("1-Wire            : %lu resets, %lu bytes, %lu conversions, %lu scratchpad reads\n",
+         sc.oneWireResets, sc.oneWireBytes, sc.tempRequests, sc.tempReads);
+  bool tempsOk = true;
+  for (uint8_t ch = 0; ch < NUM_BATTERIES && ch < 2; ch++) {
+    const TempSensor& t = tempSensor(ch);
+    printf("DS18B20 B%u        : %u bit, %u readings, %u CRC errors, %u absent, %u reconfigs, now %.2f C\n",
+           ch + 1, t.bits, t.reads, t.crcErrors, t.absent, t.reconfigs, t.tempC);
+    if (t.reads == 0) tempsOk = false;
+  }
+  unsigned long erases = 0;
+  for (unsigned long e : simFlashErases()) erases += e;
+  printf("flash             : %lu programs, %lu bytes, %lu erases\n",
+         sc.flashPrograms, sc.flashBytes, erases);
+  const NmeaTxStats& tx = nmeaTxStats();
+  printf("NMEA2000 frames   : %lu (%u at deadline, %u on change, %u for %u requests), latest %u ms past deadline\n",
+         NMEA2000.SentCount, tx.onDeadline, tx.onChange, tx.onRequest, tx.requests, tx.maxLateMs);
+  printf("NMEA2000 alerts   : %u frames, detection to alert at most %u ms\n", tx.alerts, tx.alertMaxMs);
+  if (NMEA2000.Record)
+    printf("NMEA2000 per PGN  : 127508 %.2f/s, 127506 %.2f/s, 127513 %.3f/s, at most %u per ms\n",
+           frames508 / seconds, frames506 / seconds, frames513 / seconds, maxFramesPerMs);
+  NmeaRxStats rx = nmeaRxStats();
+  printf("CAN receive       : %lu frames on the bus, %lu filtered out, %u read (%.1f/s), %u dropped\n",
+         sc.canOffered, sc.canRejected, rx.frames, rx.frames / seconds, rx.dropped);
+  printf("NMEA2000 parse    : %u calls, avg %.1f max %u us, %.3f %% CPU\n", rx.parses,
+         rx.parses ? (double)rx.parseSumUs / rx.parses : 0.0, rx.parseMaxUs, 100.0 * rx.parseSumUs / (seconds * 1e6));
+  printf("sample ring       : %u pushed, %u dropped, max fill %u/%u\n", sampleRing.pushes(),
+         sampleRing.drops.load(), sampleRing.maxFill.load(), (unsigned)SAMPLE_RING_LEN);
+  for (uint8_t ch = 0; ch < NUM_BATTERIES && ch < 2; ch++) {
+    printf("runtime B%u        : load %.2f A (%u s horizon), time to empty %.2f h, to full %.2f h\n",
+           ch + 1, banks.loadA[ch], (unsigned)LoadHorizons<NUM_BATTERIES>::tauS(banks.loadStats.horizon(ch)),
+           banks.timeToEmptyS[ch] / 3600.0, banks.timeToFullS[ch] / 3600.0);
+  }
+  printf("heap allocations  : %lu in setup, %lu in loop\n", setupAllocs, loopAllocs);
+
+  if (checkStall) {
+    if (sc.missedConversions > 0) {
+      printf("FAIL %lu INA226 conversions lost\n", sc.missedConversions);
+      return 1;
+    }
+    printf("PASS no INA226 conversion lost\n");
+  }
+  if (checkTemp) {
+    uint32_t holdUs = 0;
+    for (uint8_t i = 0; i < schedulerStageCount(); i++) {
+      const SchedStage& s = schedulerStage(i);
+      if (!strcmp(s.name, "sensors") || !strcmp(s.name, "temp")) holdUs = std::max(holdUs, s.maxExecUs);
+    }
+    if (holdUs > TEMP_HOLD_MAX_US || !tempsOk || badTemps > 0) {
+      printf("FAIL temperature: stage held %u us (max %u), %lu bad values, %s\n",
+             holdUs, TEMP_HOLD_MAX_US, badTemps, tempsOk ? "all banks read" : "a bank never read");
+      return 1;
+    }
+    printf("PASS temperatures read in steps of at most %u us, no bad value\n", holdUs);
+  }
+  if (checkI2c) {
+    uint32_t holdUs = 0;
+    uint32_t lost = 0;
+    for (uint8_t i = 0; i < schedulerStageCount(); i++) {
+      const SchedStage& s = schedulerStage(i);
+      if (!strcmp(s.name, "sensors")) holdUs = s.maxExecUs;
+      if (!strcmp(s.name, "soc")) lost = s.skipped;
+    }
+    bool resumed = !bus.down;
+    for (uint8_t ch = 0; ch < NUM_BATTERIES && ch < 2; ch++)
+      resumed &= halMicros() - banks.sampleUs[ch] < 1000000UL;
+    bool recovered = bus.recoveries >= glitches + hangs;
+    if (holdUs > I2C_HOLD_MAX_US || lost > 0 || !resumed || !recovered) {
+      printf("FAIL I2C: sensor stage held %u us (max %u), %u SoC slots lost, %s, %u recoveries for %u faults\n",
+             holdUs, I2C_HOLD_MAX_US, lost, resumed ? "sampling resumed" : "sampling stopped",
+             bus.recoveries, glitches + hangs);
+      return 1;
+    }
+    printf("PASS %u I2C faults recovered, sensor stage at most %u us, no SoC slot lost\n",
+           glitches + hangs, holdUs);
+  }
+  if (checkRuntime) {
+    bool settled = !loadStep || (settleS >= 0 && settleS <= RUNTIME_SETTLE_MAX_S);
+    if (runtimeFrames == 0 || runtimeWorstPct > RUNTIME_TOL_PCT || !settled || fieldErrors > 0) {
+      printf("FAIL runtime: %lu frames, worst %.2f %% (max %.1f %%), settled after %.0f s (max %u s), %lu field errors\n",
+             runtimeFrames, runtimeWorstPct, RUNTIME_TOL_PCT, settleS, RUNTIME_SETTLE_MAX_S, fieldErrors);
+      return 1;
+    }
+    printf("PASS time remaining in %lu frames within %.2f %%%s\n", runtimeFrames, runtimeWorstPct,
+           loadStep ? ", settled after the load step" : "");
+    if (loadStep) printf("     load step settled in %.0f s\n", settleS);
+  }
+  if (checkNmea) {
+    bool stepOk = !loadStep || (stepShownMs >= 0 && stepShownMs <= NMEA_STEP_MAX_MS);
+    if (maxFramesPerMs > NMEA_FRAMES_PER_POLL || tx.maxLateMs > NMEA_LATE_MAX_MS || !stepOk) {
+      printf("FAIL NMEA schedule: %u frames in one ms (max %u), %u ms late (max %u), load step shown after %.0f ms (max %u)\n",
+             maxFramesPerMs, NMEA_FRAMES_PER_POLL, tx.maxLateMs, NMEA_LATE_MAX_MS, stepShownMs, NMEA_STEP_MAX_MS);
+      return 1;
+    }
+    printf("PASS no PGN burst, at most %u ms late", tx.maxLateMs);
+    if (loadStep) printf(", load step in 127508 after %.0f ms", stepShownMs);
+    printf("\n");
+  }
+  if (checkIso) {
+    if (isoAnswered == 0 || !isoPending.empty() || isoWorstMs > ISO_ANSWER_MAX_MS || badConfigs > 0) {
+      printf("FAIL ISO requests: %lu answered, %zu unanswered, slowest %.0f ms (max %u), %lu bad 127513\n",
+             isoAnswered, isoPending.size(), isoWorstMs, ISO_ANSWER_MAX_MS, badConfigs);
+      return 1;
+    }
+    printf("PASS %lu ISO requests answered, slowest after %.0f ms, 127513 matches the configuration\n",
+           isoAnswered, isoWorstMs);
+  }
+  if (checkCan) {
+    bool filterOk = canFilterOk();
+    if (!filterOk || rx.dropped > 0 || rx.parseMaxUs > CAN_PARSE_MAX_US) {
+      printf("FAIL CAN receive: filter %s, %u frames dropped, ParseMessages() up to %u us (max %u)\n",
+             filterOk ? "ok" : "wrong", rx.dropped, rx.parseMaxUs, CAN_PARSE_MAX_US);
+      return 1;
+    }
+    printf("PASS %lu of %lu bus frames filtered out, none dropped, ParseMessages() at most %u us\n",
+           sc.canRejected, sc.canOffered, rx.parseMaxUs);
+  }
+  if (checkFaults) {
+    if (faultsMatched != FAULT_EXPECTED || faultErrors > 0 || !faultSeen.empty() ||
+        detectWorstPct > 100.0 || alertWorstMs > ALERT_FRAME_MAX_MS) {
+      printf("FAIL faults: %zu of %zu transitions, %lu unexpected, %zu without alert, "
+             "detection at %.0f %% of the debounce bound, alert after %u ms (max %u)\n",
+             faultsMatched, FAULT_EXPECTED, faultErrors, faultSeen.size(), detectWorstPct,
+             alertWorstMs, ALERT_FRAME_MAX_MS);
+      return 1;
+    }
+    printf("PASS %zu fault transitions, detection at most %.0f %% of the debounce bound, alert after at most %u ms\n",
+           faultsMatched, detectWorstPct, alertWorstMs);
+  }
+  if (checkHeap) {
+    if (setupAllocs + loopAllocs > 0) {
+      printf("FAIL firmware allocated on the heap\n");
+      return 1;
+    }
+    printf("PASS no heap allocation\n");
+  }
+  return 0;
+}
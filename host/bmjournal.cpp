@@ -0,0 +1,106 @@
+// ===========================================================
+// bmjournal — power-cut test of the flash journal
+// ===========================================================
+//
+// Appends records carrying an increasing counter and a
+// counter-derived payload of random length to the journal on
+// the simulated flash (rotating when a sector is full, as the
+// SoC persistence does), and cuts power after a random number
+// of programmed bytes. After every cut the journal is mounted
+// again and replayed; the check fails unless
+//   - every replayed record is intact and counters increase
+//   - the last record is the last acknowledged one or the
+//     one that was in flight at the cut
+//   - no program ever needed an erase (0 -> 1 bit)
+//
+//   bmjournal [--cuts N] [--seed S]
+// ===========================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include "HalHost.h"
+#include "Journal.h"
+
+struct ReplayCheck {
+  uint32_t last;
+  unsigned long records;
+  bool ok;
+};
+
+static void fillPayload(uint8_t* p, size_t len, uint32_t counter) {
+  memcpy(p, &counter, 4);
+  for (size_t k = 4; k < len; k++) p[k] = (uint8_t)(counter * 31 + k);
+}
+
+static void onRecord(uint8_t, const uint8_t* p, uint8_t len, void* ctx) {
+  ReplayCheck& r = *(ReplayCheck*)ctx;
+  uint32_t counter;
+  uint8_t expect[256];
+  if (len < 4) { r.ok = false; return; }
+  memcpy(&counter, p, 4);
+  fillPayload(expect, len, counter);
+  if (memcmp(p, expect, len) != 0 || counter <= r.last) r.ok = false;
+  r.last = counter;
+  r.records++;
+}
+
+int main(int argc, char** argv) {
+  unsigned long cuts = 1000;
+  uint32_t seed = 1;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--cuts") && i + 1 < argc) cuts = strtoul(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    else {
+      fprintf(stderr, "usage: %s [--cuts N] [--seed S]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<long> budget(0, 3 * HAL_FLASH_SECTOR_SIZE);
+  std::uniform_int_distribution<int> length(4, 60);
+  simFlashResize(2);
+
+  uint32_t acked = 0;
+  unsigned long written = 0, failures = 0;
+  for (unsigned long cut = 0; cut < cuts; cut++) {
+    Journal j;
+    j.begin(2);
+    ReplayCheck r = { 0, 0, true };
+    j.replay(onRecord, &r);
+    if (!r.ok || (r.last != acked && r.last != acked + 1)) {
+      printf("FAIL after cut %lu: last record %u, acknowledged %u%s\n",
+             cut, r.last, acked, r.ok ? "" : ", corrupt replay");
+      failures++;
+    }
+    acked = r.last;
+
+    // Write until the power fails
+    simFlashPowerCut(budget(rng));
+    for (;;) {
+      uint8_t payload[256];
+      uint8_t len = (uint8_t)length(rng);
+      fillPayload(payload, len, acked + 1);
+      if (!j.append(1, payload, len) && !j.rotate(1, payload, len)) break;
+      acked++;
+      written++;
+    }
+    simFlashPowerCut(-1);
+  }
+
+  unsigned long erases = 0;
+  for (unsigned long e : simFlashErases()) erases += e;
+  const SimCounters& sc = simCounters();
+  printf("power cuts        : %lu\n", cuts);
+  printf("records written   : %lu, sector erases %lu\n", written, erases);
+  printf("overwrites        : %lu\n", sc.flashOverwrites);
+  if (sc.flashOverwrites) failures++;
+  if (failures) {
+    printf("FAIL %lu checks\n", failures);
+    return 1;
+  }
+  printf("PASS journal consistent after every cut\n");
+  return 0;
+}
@@ -0,0 +1,134 @@
+// ===========================================================
+// bmocv — OCV lookup: dense grid vs. table scan
+// ===========================================================
+//
+// For every chemistry at 12, 24 and 48V, compares the compile-
+// time OCV grid (Ocv.h, one index + linear interpolation)
+// with the table scan it replaces (temperature compensation,
+// scaling to 12V, linear search, interpolation):
+//   - cost per lookup (ns, random voltages and temperatures)
+//   - worst SoC difference over a 1 mV x 0.5 C sweep of the
+//     grid's (compensated) voltage range at SWEEP_TMIN_C ..
+//     SWEEP_TMAX_C
+// --check fails if any grid is off by more than TOL % SoC.
+//
+//   bmocv [--lookups N] [--check TOL]
+// ===========================================================
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "Config.h"
+#include "Ocv.h"
+
+// Distinct queries, enough that the branch predictor cannot
+// learn the sequence
+#define QUERIES 65536
+
+// Temperatures the lookups and the error sweep cover
+#define SWEEP_TMIN_C -20.0f
+#define SWEEP_TMAX_C  50.0f
+
+struct GridCase {
+  const char* chem;
+  int   chemId;
+  int   nominalV;
+  float coef;
+};
+
+// Lead-acid coefficients as in Config.h (V/C per 12V, scaled)
+static const GridCase cases[] = {
+  { "FLA", CHEM_FLA, 12, -0.030f }, { "FLA", CHEM_FLA, 24, -0.060f }, { "FLA", CHEM_FLA, 48, -0.120f },
+  { "AGM", CHEM_AGM, 12, -0.024f }, { "AGM", CHEM_AGM, 24, -0.048f }, { "AGM", CHEM_AGM, 48, -0.096f },
+  { "GEL", CHEM_GEL, 12, -0.024f }, { "GEL", CHEM_GEL, 24, -0.048f }, { "GEL", CHEM_GEL, 48, -0.096f },
+  { "LFP", CHEM_LFP, 12,  0.0f   }, { "LFP", CHEM_LFP, 24,  0.0f   }, { "LFP", CHEM_LFP, 48,  0.0f   },
+};
+
+static constexpr OcvGrid grids[] = {
+  makeOcvGrid(CHEM_FLA, 12, -0.030f), makeOcvGrid(CHEM_FLA, 24, -0.060f), makeOcvGrid(CHEM_FLA, 48, -0.120f),
+  makeOcvGrid(CHEM_AGM, 12, -0.024f), makeOcvGrid(CHEM_AGM, 24, -0.048f), makeOcvGrid(CHEM_AGM, 48, -0.096f),
+  makeOcvGrid(CHEM_GEL, 12, -0.024f), makeOcvGrid(CHEM_GEL, 24, -0.048f), makeOcvGrid(CHEM_GEL, 48, -0.096f),
+  makeOcvGrid(CHEM_LFP, 12,  0.0f),   makeOcvGrid(CHEM_LFP, 24,  0.0f),   makeOcvGrid(CHEM_LFP, 48,  0.0f),
+};
+
+static_assert(sizeof(grids) / sizeof(grids[0]) == sizeof(cases) / sizeof(cases[0]), "one grid per case");
+
+// The lookup before the grid: compensate, scale, scan
+static float scanSoc(const OcvTableView& tv, float v, float tC, int nominalV, float coef) {
+  float v12 = (v - coef * (tC - 25.0f)) * (12.0f / nominalV);
+  if (v12 <= tv.pts[0].v) return tv.pts[0].soc;
+  for (size_t i = 1; i < tv.len; i++) {
+    if (v12 <= tv.pts[i].v) {
+      float t = (v12 - tv.pts[i-1].v) / (tv.pts[i].v - tv.pts[i-1].v);
+      return tv.pts[i-1].soc + t * (tv.pts[i].soc - tv.pts[i-1].soc);
+    }
+  }
+  return tv.pts[tv.len-1].soc;
+}
+
+int main(int argc, char** argv) {
+  long lookups = 2000000;
+  double tol = -1;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--lookups") && i + 1 < argc) lookups = atol(argv[++i]);
+    else if (!strcmp(argv[i], "--check") && i + 1 < argc) tol = atof(argv[++i]);
+    else {
+      fprintf(stderr, "usage: %s [--lookups N] [--check TOL]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  printf("grid %d points (compensated voltage), %zu bytes per bank\n",
+         OCV_GRID_V, sizeof(OcvGrid));
+  printf("case       scan ns  grid ns  speedup  max err %%  at V / C\n");
+  bool pass = true;
+  uint32_t rng = 1;
+  volatile float sink = 0;
+
+  for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+    const GridCase& gc = cases[c];
+    const OcvGrid& g = grids[c];
+    OcvTableView tv = ocvTableForChem(gc.chemId);
+    float vMax = g.vMin + g.vStep * (OCV_GRID_V - 1);
+
+    // Random temperatures, and voltages that land inside the
+    // table after compensation (the scan's full cost)
+    std::vector<float> qv(QUERIES), qt(QUERIES);
+    for (size_t k = 0; k < qv.size(); k++) {
+      rng = rng * 1103515245u + 12345u;
+      qt[k] = SWEEP_TMIN_C + (SWEEP_TMAX_C - SWEEP_TMIN_C) * ((rng >> 8) & 0xFFFF) / 65535.0f;
+      rng = rng * 1103515245u + 12345u;
+      qv[k] = g.vMin + (vMax - g.vMin) * ((rng >> 8) & 0xFFFF) / 65535.0f + gc.coef * (qt[k] - 25.0f);
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    float acc = 0;
+    for (long n = 0; n < lookups; n++) acc += scanSoc(tv, qv[n % QUERIES], qt[n % QUERIES], gc.nominalV, gc.coef);
+    auto t1 = std::chrono::steady_clock::now();
+    for (long n = 0; n < lookups; n++) acc += ocvGridSoc(g, qv[n % QUERIES], qt[n % QUERIES]);
+    auto t2 = std::chrono::steady_clock::now();
+    sink = sink + acc;
+    double scanNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / lookups;
+    double gridNs = std::chrono::duration<double, std::nano>(t2 - t1).count() / lookups;
+
+    float maxErr = 0, errV = 0, errT = 0;
+    for (float tC = SWEEP_TMIN_C; tC <= SWEEP_TMAX_C; tC += 0.5f) {
+      float shift = gc.coef * (tC - 25.0f);
+      for (float v = g.vMin - 0.1f + shift; v <= vMax + 0.1f + shift; v += 0.001f) {
+        float e = fabsf(ocvGridSoc(g, v, tC) - scanSoc(tv, v, tC, gc.nominalV, gc.coef));
+        if (e > maxErr) { maxErr = e; errV = v; errT = tC; }
+      }
+    }
+
+    printf("%s %2dV    %7.1f  %7.1f  %6.1fx  %9.3f  %.3f / %.1f\n",
+           gc.chem, gc.nominalV, scanNs, gridNs, scanNs / gridNs, maxErr, errV, errT);
+    if (tol >= 0 && maxErr > tol) pass = false;
+  }
+
+  if (tol < 0) return 0;
+  printf(pass ? "PASS grid within %.2f %% SoC of the scan\n" : "FAIL grid off by more than %.2f %% SoC\n", tol);
+  return pass ? 0 : 1;
+}
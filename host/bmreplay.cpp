@@ -0,0 +1,307 @@
+// ===========================================================
+// bmreplay — faster-than-real-time replay of the SoC pipeline
+// ===========================================================
+//
+// Feeds a recorded (CSV) or synthetic trace through
+// readSensors() → updateSoc() on the virtual clock and
+// compares the firmware's SoC / Ah / Wh with:
+//   - an ideal counter: the same conversions, timestamps and
+//     effective (Peukert / charge efficiency) currents
+//     integrated in double precision (isolates integration
+//     drift)
+//   - the plant's true SoC (synthetic traces only): final,
+//     RMS and worst error over the run once SoC is valid
+// and reports the flash journal's writes and erases projected
+// to a year of operation and to the sector endurance.
+//
+// --check exits non-zero when any bank's |Ah drift| or
+// |Wh drift| exceeds the given tolerances; --check-capacity
+// when any bank's learned capacity is further than TOL Ah from
+// the plant's true capacity; --check-soc when any bank's RMS
+// SoC error against the plant exceeds RMS % (all used by
+// ctest).
+//
+// bmreplay_ekf is the same with the model-based estimator
+// (SOC_ESTIMATOR_EKF); the ideal counter then adds the
+// filter's corrections, so drift still measures integration
+// alone. Comparing its SoC error with bmreplay's on the same
+// trace is the estimator's accuracy against the counter.
+//
+//   bmreplay [--days D] [--dt-ms MS] [--seed S]
+//            [--trace in.csv] [--record out.csv] [--nmea]
+//            [--check AH WH] [--check-capacity TOL]
+//            [--check-soc RMS]
+// ===========================================================
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include "HalHost.h"
+#include "Trace.h"
+#include "Config.h"
+#include "Globals.h"
+#include "Sensors.h"
+#include "Soc.h"
+#include "Nmea.h"
+
+void setup();
+
+// ----- Firmware state, per channel -----
+static float fwSocPercent(int ch)   { return banks.soc_percent[ch]; }
+static float fwRemainingAh(int ch)  { return banks.remaining_Ah[ch]; }
+static float fwRemainingWh(int ch)  { return banks.remaining_Wh[ch]; }
+static float fwCapacityAh(int ch)   { return banks.learned_capacity_Ah[ch]; }
+static float fwCalibratedA(int ch)  { return banks.calibrated_current[ch]; }
+static float fwEffectiveA(int ch)   { return banks.effective_current[ch]; }
+static float fwCalibratedV(int ch)  { return banks.calibrated_voltage[ch]; }
+
+// The trace holds true values; the sensors report them through
+// the inverse of the configured 2-point calibration.
+static float uncalibrate(float cal, float rawLow, float calLow, float rawHigh, float calHigh) {
+  float slope = (calHigh - calLow) / (rawHigh - rawLow);
+  float offset = calLow - slope * rawLow;
+  return (cal - offset) / slope;
+}
+
+static void applySample(const TraceSample& s, int channels) {
+  for (int ch = 0; ch < channels; ch++) {
+    const BankConfig& c = bankConfig[ch];
+    float v = uncalibrate(s.volts[ch], c.vRawLow, c.vCalLow, c.vRawHigh, c.vCalHigh);
+    float i = uncalibrate(s.amps[ch], c.iRawLow, c.iCalLow, c.iRawHigh, c.iCalHigh);
+    simSetBattery(ch, v, i, s.tempC[ch] - c.tempOffsetC);
+  }
+}
+
+struct IdealCounter {
+  double ah, wh;
+  double lastA, lastW;
+  uint32_t lastUs;
+  float  correctionAh;   // estimator corrections already followed
+};
+
+// Firmware SoC against the plant's
+struct SocError {
+  double sumSq, worst, worstAtH;
+  unsigned long n;
+};
+
+static float fwCorrectionAh(int ch) {
+#ifdef SOC_ESTIMATOR_EKF
+  return banks.ekf[ch].correctionAh;
+#else
+  (void)ch;
+  return 0.0f;
+#endif
+}
+
+// Detector activity per bank
+struct EventStats {
+  unsigned long restEntries, fullEvents;
+  double restS;
+  bool wasResting, wasFull;
+  uint32_t socResyncs;
+};
+
+int main(int argc, char** argv) {
+  double days = 30.0;
+  uint32_t dtMs = 100;
+  uint32_t seed = 1;
+  const char* tracePath = nullptr;
+  const char* recordPath = nullptr;
+  bool runNmea = false;
+  double checkAh = -1, checkWh = -1;
+  double checkCapAh = -1;
+  double checkSocRms = -1;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--days") && i + 1 < argc) days = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--dt-ms") && i + 1 < argc) dtMs = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "--trace") && i + 1 < argc) tracePath = argv[++i];
+    else if (!strcmp(argv[i], "--record") && i + 1 < argc) recordPath = argv[++i];
+    else if (!strcmp(argv[i], "--nmea")) runNmea = true;
+    else if (!strcmp(argv[i], "--check") && i + 2 < argc) {
+      checkAh = atof(argv[++i]);
+      checkWh = atof(argv[++i]);
+    }
+    else if (!strcmp(argv[i], "--check-capacity") && i + 1 < argc) checkCapAh = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--check-soc") && i + 1 < argc) checkSocRms = atof(argv[++i]);
+    else {
+      fprintf(stderr, "usage: %s [--days D] [--dt-ms MS] [--seed S] [--trace in.csv] [--record out.csv] [--nmea] [--check AH WH] [--check-capacity TOL] [--check-soc RMS]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  std::unique_ptr<TraceSource> trace;
+  if (tracePath) {
+    CsvTrace* csv = new CsvTrace(tracePath);
+    trace.reset(csv);
+    if (!csv->ok()) { fprintf(stderr, "cannot read trace %s\n", tracePath); return 1; }
+  } else {
+    trace.reset(new SyntheticTrace(days, dtMs, seed));
+  }
+  int channels = trace->channels() < NUM_BATTERIES ? trace->channels() : NUM_BATTERIES;
+
+  FILE* rec = recordPath ? fopen(recordPath, "w") : nullptr;
+  if (rec) writeTraceHeader(rec, channels);
+
+  Serial.enabled = false;
+  NMEA2000.Record = false;
+
+  TraceSample s;
+  if (!trace->next(s)) { fprintf(stderr, "empty trace\n"); return 1; }
+  simSetMicros(s.tMs * 1000ULL);
+  applySample(s, channels);
+  setup();
+
+  IdealCounter ideal[NUM_BATTERIES];
+  EventStats events[NUM_BATTERIES] = {};
+  SocError socErr[NUM_BATTERIES] = {};
+  bool idealStarted = false;
+  unsigned long samples = 0;
+  auto wall0 = std::chrono::steady_clock::now();
+
+  do {
+    simSetMicros(s.tMs * 1000ULL);
+    applySample(s, channels);
+    readSensors();
+    tempStep();
+    persistStep();
+    updateSoc();
+    if (runNmea) nmeaLoop();
+    if (rec) writeTraceSample(rec, s, channels);
+
+    for (int ch = 0; ch < channels; ch++) {
+      EventStats& e = events[ch];
+      if (banks.isResting[ch]) {
+        e.restS += dtMs / 1000.0;
+        if (!e.wasResting) e.restEntries++;
+      }
+      if (banks.isFull[ch] && !e.wasFull) e.fullEvents++;
+    }
+
+    for (int ch = 0; ch < channels && !needSocInitFromOCV; ch++) {
+      IdealCounter& c = ideal[ch];
+      // A resync to a SoC anchor sets the firmware's charge: follow it
+      bool resync = banks.socResyncs[ch] != events[ch].socResyncs;
+      events[ch].socResyncs = banks.socResyncs[ch];
+      events[ch].wasResting = banks.isResting[ch];
+      events[ch].wasFull = banks.isFull[ch];
+      double a = fwEffectiveA(ch);
+      double w = (double)fwCalibratedV(ch) * fwCalibratedA(ch);
+      double trueSoc = trace->trueSocPercent(ch);
+      if (trueSoc >= 0) {
+        SocError& e = socErr[ch];
+        double err = fabs(fwSocPercent(ch) - trueSoc);
+        e.sumSq += err * err;
+        e.n++;
+        if (err > e.worst) { e.worst = err; e.worstAtH = s.tMs / 3.6e6; }
+      }
+      if (!idealStarted || resync) {
+        c.ah = fwRemainingAh(ch);   // start from the firmware's estimate
+        c.wh = fwRemainingWh(ch);
+        c.correctionAh = fwCorrectionAh(ch);
+      } else if (banks.fresh[ch]) {
+        double dtH = (uint32_t)(banks.sampleUs[ch] - c.lastUs) / 3.6e9;
+        c.ah -= 0.5 * (a + c.lastA) * dtH;
+        c.wh -= 0.5 * (w + c.lastW) * dtH;
+        double cap = fwCapacityAh(ch);
+        if (c.ah > cap) c.ah = cap;
+        if (c.ah < 0) c.ah = 0;
+        c.ah += fwCorrectionAh(ch) - c.correctionAh;   // clamped by the firmware already
+        c.correctionAh = fwCorrectionAh(ch);
+      } else {
+        continue;
+      }
+      c.lastA = a; c.lastW = w; c.lastUs = banks.sampleUs[ch];
+    }
+    if (!needSocInitFromOCV) idealStarted = true;
+    samples++;
+  } while (trace->next(s));
+
+  double wallS = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall0).count();
+  double virtS = s.tMs / 1000.0;
+  if (rec) fclose(rec);
+
+  printf("samples           : %lu over %.2f days (dt %u ms)\n", samples, virtS / 86400.0, dtMs);
+  printf("throughput        : %.0f samples/s, %.0fx real time (%.2f s wall)\n",
+         samples / wallS, virtS / wallS, wallS);
+  for (int ch = 0; ch < channels; ch++) {
+    const IdealCounter& c = ideal[ch];
+    printf("battery %d\n", ch + 1);
+    printf("  SoC %%           : fw %7.2f  ideal %7.2f", fwSocPercent(ch), 100.0 * c.ah / fwCapacityAh(ch));
+    if (trace->trueSocPercent(ch) >= 0) printf("  true %7.2f", trace->trueSocPercent(ch));
+    printf("\n");
+    if (socErr[ch].n > 0)
+      printf("  SoC error %%     : rms %6.2f  worst %6.2f at %.1f h\n",
+             sqrt(socErr[ch].sumSq / socErr[ch].n), socErr[ch].worst, socErr[ch].worstAtH);
+#ifdef SOC_ESTIMATOR_EKF
+    printf("  estimator       : EKF, corrections %+.2f Ah in total, last innovation %+.3f V\n",
+           banks.ekf[ch].correctionAh, banks.ekf[ch].innovation);
+#endif
+    printf("  remaining Ah    : fw %7.2f  ideal %7.2f  drift %+10.6f\n",
+           fwRemainingAh(ch), c.ah, fwRemainingAh(ch) - c.ah);
+    printf("  remaining Wh    : fw %7.1f  ideal %7.1f  drift %+10.4f\n",
+           fwRemainingWh(ch), c.wh, fwRemainingWh(ch) - c.wh);
+    if (trace->trueCapacityAh(ch) >= 0)
+      printf("  capacity Ah     : fw %7.2f  true %7.2f\n", fwCapacityAh(ch), trace->trueCapacityAh(ch));
+    printf("  detectors       : rest %lu entries / %.1f h, full %lu\n",
+           events[ch].restEntries, events[ch].restS / 3600.0, events[ch].fullEvents);
+    printf("  learning        : %lu resyncs, %u capacity updates, SoH %.1f %%\n",
+           (unsigned long)banks.socResyncs[ch], banks.learnUpdates[ch], banks.soh_percent[ch]);
+  }
+
+  const SimCounters& sc = simCounters();
+  unsigned long maxErases = 0, erases = 0;
+  for (unsigned long e : simFlashErases()) {
+    erases += e;
+    if (e > maxErases) maxErases = e;
+  }
+  double years = virtS / (365.0 * 86400.0);
+  printf("flash journal     : %lu records, %lu bytes, %lu erases (worst sector %lu)\n",
+         sc.flashPrograms, sc.flashBytes, erases, maxErases);
+  printf("  per year        : %.0f records, %.0f erases per sector",
+         sc.flashPrograms / years, maxErases / years);
+  if (maxErases > 0) printf(", lifetime %.0f years at %d cycles", SIM_FLASH_ENDURANCE / (maxErases / years), SIM_FLASH_ENDURANCE);
+  printf("\n");
+
+  int rc = 0;
+  for (int ch = 0; ch < channels && checkAh >= 0; ch++) {
+    double dAh = fwRemainingAh(ch) - ideal[ch].ah;
+    double dWh = fwRemainingWh(ch) - ideal[ch].wh;
+    if (fabs(dAh) > checkAh || fabs(dWh) > checkWh) {
+      printf("FAIL battery %d: drift %+.6f Ah / %+.4f Wh exceeds %g Ah / %g Wh\n",
+             ch + 1, dAh, dWh, checkAh, checkWh);
+      rc = 1;
+    }
+  }
+  if (checkAh >= 0 && rc == 0) printf("PASS drift within %g Ah / %g Wh\n", checkAh, checkWh);
+
+  int capRc = 0;
+  for (int ch = 0; ch < channels && checkCapAh >= 0; ch++) {
+    double trueAh = trace->trueCapacityAh(ch);
+    if (trueAh < 0) continue;
+    double err = fwCapacityAh(ch) - trueAh;
+    if (fabs(err) > checkCapAh) {
+      printf("FAIL battery %d: learned capacity off by %+.2f Ah (tolerance %g Ah)\n",
+             ch + 1, err, checkCapAh);
+      capRc = 1;
+    }
+  }
+  if (checkCapAh >= 0 && capRc == 0) printf("PASS learned capacity within %g Ah\n", checkCapAh);
+
+  int socRc = 0;
+  for (int ch = 0; ch < channels && checkSocRms >= 0; ch++) {
+    if (socErr[ch].n == 0) continue;
+    double rms = sqrt(socErr[ch].sumSq / socErr[ch].n);
+    if (rms > checkSocRms) {
+      printf("FAIL battery %d: SoC error %.2f %% rms (tolerance %g %%)\n", ch + 1, rms, checkSocRms);
+      socRc = 1;
+    }
+  }
+  if (checkSocRms >= 0 && socRc == 0) printf("PASS SoC error within %g %% rms\n", checkSocRms);
+  return rc | capRc | socRc;
+}
@@ -0,0 +1,254 @@
+// ===========================================================
+// bmring — Cross-core handoff stress test on std::threads
+// ===========================================================
+//
+// Runs the sample ring of the firmware (SpscRing<BankSample,
+// SAMPLE_RING_LEN>, Sensors.h) and a 2-entry ring, which is
+// full or empty nearly all the time, between two std::threads
+// as the sensors and nmea stages use it across the cores:
+//   - lossless: the producer retries a refused push, so every
+//     element must arrive, in order
+//   - lossy: the producer drops a refused push, like
+//     readSensors(), and yields every few pushes; elements
+//     must arrive in order, and the sequence gaps must add up
+//     to the ring's drop count
+// Every field of an element is derived from its sequence
+// number, so a slot read while it was being written (a torn
+// element) shows as a mismatch. The consumer pauses now and
+// then, so the ring also runs full.
+// --check fails on any lost, duplicated, reordered or torn
+// element.
+//
+// --seqlock tests the bank snapshots instead (Seqlock.h,
+// Battery.h): one writer thread publishes N BankSnapshots,
+// two reader threads read them as fast as they can. Every
+// field again follows from the snapshot's number, so a copy
+// mixing two writes shows; versions must never go back, and
+// the last read must be the last write. --check fails on a
+// torn or stale copy.
+//
+//   bmring [--items N] [--seqlock] [--check]
+// ===========================================================
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "Config.h"
+#include "Globals.h"
+#include "Sensors.h"
+
+static BankSample makeSample(uint32_t seq) {
+  BankSample s;
+  s.ms       = seq;
+  s.sampleUs = ~seq;
+  s.bank     = (uint8_t)(seq % NUM_BATTERIES);
+  s.faults   = (uint8_t)(seq >> 3);
+  s.volts    = (float)(seq & 0xffff);
+  s.amps     = -(float)(seq >> 16);
+  s.tempK    = (float)(seq & 0xff) + 0.5f;
+  return s;
+}
+
+static bool intact(const BankSample& s) {
+  BankSample e = makeSample(s.ms);
+  return s.sampleUs == e.sampleUs && s.bank == e.bank && s.faults == e.faults &&
+         s.volts == e.volts && s.amps == e.amps && s.tempK == e.tempK;
+}
+
+struct RunResult {
+  uint32_t received, lost, disorder, torn, drops, maxFill;
+  double seconds;
+};
+
+template <size_t N>
+static RunResult run(SpscRing<BankSample, N>& ring, uint32_t items, bool lossless) {
+  std::atomic<bool> done{false};
+  RunResult r = RunResult();
+
+  auto t0 = std::chrono::steady_clock::now();
+  std::thread producer([&] {
+    for (uint32_t seq = 1; seq <= items; seq++) {
+      BankSample s = makeSample(seq);
+      if (lossless) {
+        while (!ring.push(s)) std::this_thread::yield();
+      } else {
+        ring.push(s);
+        if ((seq & 7) == 0) std::this_thread::yield();   // a sensor pass, not a flood
+      }
+    }
+    done.store(true, std::memory_order_release);
+  });
+  std::thread consumer([&] {
+    uint32_t expect = 1;
+    uint32_t n = 0;
+    BankSample s;
+    for (;;) {
+      bool finished = done.load(std::memory_order_acquire);
+      bool got = false;
+      while (ring.pop(s)) {
+        got = true;
+        r.received++;
+        if (!intact(s)) r.torn++;
+        if (s.ms < expect) r.disorder++;
+        else r.lost += s.ms - expect;
+        expect = s.ms + 1;
+        if ((++n & 0x3fff) == 0) std::this_thread::sleep_for(std::chrono::microseconds(50));
+      }
+      if (finished && !got) break;   // producer done and ring drained
+      if (!got) std::this_thread::yield();
+    }
+    r.lost += items + 1 - expect;    // tail of the sequence never seen
+  });
+  producer.join();
+  consumer.join();
+  r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  r.drops = ring.drops.load();
+  r.maxFill = ring.maxFill.load();
+  return r;
+}
+
+// ----- Bank snapshots -----
+static BankSnapshot makeSnapshot(uint32_t n) {
+  BankSnapshot s;
+  float base = (float)(n & 0xffff);
+  s.ms = n;
+  s.raw    = { base + 1, base + 2, base + 3, base + 4, base + 5 };
+  s.cal    = { base + 6, base + 7, base + 8, base + 9, base + 10 };
+  s.smooth = { base + 11, base + 12, base + 13, base + 14, base + 15 };
+  s.socPercent   = base + 16;
+  s.sohPercent   = base + 17;
+  s.remainingAh  = base + 18;
+  s.remainingWh  = base + 19;
+  s.loadA        = -base;
+  s.timeToEmptyS = base * 2;
+  s.timeToFullS  = base * 3;
+  s.loadHorizon  = (uint8_t)(n % 3);
+  s.faults       = (uint8_t)(n & 0x0f);
+  s.socValid     = n & 1;
+  s.resting      = (n >> 1) & 1;
+  s.full         = (n >> 2) & 1;
+  return s;
+}
+
+static bool sameTier(const BankTier& a, const BankTier& b) {
+  return a.volts == b.volts && a.amps == b.amps && a.watts == b.watts && a.tempC == b.tempC && a.tempK == b.tempK;
+}
+
+static bool intact(const BankSnapshot& s) {
+  BankSnapshot e = makeSnapshot(s.ms);
+  return sameTier(s.raw, e.raw) && sameTier(s.cal, e.cal) && sameTier(s.smooth, e.smooth) &&
+         s.socPercent == e.socPercent && s.sohPercent == e.sohPercent &&
+         s.remainingAh == e.remainingAh && s.remainingWh == e.remainingWh && s.loadA == e.loadA &&
+         s.timeToEmptyS == e.timeToEmptyS && s.timeToFullS == e.timeToFullS &&
+         s.loadHorizon == e.loadHorizon && s.faults == e.faults &&
+         s.socValid == e.socValid && s.resting == e.resting && s.full == e.full;
+}
+
+static Seqlock<BankSnapshot> snapshotUnderTest;
+
+static bool runSeqlock(uint32_t items) {
+  const int readers = 2;
+  std::atomic<bool> done{false};
+  uint32_t reads[readers] = {}, misses[readers] = {}, torn[readers] = {}, back[readers] = {};
+  uint32_t last[readers] = {};
+
+  snapshotUnderTest.write(makeSnapshot(0));
+  auto t0 = std::chrono::steady_clock::now();
+  std::thread writer([&] {
+    for (uint32_t n = 1; n <= items; n++) snapshotUnderTest.write(makeSnapshot(n));
+    done.store(true, std::memory_order_release);
+  });
+  std::thread reader[readers];
+  for (int r = 0; r < readers; r++) {
+    reader[r] = std::thread([&, r] {
+      BankSnapshot s;
+      for (;;) {
+        bool finished = done.load(std::memory_order_acquire);
+        if (!snapshotUnderTest.read(s)) {
+          misses[r]++;
+          continue;
+        }
+        reads[r]++;
+        if (!intact(s)) torn[r]++;
+        if (s.ms < last[r]) back[r]++;
+        last[r] = s.ms;
+        if (finished) break;   // this read started after the last write
+      }
+    });
+  }
+  writer.join();
+  for (int r = 0; r < readers; r++) reader[r].join();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+  printf("%u snapshots of %zu bytes (%zu words), %u hardware threads, %.1f M writes/s\n",
+         items, sizeof(BankSnapshot), Seqlock<BankSnapshot>::WORDS, std::thread::hardware_concurrency(),
+         items / seconds / 1e6);
+  printf("reader      reads    gave up   torn   back       last\n");
+  bool pass = snapshotUnderTest.version() == items + 1;
+  for (int r = 0; r < readers; r++) {
+    printf("%6d %10u %10u %6u %6u %10u\n", r + 1, reads[r], misses[r], torn[r], back[r], last[r]);
+    pass = pass && torn[r] == 0 && back[r] == 0 && last[r] == items;
+  }
+  return pass;
+}
+
+// ----- Sample ring -----
+static SpscRing<BankSample, SAMPLE_RING_LEN> sampleRingUnderTest;
+static SpscRing<BankSample, 2> tinyRing;
+
+template <size_t N>
+static bool report(const char* name, SpscRing<BankSample, N>& ring, uint32_t items, bool lossless) {
+  ring.head.store(0);
+  ring.tail.store(0);
+  ring.drops.store(0);
+  ring.maxFill.store(0);
+  RunResult r = run(ring, items, lossless);
+  // Lossless: nothing may go missing (refused pushes were
+  // retried). Lossy: exactly the refused pushes go missing.
+  bool ok = r.torn == 0 && r.disorder == 0 && r.received + r.lost == items &&
+            (lossless ? r.lost == 0 : r.lost == r.drops);
+  printf("%-9s %-8s %10u %10u %10u %10u %6u/%-3zu %5.1f M/s  %s\n", name, lossless ? "lossless" : "lossy",
+         r.received, r.lost, r.drops, r.torn + r.disorder, r.maxFill, N,
+         items / r.seconds / 1e6, ok ? "ok" : "BAD");
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  uint32_t items = 5000000;
+  bool check = false;
+  bool seqlock = false;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--items") && i + 1 < argc) items = (uint32_t)atol(argv[++i]);
+    else if (!strcmp(argv[i], "--seqlock")) seqlock = true;
+    else if (!strcmp(argv[i], "--check")) check = true;
+    else {
+      fprintf(stderr, "usage: %s [--items N] [--seqlock] [--check]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  if (seqlock) {
+    bool pass = runSeqlock(items);
+    if (!check) return 0;
+    printf(pass ? "PASS every snapshot read whole, versions in order, last write seen\n"
+                : "FAIL torn, stale or out-of-order snapshot\n");
+    return pass ? 0 : 1;
+  }
+
+  printf("%u elements of %zu bytes per run, %u hardware threads\n",
+         items, sizeof(BankSample), std::thread::hardware_concurrency());
+  printf("ring      mode       received       lost    refused   bad       fill     rate\n");
+  bool pass = true;
+  pass &= report("sample", sampleRingUnderTest, items, true);
+  pass &= report("sample", sampleRingUnderTest, items, false);
+  pass &= report("2-entry", tinyRing, items, true);
+  pass &= report("2-entry", tinyRing, items, false);
+
+  if (!check) return 0;
+  printf(pass ? "PASS every element arrived whole and in order, losses match the refused pushes\n"
+              : "FAIL elements lost, reordered or torn\n");
+  return pass ? 0 : 1;
+}
@@ -0,0 +1,36 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// ===========================================================
+// Host stand-in for the parts of the Arduino core the
+// firmware uses outside of the HAL (types and Serial).
+// ===========================================================
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <stdio.h>
+
+#define HEX 16
+
+class HardwareSerial {
+public:
+  void begin(unsigned long) {}
+  void print(const char* s)   { if (enabled) fputs(s, stdout); }
+  void print(char c)          { if (enabled) fputc(c, stdout); }
+  void print(int v)           { if (enabled) printf("%d", v); }
+  void print(unsigned int v)  { if (enabled) printf("%u", v); }
+  void print(uint8_t v, int base) { if (enabled) printf(base == HEX ? "%X" : "%u", v); }
+  void print(long v)          { if (enabled) printf("%ld", v); }
+  void print(unsigned long v) { if (enabled) printf("%lu", v); }
+  void print(double v, int digits = 2) { if (enabled) printf("%.*f", digits, v); }
+  template <typename T> void println(T v) { print(v); println(); }
+  void println()              { if (enabled) fputc('\n', stdout); }
+
+  bool enabled = true;  // host runs may silence debug output
+};
+
+extern HardwareSerial Serial;
+
+#endif // HOST_ARDUINO_H
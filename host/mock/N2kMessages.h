@@ -0,0 +1,107 @@
+#ifndef HOST_N2K_MESSAGES_H
+#define HOST_N2K_MESSAGES_H
+
+// ===========================================================
+// Host stand-in for ttlappalainen/NMEA2000 N2kMessages.h.
+// Only the PGNs the battery monitor builds or parses.
+// ===========================================================
+
+#include "N2kMsg.h"
+
+enum tN2kDCType { N2kDCt_Battery = 0, N2kDCt_Alternator = 1, N2kDCt_Converter = 2,
+                  N2kDCt_SolarCell = 3, N2kDCt_WindGenerator = 4 };
+enum tN2kBatType { N2kDCbt_Flooded = 0, N2kDCbt_Gel = 1, N2kDCbt_AGM = 2 };
+enum tN2kBatEqSupport { N2kDCES_No = 0, N2kDCES_Yes = 1, N2kDCES_Error = 2, N2kDCES_Unavailable = 3 };
+enum tN2kBatNomVolt { N2kDCbnv_6v = 0, N2kDCbnv_12v = 1, N2kDCbnv_24v = 2, N2kDCbnv_32v = 3,
+                      N2kDCbnv_62v = 4, N2kDCbnv_42v = 5, N2kDCbnv_48v = 6 };
+enum tN2kBatChem { N2kDCbc_LeadAcid = 0, N2kDCbc_LiIon = 1, N2kDCbc_NiCad = 2,
+                   N2kDCbc_ZnO = 3, N2kDCbc_NiMh = 4 };
+enum tN2kAlertType { N2kts_AlertTypeEmergencyAlarm = 1, N2kts_AlertTypeAlarm = 2,
+                     N2kts_AlertTypeWarning = 5, N2kts_AlertTypeCaution = 8 };
+enum tN2kAlertCategory { N2kts_AlertCategoryNavigational = 0, N2kts_AlertCategoryTechnical = 1 };
+enum tN2kAlertTriggerCondition { N2kts_AlertTriggerManual = 0, N2kts_AlertTriggerAuto = 1,
+                                 N2kts_AlertTriggerTest = 2, N2kts_AlertTriggerDisabled = 3 };
+enum tN2kAlertThresholdStatus { N2kts_AlertThresholdStatusNormal = 0, N2kts_AlertThresholdStatusExceeded = 1,
+                                N2kts_AlertThresholdStatusExtremeExceeded = 2,
+                                N2kts_AlertThresholdStatusLowExceeded = 3,
+                                N2kts_AlertThresholdStatusAcknowledged = 4,
+                                N2kts_AlertThresholdStatusAwaitingAcknowledge = 5 };
+enum tN2kAlertState { N2kts_AlertStateDisabled = 0, N2kts_AlertStateNormal = 1, N2kts_AlertStateActive = 2,
+                      N2kts_AlertStateSilenced = 3, N2kts_AlertStateAcknowledged = 4,
+                      N2kts_AlertStateAwaitingAcknowledge = 5 };
+
+// ----- PGN 126983 Alert -----
+inline void SetN2kPGN126983(tN2kMsg& N2kMsg, tN2kAlertType AlertType, tN2kAlertCategory AlertCategory,
+                            unsigned char AlertSystem, unsigned char AlertSubSystem, unsigned int AlertID,
+                            uint64_t SourceNetworkID, unsigned char DataSourceInstance,
+                            unsigned char DataSourceIndex, unsigned char AlertOccurrence, bool TemporarySilence,
+                            bool Acknowledge, bool EscalationStatus, bool TemporarySilenceSupport,
+                            bool AcknowledgeSupport, bool EscalationSupport, uint64_t AcknowledgeSourceNetworkID,
+                            tN2kAlertTriggerCondition TriggerCondition, tN2kAlertThresholdStatus ThresholdStatus,
+                            unsigned char AlertPriority, tN2kAlertState AlertState) {
+  N2kMsg.SetPGN(126983L);
+  N2kMsg.Priority = 2;
+  N2kMsg.AddByte((AlertType & 0x0f) | (AlertCategory & 0x0f) << 4);
+  N2kMsg.AddByte(AlertSystem);
+  N2kMsg.AddByte(AlertSubSystem);
+  N2kMsg.Add2ByteUInt((uint16_t)AlertID);
+  N2kMsg.AddUInt64(SourceNetworkID);
+  N2kMsg.AddByte(DataSourceInstance);
+  N2kMsg.AddByte(DataSourceIndex);
+  N2kMsg.AddByte(AlertOccurrence);
+  N2kMsg.AddByte(0xc0 | TemporarySilence | Acknowledge << 1 | EscalationStatus << 2 |
+                 TemporarySilenceSupport << 3 | AcknowledgeSupport << 4 | EscalationSupport << 5);
+  N2kMsg.AddUInt64(AcknowledgeSourceNetworkID);
+  N2kMsg.AddByte((TriggerCondition & 0x0f) | (ThresholdStatus & 0x0f) << 4);
+  N2kMsg.AddByte(AlertPriority);
+  N2kMsg.AddByte(AlertState);
+}
+
+// ----- PGN 127506 DC Detailed Status -----
+inline void SetN2kPGN127506(tN2kMsg& N2kMsg, unsigned char SID, unsigned char DCInstance, tN2kDCType DCType,
+                            unsigned char StateOfCharge, unsigned char StateOfHealth, double TimeRemaining,
+                            double RippleVoltage = N2kDoubleNA, double Capacity = N2kDoubleNA) {
+  N2kMsg.SetPGN(127506L);
+  N2kMsg.Priority = 6;
+  N2kMsg.AddByte(SID);
+  N2kMsg.AddByte(DCInstance);
+  N2kMsg.AddByte((unsigned char)DCType);
+  N2kMsg.AddByte(StateOfCharge);
+  N2kMsg.AddByte(StateOfHealth);
+  N2kMsg.Add2ByteUDouble(TimeRemaining, 60);
+  N2kMsg.Add2ByteUDouble(RippleVoltage, 0.001);
+  N2kMsg.Add2ByteUDouble(Capacity, 3600);
+}
+
+// ----- PGN 127508 Battery Status -----
+inline void SetN2kPGN127508(tN2kMsg& N2kMsg, unsigned char BatteryInstance, double BatteryVoltage,
+                            double BatteryCurrent = N2kDoubleNA, double BatteryTemperature = N2kDoubleNA,
+                            unsigned char SID = 1) {
+  N2kMsg.SetPGN(127508L);
+  N2kMsg.Priority = 6;
+  N2kMsg.AddByte(BatteryInstance);
+  N2kMsg.Add2ByteDouble(BatteryVoltage, 0.01);
+  N2kMsg.Add2ByteDouble(BatteryCurrent, 0.1);
+  N2kMsg.Add2ByteUDouble(BatteryTemperature, 0.01);
+  N2kMsg.AddByte(SID);
+}
+
+// ----- PGN 127513 Battery Configuration Status -----
+inline void SetN2kPGN127513(tN2kMsg& N2kMsg, unsigned char BatInstance, tN2kBatType BatType,
+                            tN2kBatEqSupport SupportsEqual, tN2kBatNomVolt BatNominalVoltage,
+                            tN2kBatChem BatChemistry, double BatCapacity, int8_t BatTemperatureCoefficient,
+                            double PeukertExponent, int8_t ChargeEfficiencyFactor) {
+  N2kMsg.SetPGN(127513L);
+  N2kMsg.Priority = 6;
+  N2kMsg.AddByte(BatInstance);
+  N2kMsg.AddByte(0xc0 | ((SupportsEqual & 0x03) << 4) | (BatType & 0x0f));
+  N2kMsg.AddByte(((BatChemistry & 0x0f) << 4) | (BatNominalVoltage & 0x0f));
+  N2kMsg.Add2ByteDouble(BatCapacity / 3600, 1);
+  N2kMsg.AddByte((unsigned char)BatTemperatureCoefficient);
+  PeukertExponent -= 1;
+  if (PeukertExponent < 0 || PeukertExponent > 0.504) N2kMsg.AddByte(0xff);
+  else N2kMsg.Add1ByteUDouble(PeukertExponent, 0.002, -1);
+  N2kMsg.AddByte((unsigned char)ChargeEfficiencyFactor);
+}
+
+#endif // HOST_N2K_MESSAGES_H
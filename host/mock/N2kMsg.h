@@ -0,0 +1,101 @@
+#ifndef HOST_N2K_MSG_H
+#define HOST_N2K_MSG_H
+
+// ===========================================================
+// Host stand-in for ttlappalainen/NMEA2000 N2kMsg.h (subset).
+// Field encodings follow the library so frames captured on
+// the host can be decoded the same way as on the bus.
+// ===========================================================
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#define N2kDoubleNA  -1e9
+#define N2kInt8NA    127
+#define N2kUInt8NA   255
+#define N2kUInt16NA  65535
+#define N2kInt16NA   32767
+#define N2kUInt32NA  4294967295UL
+
+inline bool N2kIsNA(double v) { return v == N2kDoubleNA; }
+
+// 29-bit CAN identifier; PDU1 PGNs (PF < 240) carry the
+// destination in the PDU specific byte
+inline unsigned long N2ktoCanID(unsigned char priority, unsigned long PGN, unsigned long Source,
+                                unsigned char Destination) {
+  unsigned long id = (unsigned long)(priority & 0x7) << 26 | (Source & 0xff);
+  if (((PGN >> 8) & 0xff) < 240) return id | (PGN & 0x3ff00UL) << 8 | (unsigned long)Destination << 8;
+  return id | (PGN & 0x3ffffUL) << 8;
+}
+
+class tN2kMsg {
+public:
+  static const int MaxDataLen = 223;
+
+  unsigned char Priority;
+  unsigned long PGN;
+  unsigned char Source;
+  unsigned char Destination;
+  int           DataLen;
+  unsigned char Data[MaxDataLen];
+  unsigned long MsgTime;
+
+  tN2kMsg(unsigned char _Source = 15, unsigned char _Priority = 6, unsigned long _PGN = 0, int _DataLen = 0)
+    : Priority(_Priority), PGN(_PGN), Source(_Source), Destination(0xff), DataLen(_DataLen), MsgTime(0) {
+    memset(Data, 0xff, sizeof(Data));
+  }
+
+  void SetPGN(unsigned long _PGN) { Clear(); PGN = _PGN; }
+  void Clear() { PGN = 0; DataLen = 0; memset(Data, 0xff, sizeof(Data)); }
+  bool IsValid() const { return PGN != 0 && DataLen > 0; }
+
+  // ----- Encoding -----
+  void AddByte(unsigned char v) { if (DataLen < MaxDataLen) Data[DataLen++] = v; }
+  void Add2ByteUInt(uint16_t v) { AddByte(v & 0xff); AddByte(v >> 8); }
+  void Add2ByteInt(int16_t v)   { Add2ByteUInt((uint16_t)v); }
+  void Add3ByteInt(int32_t v)   { AddByte(v & 0xff); AddByte((v >> 8) & 0xff); AddByte((v >> 16) & 0xff); }
+  void Add4ByteUInt(uint32_t v) { Add2ByteUInt(v & 0xffff); Add2ByteUInt(v >> 16); }
+  void AddUInt64(uint64_t v)    { Add4ByteUInt((uint32_t)v); Add4ByteUInt((uint32_t)(v >> 32)); }
+  void AddStr(const char* str, int len) {   // fixed length, 0xff padded
+    for (int i = 0; i < len; i++) AddByte(str && *str ? *str++ : 0xff);
+  }
+
+  void Add1ByteUDouble(double v, double precision, double UndefVal = N2kDoubleNA) {
+    if (v == UndefVal) { AddByte(0xff); return; }
+    double r = round(v / precision);
+    AddByte((r < 0 || r > 0xfd) ? 0xfe : (unsigned char)r);
+  }
+  void Add2ByteUDouble(double v, double precision, double UndefVal = N2kDoubleNA) {
+    if (v == UndefVal) { Add2ByteUInt(N2kUInt16NA); return; }
+    double r = round(v / precision);
+    Add2ByteUInt((r < 0 || r > 0xfffd) ? 0xfffe : (uint16_t)r);
+  }
+  void Add2ByteDouble(double v, double precision, double UndefVal = N2kDoubleNA) {
+    if (v == UndefVal) { Add2ByteInt(N2kInt16NA); return; }
+    double r = round(v / precision);
+    Add2ByteInt((r < -0x7ffe || r > 0x7ffd) ? 0x7ffe : (int16_t)r);
+  }
+
+  // ----- Decoding -----
+  unsigned char GetByte(int& Index) const { return (Index < DataLen) ? Data[Index++] : 0xff; }
+  uint16_t Get2ByteUInt(int& Index) const { uint16_t lo = GetByte(Index); return lo | (GetByte(Index) << 8); }
+  int16_t  Get2ByteInt(int& Index) const  { return (int16_t)Get2ByteUInt(Index); }
+  uint32_t Get3ByteUInt(int& Index) const { uint32_t lo = Get2ByteUInt(Index); return lo | ((uint32_t)GetByte(Index) << 16); }
+  uint32_t Get4ByteUInt(int& Index) const { uint32_t lo = Get2ByteUInt(Index); return lo | ((uint32_t)Get2ByteUInt(Index) << 16); }
+
+  double Get1ByteUDouble(double precision, int& Index, double def = N2kDoubleNA) const {
+    unsigned char v = GetByte(Index);
+    return (v >= 0xfe) ? def : v * precision;
+  }
+  double Get2ByteUDouble(double precision, int& Index, double def = N2kDoubleNA) const {
+    uint16_t v = Get2ByteUInt(Index);
+    return (v >= 0xfffe) ? def : v * precision;
+  }
+  double Get2ByteDouble(double precision, int& Index, double def = N2kDoubleNA) const {
+    int16_t v = Get2ByteInt(Index);
+    return (v >= 0x7ffe) ? def : v * precision;
+  }
+};
+
+#endif // HOST_N2K_MSG_H
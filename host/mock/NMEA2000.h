@@ -0,0 +1,120 @@
+#ifndef HOST_NMEA2000_H
+#define HOST_NMEA2000_H
+
+// ===========================================================
+// Host stand-in for ttlappalainen/NMEA2000 tNMEA2000.
+// Keeps the configuration calls as no-ops and records every
+// sent message in memory so the harness can inspect traffic.
+// Messages queued in Rx are read by ParseMessages(), which
+// reports their frame count to the host CAN model
+// (simCanRead()). ISO requests (59904) to this node or to all
+// are answered like the library does for product information
+// (126996), passed to the ISO request handler otherwise, and
+// NAKed (59392) if it declines; everything else is ignored.
+// ===========================================================
+
+#include <stdint.h>
+#include <vector>
+#include "N2kMsg.h"
+
+uint32_t halMillis();
+void simCanRead(unsigned frames);   // HalHost.cpp
+
+class tNMEA2000 {
+public:
+  // ISO NAME of a device (64 bits, as in address claim)
+  class tDeviceInformation {
+  public:
+    uint64_t Name = 0;
+    uint64_t GetName() const { return Name; }
+  };
+
+  enum tN2kMode { N2km_ListenOnly, N2km_NodeOnly, N2km_ListenAndNode, N2km_SendOnly, N2km_ListenAndSend };
+
+  typedef bool (*tISORqstHandler)(unsigned long RequestedPGN, unsigned char Requester, int DeviceIndex);
+
+  void SetProductInformation(const char* serial, unsigned short productCode, const char* modelId,
+                             const char* swCode, const char* modelVersion,
+                             unsigned char = 0xff, unsigned short = 0xffff, unsigned char = 0xff, int = -1) {
+    SerialCode = serial; ProductCode = productCode; ModelId = modelId; SwCode = swCode; ModelVersion = modelVersion;
+  }
+  void SetDeviceInformation(unsigned long UniqueNumber, unsigned char DeviceFunction, unsigned char DeviceClass,
+                            unsigned int ManufacturerCode, unsigned char IndustryGroup = 4, int = -1) {
+    DeviceInformation.Name = (UniqueNumber & 0x1fffffULL) | (uint64_t)(ManufacturerCode & 0x7ff) << 21 |
+                             (uint64_t)DeviceFunction << 40 | (uint64_t)(DeviceClass & 0x7f) << 49 |
+                             (uint64_t)(IndustryGroup & 0x7) << 60 | 1ULL << 63;
+  }
+  tDeviceInformation GetDeviceInformation(int = 0) const { return DeviceInformation; }
+  void SetMode(tN2kMode mode, unsigned char address = 15) { Mode = mode; Address = address; }
+  void EnableForward(bool) {}
+  void ExtendTransmitMessages(const unsigned long*, int = 0) {}
+  void SetISORqstHandler(tISORqstHandler handler) { ISORqstHandler = handler; }
+  bool Open() { IsOpen = true; return true; }
+
+  bool SendMsg(const tN2kMsg& msg, int = -1) {
+    if (!IsOpen) return false;
+    SentCount++;
+    if (Record) {
+      Sent.push_back(msg);
+      Sent.back().Source = Address;
+      Sent.back().MsgTime = halMillis();
+    }
+    return true;
+  }
+
+  // A message of up to 8 bytes is one frame, a longer one a
+  // fast packet (6 bytes in the first frame, 7 in the others)
+  static unsigned Frames(const tN2kMsg& m) { return m.DataLen <= 8 ? 1 : 1 + m.DataLen / 7; }
+
+  void ParseMessages() {
+    ParseCalls++;
+    for (const tN2kMsg& m : Rx) {
+      simCanRead(Frames(m));
+      if (m.PGN != 59904L || m.DataLen < 3) continue;
+      if (m.Destination != Address && m.Destination != 0xff) continue;
+      unsigned long pgn = m.Data[0] | (unsigned long)m.Data[1] << 8 | (unsigned long)m.Data[2] << 16;
+      if (pgn == 126996L) {
+        tN2kMsg info;
+        info.SetPGN(126996L);
+        info.Add2ByteUInt(2100);   // N2K version
+        info.Add2ByteUInt(ProductCode);
+        info.AddStr(ModelId, 32);
+        info.AddStr(SwCode, 32);
+        info.AddStr(ModelVersion, 32);
+        info.AddStr(SerialCode, 32);
+        info.AddByte(0xff);
+        info.AddByte(0xff);
+        SendMsg(info);
+      } else if (!ISORqstHandler || !ISORqstHandler(pgn, m.Source, 0)) {
+        tN2kMsg nak;
+        nak.SetPGN(59392L);
+        nak.Destination = m.Source;
+        nak.AddByte(1);            // Control: NAK
+        nak.AddByte(0xff);         // Group function
+        nak.AddByte(0xff); nak.AddByte(0xff); nak.AddByte(0xff);
+        nak.Add3ByteInt((int32_t)pgn);
+        SendMsg(nak);
+      }
+    }
+    Rx.clear();
+  }
+
+  // ----- Host-only inspection -----
+  tN2kMode Mode = N2km_ListenOnly;
+  unsigned char Address = 15;
+  bool IsOpen = false;
+  unsigned long ParseCalls = 0;
+  unsigned long SentCount = 0;
+  bool Record = true;             // keep copies of sent messages in Sent
+  std::vector<tN2kMsg> Sent;
+  std::vector<tN2kMsg> Rx;        // received messages, handled by ParseMessages()
+  tISORqstHandler ISORqstHandler = nullptr;
+  tDeviceInformation DeviceInformation;
+  const char* SerialCode = "";
+  unsigned short ProductCode = 0;
+  const char* ModelId = "";
+  const char* SwCode = "";
+  const char* ModelVersion = "";
+};
+
+#endif // HOST_NMEA2000_H